@@ -47,8 +47,12 @@ from the hardinfo "help-viewer" directory.
  */
 
 #include <glib/gi18n.h>        /* xgettext --keyword=_ --keyword=Q_:1g */
+#include <errno.h>
 #include <locale.h>
+#include <unistd.h>
 
+#include "mtx.h"
+#include "mtxbatch.h"
 #include "mtxtextview.h"
 #include "mtxviewer.h"
 #include "mtxversion.h"
@@ -113,9 +117,28 @@ Options that start with \"--no\" are enabled by default.\n\
                  smart text works better without --soft-breaks\n\
  --no-table      disable support for markdown tables"));
 
+    g_print ("\n%s\n", _("BATCH MODE"));
+    g_print ("%s\n", _("\
+ --out-dir=DIR   convert each markdown file under directory PATH to a file\n\
+                 in the output format, mirroring the directory tree under DIR\n\
+                 files that didn't change since the last run are skipped"));
+
     g_print ("\n%s\n", _("MISCELLANEOUS"));
     g_print ("%s\n", _("\
- --version       print version and license information and exit"));
+ --image-cache=MB\n\
+                 memory budget for reusing decoded images, default 32\n\
+ --page-cache=MB memory budget for revisiting converted pages, default 8\n\
+                 0 disables a cache; caches are only used by the GUI viewer\n\
+ --search-depth=N\n\
+                 document search descends N subdirectory levels, default 8\n\
+                 0 searches the home page directory only\n\
+ --search-exclude=GLOB\n\
+                 document search skips the files and directories whose name\n\
+                 or relative path matches GLOB; repeat for more globs\n\
+                 default \".*\", i.e. hidden files and directories\n\
+ --version       print version and license information and exit\n\
+ --watch         reload the viewed page when its file or images change\n\
+                 watch mode is only supported for the GUI viewer"));
 
     g_print ("\n%s\n", _("DEPRECATED"));
     g_print ("%s\n", _("\
@@ -144,9 +167,10 @@ stdout_output (gchar *dir,
                guint tweaks)
 {
     g_autofree gchar *path = NULL;
-    g_autofree gchar *contents = NULL;
-    g_autofree gchar *textout = NULL;
+    const gchar *contents;
     g_autoptr (MtxCmm) markdown = mtx_cmm_new ();
+    static MtxFdWriter out = { 1, 0, NULL, { 0 } };
+    gsize size;
 
     /* we do assume UTF-8 encoding */
     path = g_build_filename (dir, file, NULL);
@@ -159,16 +183,45 @@ stdout_output (gchar *dir,
         mtx_cmm_set_escape (markdown, TRUE);
     }
 
-    contents = _get_file_contents (path, NULL, TRUE);
+    /* borrow the file memory map: input is never copied */
+    contents = mtx_map_file_contents (path, &size, TRUE);
     if (contents != NULL)
     {
         /* UTF-8 encoding was validated */
-        gsize size;
+        if (!mtx_cmm_mtx_to_sink (markdown, contents, size,
+                                  mtx_fd_writer_sink, &out)
+            || !mtx_fd_writer_sink ("\n", 1, &out)
+            || !mtx_fd_writer_flush (&out))
+        {
+            if (out.error != NULL)
+            {
+                g_printerr ("%s: %s\n", PROGNAME, out.error->message);
+                g_clear_error (&out.error);
+            }
+        }
+        mtx_unmap_file_contents (contents, size);
+    }
+}
+
+/**
+_parse_megabytes:
+Parse the "MB" value of a --NAME=MB option.
+
+Return: TRUE and set @bytes if @s is a valid size.
+*/
+static gboolean
+_parse_megabytes (const gchar *s,
+                  gsize *bytes)
+{
+    gchar *end;
+    guint64 n = g_ascii_strtoull (s, &end, 10);
 
-        textout = mtx_cmm_mtx (markdown, &contents, &size, TRUE);
-        write (1, textout, size);
-        write (1, "\n", 1);
+    if (*s == '\0' || *end != '\0' || n > G_MAXSIZE >> 20)
+    {
+        return FALSE;
     }
+    *bytes = (gsize) n << 20;
+    return TRUE;
 }
 
 /**
@@ -180,9 +233,15 @@ main (int argc, char **argv)
     gchar *startup_file = NULL;
     gchar *home = NULL;
     gchar *title = NULL;
+    gchar *out_dir = NULL;
     g_autofree gchar *dir = NULL;
     g_autofree gchar *file = NULL;
     gboolean console_output = FALSE;
+    gboolean watch = FALSE;
+    gsize page_cache = MTX_TEXT_VIEW_PAGE_CACHE_BUDGET;
+    gsize image_cache = MTX_TEXT_VIEW_IMAGE_CACHE_BUDGET;
+    guint search_depth = MTX_VIEWER_SEARCH_DEPTH;
+    g_autoptr (GPtrArray) search_exclude = NULL;
     guint extensions = 0xffff;
     extensions &= ~MTX_CMM_EXTENSION_AUTO_LANG;
     guint tweaks = 0;
@@ -332,6 +391,60 @@ main (int argc, char **argv)
             tweaks |= MTX_CMM_TWEAK_SOFT_BREAK;
             continue;
         }
+        else if (strncmp (argv[i], "--out-dir=", sizeof "--out-dir=" - 1) == 0)
+        {
+            out_dir = argv[i] + sizeof "--out-dir=" - 1;
+            continue;
+        }
+        else if (strcmp (argv[i], "--out-dir") == 0 && i + 1 < argc)
+        {
+            out_dir = argv[++i];
+            continue;
+        }
+        else if ((strncmp (argv[i], "--page-cache=",
+                           sizeof "--page-cache=" - 1) == 0
+                  && _parse_megabytes (argv[i] + sizeof "--page-cache=" - 1,
+                                       &page_cache))
+                 || (strncmp (argv[i], "--image-cache=",
+                              sizeof "--image-cache=" - 1) == 0
+                     && _parse_megabytes (argv[i] + sizeof "--image-cache=" - 1,
+                                          &image_cache)))
+        {
+            continue;
+        }
+        else if (strncmp (argv[i], "--search-depth=",
+                          sizeof "--search-depth=" - 1) == 0)
+        {
+            gchar *end;
+            const gchar *s = argv[i] + sizeof "--search-depth=" - 1;
+            guint64 n = g_ascii_strtoull (s, &end, 10);
+
+            if (*s == '\0' || *end != '\0' || n > G_MAXUINT)
+            {
+                usage ();
+                fprintf (stderr, "%s: %s %s\n", PROGNAME,
+                         _("invalid option:"), argv[i]);
+                exit (1);
+            }
+            search_depth = (guint) n;
+            continue;
+        }
+        else if (strncmp (argv[i], "--search-exclude=",
+                          sizeof "--search-exclude=" - 1) == 0)
+        {
+            if (search_exclude == NULL)
+            {
+                search_exclude = g_ptr_array_new ();
+            }
+            g_ptr_array_add (search_exclude,
+                             argv[i] + sizeof "--search-exclude=" - 1);
+            continue;
+        }
+        else if (strcmp (argv[i], "--watch") == 0)
+        {
+            watch = TRUE;
+            continue;
+        }
         else if (strcmp (argv[i], "--no-permlink") == 0)
         {
             extensions &= ~MTX_CMM_EXTENSION_PERMLINK;
@@ -358,6 +471,24 @@ main (int argc, char **argv)
         }
     }
 
+    /* batch mode */
+    if (out_dir != NULL)
+    {
+        if (startup_file == NULL || out_dir[0] == '\0')
+        {
+            usage ();
+            exit (1);
+        }
+        if (!g_file_test (startup_file, G_FILE_TEST_IS_DIR))
+        {
+            g_printerr ("%s: '%s': %s\n", PROGNAME, startup_file,
+                        strerror (ENOTDIR));
+            exit (1);
+        }
+        exit (mtx_batch_run (startup_file, out_dir, output_type, extensions,
+                             tweaks, output_type == MTX_CMM_OUTPUT_PANGO));
+    }
+
     /* defaults */
     if (home != NULL && home[0] == '\0')
     {
@@ -408,12 +539,24 @@ main (int argc, char **argv)
         MtxViewer *mvr;
 
         gtk_init (&argc, &argv);
+        mtx_text_view_set_image_cache_budget (image_cache);
         mvr = mtx_viewer_new (dir, file, title, NULL, extensions, tweaks);
         if (mvr == NULL)
         {
             exit (1);
         }
         mvr->homepage = file;
+        mtx_text_view_set_page_cache_budget (MTX_TEXT_VIEW (mvr->text_view),
+                                             page_cache);
+        mtx_viewer_set_watch (mvr, watch);
+        if (search_exclude != NULL)
+        {
+            g_ptr_array_add (search_exclude, NULL);
+        }
+        mtx_viewer_set_search_scope (mvr, search_depth,
+                                     search_exclude == NULL ? NULL
+                                     : (const gchar * const *)
+                                     search_exclude->pdata);
         gtk_main ();
     }
 }
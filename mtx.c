@@ -22,6 +22,10 @@ Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA 02111-1307, USA.
 */
 
 #include <ctype.h>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
 #include "mtx.h"
 
 /**
@@ -258,3 +262,70 @@ out:
     return ret;
 }
 
+/**
+mtx_map_file_contents:
+Zero-copy file read utility function.
+
+@path: file to read.
+@size: pointer to the size of the returned data.
+@utf8_validate: if TRUE validate the UTF-8 encoding of file data.
+
+Returns: a read-only memory map of the file, which is not NUL-terminated,
+and sets *@size to its size in bytes.  Release it with mtx_unmap_file_contents.
+On error it returns NULL, *size is undefined, and errno is set to the error
+number.
+*/
+const gchar *
+mtx_map_file_contents (const gchar *path,
+                       gsize *size,
+                       const gboolean utf8_validate)
+{
+    int fd;
+    const gchar *mapped = NULL;
+    const gchar *invalid;
+    struct stat sb;
+
+    if ((fd = open (path, O_RDONLY)) < 0)
+    {
+        return NULL;
+    }
+    if (fstat (fd, &sb) != 0)
+    {
+        close (fd);
+        return NULL;
+    }
+    if (sb.st_size == 0)
+    {
+        mapped = "";
+    }
+    else if ((mapped = mmap (NULL, sb.st_size, PROT_READ,
+                             MAP_SHARED | MAP_NORESERVE, fd, 0)) == MAP_FAILED)
+    {
+        mapped = NULL;
+    }
+    close (fd);
+    if (mapped != NULL && utf8_validate
+        && !g_utf8_validate (mapped, sb.st_size, &invalid))
+    {
+        g_critical ("%s: invalid UTF-8 data at offset %ld", path,
+                    invalid - mapped);
+        mtx_unmap_file_contents (mapped, sb.st_size);
+        mapped = NULL;
+    }
+    *size = sb.st_size;
+    return mapped;
+}
+
+/**
+mtx_unmap_file_contents:
+Release a memory map returned by mtx_map_file_contents.
+*/
+void
+mtx_unmap_file_contents (const gchar *contents,
+                         const gsize size)
+{
+    if (contents != NULL && size > 0)
+    {
+        munmap ((gpointer) contents, size);
+    }
+}
@@ -43,6 +43,9 @@ typedef enum _MtxCmmWordType
 
 MtxCmmWordType mtx_word_type (const gchar *, gint *, gint *);
 
+const gchar *mtx_map_file_contents (const gchar *path, gsize *size, const gboolean);
+void mtx_unmap_file_contents (const gchar *contents, const gsize size);
+
 G_END_DECLS
 
 #endif /* MTX_H */
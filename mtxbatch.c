@@ -0,0 +1,613 @@
+/* vim:set ts=8 sw=4 et: */
+/*
+MDVIEW MTX
+
+Copyright (C) 2024 step, https://github.com/step-
+
+Licensed under the GNU General Public License Version 2
+
+This program is free software; you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation; either version 2 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program; if not, write to the Free Software
+Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA 02111-1307, USA.
+*/
+
+#define _GNU_SOURCE
+#include <errno.h>
+#include <fcntl.h>
+#include <stdio.h>
+#include <string.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#include <glib.h>
+#include <glib/gi18n.h>
+#include <glib/gstdio.h>
+
+#include "mtx.h"
+#include "mtxbatch.h"
+#include "mtxversion.h"
+
+/*********************************************************************
+*                         FILE DESCRIPTOR WRITER                     *
+*********************************************************************/
+
+/**
+mtx_fd_write_all:
+Write @len bytes to the file descriptor of @w retrying on EINTR and short
+writes.
+Returns: FALSE on error, and set @w->error unless it is already set.
+*/
+static gboolean
+mtx_fd_write_all (MtxFdWriter *w,
+                  const gchar *data,
+                  gsize len)
+{
+    ssize_t n;
+
+    while (len > 0)
+    {
+        if ((n = write (w->fd, data, len)) < 0)
+        {
+            if (errno == EINTR)
+            {
+                continue;
+            }
+            mtx_fd_writer_set_error (w, errno);
+            return FALSE;
+        }
+        data += n;
+        len -= n;
+    }
+    return TRUE;
+}
+
+/**
+mtx_fd_writer_set_error:
+Set @w->error from @errnum, unless an earlier error is set already.
+*/
+void
+mtx_fd_writer_set_error (MtxFdWriter *w,
+                         const gint errnum)
+{
+    if (w->error == NULL)
+    {
+        g_set_error_literal (&w->error, G_FILE_ERROR,
+                             g_file_error_from_errno (errnum),
+                             g_strerror (errnum));
+    }
+}
+
+/**
+mtx_fd_writer_flush:
+*/
+gboolean
+mtx_fd_writer_flush (MtxFdWriter *w)
+{
+    gboolean ret = mtx_fd_write_all (w, w->buf, w->len);
+    w->len = 0;
+    return ret;
+}
+
+/**
+mtx_fd_writer_sink:
+MtxCmmSinkFunc that buffers output for a MtxFdWriter @user_data.
+*/
+gboolean
+mtx_fd_writer_sink (const gchar *data,
+                    gsize len,
+                    gpointer user_data)
+{
+    MtxFdWriter *w = user_data;
+
+    if (w->len + len > sizeof (w->buf) && !mtx_fd_writer_flush (w))
+    {
+        return FALSE;
+    }
+    if (len >= sizeof (w->buf))
+    {
+        return mtx_fd_write_all (w, data, len);
+    }
+    memcpy (w->buf + w->len, data, len);
+    w->len += len;
+    return TRUE;
+}
+
+/*********************************************************************
+*                           BATCH CONVERSION                         *
+*********************************************************************/
+
+/*
+The main thread walks SRC_DIR and queues the markdown files that changed
+since the last run.  Worker threads, each with its own MtxCmm instance, then
+take the next queued file until none is left.  Each output file is written
+to a unique temporary file that is renamed into place when complete.
+
+Source files that differ only by their markdown extension, such as a.md and
+a.markdown, would map to the same output file; those keep their source
+extension in the output file name, a.md.html and a.markdown.html.
+
+OUT_DIR/MTX_BATCH_MANIFEST stamps each output file with the size and mtime
+of its source file and with the conversion settings.  A source file whose
+stamp matches, and whose output file exists, is skipped.
+*/
+
+typedef struct _mtx_batch_job
+{
+    gchar               *rel;           /* SRC_DIR-relative source path */
+    gchar               *out;           /* output file path */
+    gchar               *stamp;         /* manifest stamp */
+    goffset             size;           /* source file size */
+    gboolean            ok;             /* set by worker */
+} MtxBatchJob;
+
+typedef struct _mtx_batch
+{
+    const gchar         *src_dir;
+    const gchar         *out_dir;
+    const gchar         *out_ext;       /* output file extension */
+    MtxCmmOutput        output;
+    guint               extensions;
+    guint               tweaks;
+    gboolean            escape;
+
+    GPtrArray           *jobs;          /* (MtxBatchJob *) */
+    gint                next;           /* next job index; atomic */
+    GHashTable          *manifest;      /* rel => stamp, last run */
+    GHashTable          *stamps;        /* rel => stamp, this run */
+    guint               skipped;
+} MtxBatch;
+
+static const gchar *const mtx_batch_md_ext[] = {
+    ".md", ".markdown", ".mdown", ".mkd", ".mkdn", NULL
+};
+
+static void
+mtx_batch_job_free (MtxBatchJob *job)
+{
+    g_free (job->rel);
+    g_free (job->out);
+    g_free (job->stamp);
+    g_free (job);
+}
+
+/**
+mtx_batch_md_ext_len:
+Return: the length of the markdown file extension of @name, or 0 if @name
+isn't a markdown file name.
+*/
+static gsize
+mtx_batch_md_ext_len (const gchar *name)
+{
+    const gsize len = strlen (name);
+    gsize n;
+
+    for (const gchar *const *x = mtx_batch_md_ext; *x; x++)
+    {
+        n = strlen (*x);
+        if (len > n && g_ascii_strcasecmp (name + len - n, *x) == 0)
+        {
+            return n;
+        }
+    }
+    return 0;
+}
+
+/**
+mtx_batch_out_base:
+Return: newly-allocated @rel without its markdown extension.
+*/
+static gchar *
+mtx_batch_out_base (const gchar *rel)
+{
+    return g_strndup (rel, strlen (rel) - mtx_batch_md_ext_len (rel));
+}
+
+/**
+mtx_batch_out_path:
+Return: newly-allocated OUT_DIR path of the output file of @rel.
+@keep_ext: keep the markdown extension of @rel, see mtx_batch_plan.
+*/
+static gchar *
+mtx_batch_out_path (MtxBatch *b,
+                    const gchar *rel,
+                    gboolean keep_ext)
+{
+    g_autofree gchar *base = keep_ext ? g_strdup (rel)
+                             : mtx_batch_out_base (rel);
+    g_autofree gchar *name = g_strconcat (base, b->out_ext, NULL);
+    return g_build_filename (b->out_dir, name, NULL);
+}
+
+/**
+mtx_batch_manifest_load:
+Read OUT_DIR/MTX_BATCH_MANIFEST lines "stamp\trel" into a new hash table.
+*/
+static GHashTable *
+mtx_batch_manifest_load (MtxBatch *b)
+{
+    GHashTable *h = g_hash_table_new_full (g_str_hash, g_str_equal, g_free,
+                                           g_free);
+    g_autofree gchar *path =
+    g_build_filename (b->out_dir, MTX_BATCH_MANIFEST, NULL);
+    g_autofree gchar *contents = NULL;
+    gchar *line, *next, *tab;
+
+    if (!g_file_get_contents (path, &contents, NULL, NULL))
+    {
+        return h;
+    }
+    for (line = contents; *line; line = next)
+    {
+        if ((next = strchr (line, '\n')) != NULL)
+        {
+            *next++ = '\0';
+        }
+        else
+        {
+            next = line + strlen (line);
+        }
+        if ((tab = strchr (line, '\t')) != NULL)
+        {
+            *tab = '\0';
+            g_hash_table_replace (h, g_strdup (tab + 1), g_strdup (line));
+        }
+    }
+    return h;
+}
+
+/**
+mtx_batch_manifest_save:
+*/
+static gboolean
+mtx_batch_manifest_save (MtxBatch *b)
+{
+    GString *s = g_string_new ("");
+    GHashTableIter iter;
+    gpointer rel, stamp;
+    GError *err = NULL;
+    g_autofree gchar *path =
+    g_build_filename (b->out_dir, MTX_BATCH_MANIFEST, NULL);
+
+    g_hash_table_iter_init (&iter, b->stamps);
+    while (g_hash_table_iter_next (&iter, &rel, &stamp))
+    {
+        g_string_append_printf (s, "%s\t%s\n", (gchar *) stamp,
+                                (gchar *) rel);
+    }
+    g_file_set_contents (path, s->str, s->len, &err);
+    g_string_free (s, TRUE);
+    if (err != NULL)
+    {
+        g_printerr ("%s: %s\n", PROGNAME, err->message);
+        g_error_free (err);
+        return FALSE;
+    }
+    return TRUE;
+}
+
+/**
+mtx_batch_add_file:
+Record SRC_DIR-relative markdown file @rel; mtx_batch_plan decides whether
+it needs converting.
+@st: stat of @rel.
+*/
+static void
+mtx_batch_add_file (MtxBatch *b,
+                    gchar *rel,
+                    const struct stat *st)
+{
+    MtxBatchJob *job = g_new0 (MtxBatchJob, 1);
+
+    job->rel = rel;
+    job->stamp = g_strdup_printf ("%" G_GINT64_FORMAT ".%09ld %"
+                                  G_GINT64_FORMAT " %d:%u:%u:%d",
+                                  (gint64) st->st_mtim.tv_sec,
+                                  (long) st->st_mtim.tv_nsec,
+                                  (gint64) st->st_size, b->output,
+                                  b->extensions, b->tweaks, b->escape);
+    job->size = st->st_size;
+    g_ptr_array_add (b->jobs, job);
+}
+
+/**
+mtx_batch_plan:
+Assign the output file of each file that the walk recorded, then keep in the
+queue only those whose output isn't up-to-date.  Files whose output names
+collide keep their markdown extension, and the collision is reported, so no
+two workers ever write the same output file.
+*/
+static void
+mtx_batch_plan (MtxBatch *b)
+{
+    GHashTable *bases = g_hash_table_new_full (g_str_hash, g_str_equal, g_free,
+                                               NULL);
+    GPtrArray *queue = g_ptr_array_new_with_free_func
+        ((GDestroyNotify) mtx_batch_job_free);
+
+    /* base => count of the source files that map to it */
+    for (guint i = 0; i < b->jobs->len; i++)
+    {
+        MtxBatchJob *job = g_ptr_array_index (b->jobs, i);
+        gchar *base = mtx_batch_out_base (job->rel);
+        guint n = GPOINTER_TO_UINT (g_hash_table_lookup (bases, base));
+
+        g_hash_table_replace (bases, base, GUINT_TO_POINTER (n + 1));
+    }
+    for (guint i = 0; i < b->jobs->len; i++)
+    {
+        MtxBatchJob *job = g_ptr_array_index (b->jobs, i);
+        g_autofree gchar *base = mtx_batch_out_base (job->rel);
+        const gboolean collides =
+        GPOINTER_TO_UINT (g_hash_table_lookup (bases, base)) > 1;
+        const gchar *old = g_hash_table_lookup (b->manifest, job->rel);
+
+        job->out = mtx_batch_out_path (b, job->rel, collides);
+        if (collides)
+        {
+            g_printerr (_("%s: '%s': output name collides with another "
+                          "source file, writing '%s'\n"), PROGNAME,
+                        job->rel, job->out);
+        }
+        if (old != NULL && strcmp (old, job->stamp) == 0
+            && g_file_test (job->out, G_FILE_TEST_IS_REGULAR))
+        {
+            b->skipped++;
+            g_hash_table_replace (b->stamps, job->rel, job->stamp);
+            job->rel = job->stamp = NULL;
+            mtx_batch_job_free (job);
+        }
+        else
+        {
+            g_ptr_array_add (queue, job);
+        }
+    }
+    g_ptr_array_set_free_func (b->jobs, NULL);
+    g_ptr_array_free (b->jobs, TRUE);
+    b->jobs = queue;
+    g_hash_table_destroy (bases);
+}
+
+/**
+mtx_batch_walk:
+Recursively scan SRC_DIR/@rel for markdown files.  Hidden entries are
+ignored, and so are symbolic links to directories, which could loop.
+@rel: SRC_DIR-relative directory path, "" for SRC_DIR itself.
+*/
+static void
+mtx_batch_walk (MtxBatch *b,
+                const gchar *rel)
+{
+    GDir *dir;
+    GError *err = NULL;
+    const gchar *name;
+    gchar *r, *path;
+    struct stat st;
+    g_autofree gchar *dirpath = g_build_filename (b->src_dir, rel, NULL);
+
+    if ((dir = g_dir_open (dirpath, 0, &err)) == NULL)
+    {
+        g_printerr ("%s: %s\n", PROGNAME, err->message);
+        g_error_free (err);
+        return;
+    }
+    while ((name = g_dir_read_name (dir)))
+    {
+        if (name[0] == '.')
+        {
+            continue;
+        }
+        r = *rel ? g_build_filename (rel, name, NULL) : g_strdup (name);
+        path = g_build_filename (b->src_dir, r, NULL);
+        if (lstat (path, &st) == 0 && S_ISDIR (st.st_mode))
+        {
+            mtx_batch_walk (b, r);
+            g_free (r);
+        }
+        else if (mtx_batch_md_ext_len (name) > 0
+                 && stat (path, &st) == 0 && S_ISREG (st.st_mode))
+        {
+            /* takes r */
+            mtx_batch_add_file (b, r, &st);
+        }
+        else
+        {
+            g_free (r);
+        }
+        g_free (path);
+    }
+    g_dir_close (dir);
+}
+
+/**
+mtx_batch_convert:
+Convert a queued file.
+@w: the worker's output buffer.
+Return: TRUE on success.
+*/
+static gboolean
+mtx_batch_convert (MtxBatch *b,
+                   MtxCmm *cmm,
+                   MtxFdWriter *w,
+                   MtxBatchJob *job)
+{
+    g_autofree gchar *src = g_build_filename (b->src_dir, job->rel, NULL);
+    const gchar *dst = job->out;
+    g_autofree gchar *dir = g_path_get_dirname (dst);
+    g_autofree gchar *tmp = g_strconcat (dst, ".XXXXXX", NULL);
+    const gchar *contents;
+    gsize size;
+    gboolean ok;
+
+    if (g_mkdir_with_parents (dir, 0755) != 0)
+    {
+        g_printerr ("%s: '%s': %s\n", PROGNAME, dir, strerror (errno));
+        return FALSE;
+    }
+    errno = 0;
+    if ((contents = mtx_map_file_contents (src, &size, TRUE)) == NULL)
+    {
+        if (errno != 0)
+        {
+            g_printerr ("%s: '%s': %s\n", PROGNAME, src, strerror (errno));
+        }
+        return FALSE;
+    }
+    if ((w->fd = g_mkstemp_full (tmp, O_WRONLY, 0644)) < 0)
+    {
+        g_printerr ("%s: '%s': %s\n", PROGNAME, tmp, strerror (errno));
+        mtx_unmap_file_contents (contents, size);
+        return FALSE;
+    }
+    w->len = 0;
+    ok = mtx_cmm_mtx_to_sink (cmm, contents, size, mtx_fd_writer_sink, w)
+        && mtx_fd_writer_sink ("\n", 1, w) && mtx_fd_writer_flush (w);
+    if (close (w->fd) != 0)
+    {
+        mtx_fd_writer_set_error (w, errno);
+        ok = FALSE;
+    }
+    mtx_unmap_file_contents (contents, size);
+    if (ok && g_rename (tmp, dst) != 0)
+    {
+        mtx_fd_writer_set_error (w, errno);
+        ok = FALSE;
+    }
+    if (ok)
+    {
+        return TRUE;
+    }
+    g_printerr ("%s: '%s': %s\n", PROGNAME, src,
+                w->error ? w->error->message : _("conversion failed"));
+    g_clear_error (&w->error);
+    g_unlink (tmp);
+    return FALSE;
+}
+
+/**
+mtx_batch_worker:
+GThreadFunc.
+*/
+static gpointer
+mtx_batch_worker (gpointer data)
+{
+    MtxBatch *b = data;
+    MtxCmm *cmm = mtx_cmm_new ();
+    MtxFdWriter *w = g_new0 (MtxFdWriter, 1);
+    MtxBatchJob *job;
+    gint i;
+
+    mtx_cmm_set_output (cmm, b->output);
+    mtx_cmm_set_extensions (cmm, b->extensions);
+    mtx_cmm_set_tweaks (cmm, b->tweaks);
+    mtx_cmm_set_escape (cmm, b->escape);
+
+    while ((i = g_atomic_int_add (&b->next, 1)) < (gint) b->jobs->len)
+    {
+        job = g_ptr_array_index (b->jobs, i);
+        job->ok = mtx_batch_convert (b, cmm, w, job);
+    }
+    g_free (w);
+    g_object_unref (cmm);
+    return NULL;
+}
+
+/**
+mtx_batch_run:
+Convert each markdown file under @src_dir to a file under @out_dir, at the
+same relative path, with a file extension that matches @output.  Files are
+converted in parallel.  Conversion statistics are printed to stderr.
+
+@src_dir: source directory.
+@out_dir: output directory; created if it doesn't exist.
+@output, @extensions, @tweaks, @escape: like for the MtxCmm setters.
+
+Returns: exit status, 0 if all files were converted, otherwise 1.
+*/
+gint
+mtx_batch_run (const gchar *src_dir,
+               const gchar *out_dir,
+               MtxCmmOutput output,
+               guint extensions,
+               guint tweaks,
+               gboolean escape)
+{
+    MtxBatch b = { 0 };
+    GThread **threads;
+    guint nthreads, i, converted = 0, failed = 0;
+    guint64 bytes = 0;
+    gint64 t0;
+    gdouble secs;
+
+    if (g_mkdir_with_parents (out_dir, 0755) != 0)
+    {
+        g_printerr ("%s: '%s': %s\n", PROGNAME, out_dir, strerror (errno));
+        return 1;
+    }
+    b.src_dir = src_dir;
+    b.out_dir = out_dir;
+    b.out_ext = output == MTX_CMM_OUTPUT_HTML ? ".html" :
+                output == MTX_CMM_OUTPUT_PANGO ? ".xml" : ".txt";
+    b.output = output;
+    b.extensions = extensions;
+    b.tweaks = tweaks;
+    b.escape = escape;
+    b.jobs = g_ptr_array_new_with_free_func
+        ((GDestroyNotify) mtx_batch_job_free);
+    b.manifest = mtx_batch_manifest_load (&b);
+    b.stamps = g_hash_table_new_full (g_str_hash, g_str_equal, g_free,
+                                      g_free);
+
+    t0 = g_get_monotonic_time ();
+    mtx_batch_walk (&b, "");
+    mtx_batch_plan (&b);
+
+    nthreads = MAX (1, MIN (g_get_num_processors (), b.jobs->len));
+    threads = g_new (GThread *, nthreads);
+    for (i = 0; i < nthreads; i++)
+    {
+        threads[i] = g_thread_new ("mtx-batch", mtx_batch_worker, &b);
+    }
+    for (i = 0; i < nthreads; i++)
+    {
+        g_thread_join (threads[i]);
+    }
+    g_free (threads);
+
+    for (i = 0; i < b.jobs->len; i++)
+    {
+        MtxBatchJob *job = g_ptr_array_index (b.jobs, i);
+        if (job->ok)
+        {
+            converted++;
+            bytes += job->size;
+            g_hash_table_replace (b.stamps, job->rel, job->stamp);
+            job->rel = job->stamp = NULL;
+        }
+        else
+        {
+            failed++;
+        }
+    }
+    (void) mtx_batch_manifest_save (&b);
+    secs = (g_get_monotonic_time () - t0) / (gdouble) G_USEC_PER_SEC;
+
+    g_printerr (_("%s: %u converted, %u unchanged, %u failed in %.2f s"
+                  " (%.1f files/s, %.2f MB/s)\n"), PROGNAME,
+                converted, b.skipped, failed, secs,
+                secs > 0 ? converted / secs : 0.0,
+                secs > 0 ? bytes / secs / (1024 * 1024) : 0.0);
+
+    g_ptr_array_free (b.jobs, TRUE);
+    g_hash_table_destroy (b.manifest);
+    g_hash_table_destroy (b.stamps);
+    return failed > 0;
+}
@@ -0,0 +1,59 @@
+/* vim:set ts=8 sw=4 et: */
+/*
+MDVIEW MTX
+
+Copyright (C) 2024 step, https://github.com/step-
+
+Licensed under the GNU General Public License Version 2
+
+This program is free software; you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation; either version 2 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program; if not, write to the Free Software
+Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA 02111-1307, USA.
+ */
+
+#ifndef MTX_BATCH_H
+#define MTX_BATCH_H
+
+#include <glib.h>
+#include "mtxcmm.h"
+
+G_BEGIN_DECLS
+
+/* Buffered file descriptor writer; a MtxCmmSinkFunc target. */
+
+#define MTX_FD_WRITER_BUFSIZE (64 * 1024)
+
+typedef struct _mtx_fd_writer
+{
+    int fd;
+    gsize len;
+    GError *error;      /* first write error; the owner clears it */
+    gchar buf[MTX_FD_WRITER_BUFSIZE];
+} MtxFdWriter;
+
+gboolean mtx_fd_writer_sink (const gchar *, gsize, gpointer);
+gboolean mtx_fd_writer_flush (MtxFdWriter *);
+void mtx_fd_writer_set_error (MtxFdWriter *, const gint errnum);
+
+/* Batch conversion of a directory tree. */
+
+/* Conversion stamps of OUT_DIR files, relative to OUT_DIR. */
+#define MTX_BATCH_MANIFEST ".mdview-batch"
+
+gint mtx_batch_run (const gchar *src_dir, const gchar *out_dir,
+                    MtxCmmOutput, guint extensions, guint tweaks,
+                    gboolean escape);
+
+G_END_DECLS
+
+#endif /* MTX_BATCH_H */
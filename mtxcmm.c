@@ -50,7 +50,6 @@ struct _MtxCmmPrivate
 {
     gboolean           escape;
     gboolean           escaping;         /* cached because frequently used */
-    gint               ctr_repl_eval;    /* mtx_cmm_string_release_protected */
     MtxCmmParserUnitType seen_unit_types;  /* by mtx_cmm_render */
     gboolean           inside_table;     /* in <table> <a> selector */
 
@@ -60,15 +59,27 @@ struct _MtxCmmPrivate
     MtxCmmOutput       output;
     MtxCmmTags         tags;            /* viewer sets, renderer gets */
 
-    /* Parser queues. */
-    GQueue             *unitq;          /* parsed markdown */
+    /* Parser queues, stored bottom-up: the head is the last element. */
+    GPtrArray          *unitq;          /* parsed markdown */
     gpointer           *unitq_head;     /* cache top element */
-    GQueue             *junkq;          /* parser scraps */
+    GPtrArray          *junkq;          /* parser scraps */
+
+    /* Parser storage, reused across conversions. */
+    MtxCmmArena        arena;           /* units and unit ->args strings */
+    GPtrArray          *text_pool;      /* recycled unit ->text GStrings */
+    GPtrArray          *args_pool;      /* recycled unit ->args GArrays */
 
     /* Parser work-tables */
-    GArray             *regex_table;    /* precompiled regex */
     GPtrArray          *link_table;     /* URL/image and attributes */
     GPtrArray          *code_table;     /* <code>, protect sundries */
+    GHashTable         *link_index;     /* link_table text => id + 1 */
+    GHashTable         *code_index;     /* code_table text => id + 1 */
+    GPtrArray          *link_seed;      /* borrowed, see
+                                           mtx_cmm_set_link_dest_seed */
+
+    /* UNIPUA singleton => output text; set by output, tweaks and escape. */
+    const gchar        *unipua_repl[MTX_CMM_UNIPUA_TABLE_LEN];
+    gchar              *unipua_br;      /* owns unipua_repl[BR] */
 };
 
 /**********************************************************************/
@@ -83,7 +94,9 @@ G_DEFINE_TYPE_WITH_CODE (MtxCmm, mtx_cmm, G_TYPE_OBJECT, G_ADD_PRIVATE (MtxCmm))
 /*< private >**********************************************************/
 
 static void mtx_cmm_parser_clear_queues (MtxCmm *);
-static void mtx_cmm_parser_clear_regex_table_el (GRegex **e);
+static void mtx_cmm_arena_init (MtxCmmArena *);
+static void mtx_cmm_arena_free (MtxCmmArena *);
+static void mtx_cmm_text_pool_free_el (GString *);
 
 static void
 mtx_cmm_finalize (GObject *object)
@@ -96,14 +109,20 @@ mtx_cmm_finalize (GObject *object)
 
     g_return_if_fail (self->priv != NULL);
 
-    /* all three with GDestroyNotify function */
-    g_array_free (self->priv->regex_table, TRUE);
+    /* both with GDestroyNotify function */
     g_ptr_array_free (self->priv->link_table,  TRUE);
     g_ptr_array_free (self->priv->code_table,  TRUE);
+    g_hash_table_destroy (self->priv->link_index);
+    g_hash_table_destroy (self->priv->code_index);
+    g_free (self->priv->unipua_br);
 
     mtx_cmm_parser_clear_queues (self);
-    g_clear_pointer (&self->priv->unitq, g_queue_free);  /* NOLINT(bugprone-sizeof-expression) */
-    g_clear_pointer (&self->priv->junkq, g_queue_free);  /* NOLINT(bugprone-sizeof-expression) */
+    g_ptr_array_free (self->priv->unitq, TRUE);
+    g_ptr_array_free (self->priv->junkq, TRUE);
+    self->priv->unitq = self->priv->junkq = NULL;
+    g_ptr_array_free (self->priv->text_pool, TRUE);
+    g_ptr_array_free (self->priv->args_pool, TRUE);
+    mtx_cmm_arena_free (&self->priv->arena);
 
     G_OBJECT_CLASS (mtx_cmm_parent_class)->finalize (object);
 }
@@ -129,14 +148,19 @@ mtx_cmm_init (MtxCmm *self)
 #endif
     self->priv->output = MTX_CMM_OUTPUT_UNKNOWN;
     self->priv->escape = FALSE;
-    self->priv->unitq = g_queue_new ();
-    self->priv->junkq = g_queue_new ();
-
-    self->priv->regex_table = g_array_set_size(g_array_sized_new(FALSE, TRUE, sizeof (GRegex *), MTX_CMM_REGEX_LEN), MTX_CMM_REGEX_LEN);
-    g_array_set_clear_func (self->priv->regex_table, (GDestroyNotify) mtx_cmm_parser_clear_regex_table_el);
+    self->priv->unitq = g_ptr_array_sized_new (MTX_CMM_PARSER_QUEUE_RESERVE);
+    self->priv->junkq = g_ptr_array_sized_new (MTX_CMM_PARSER_QUEUE_RESERVE);
+    mtx_cmm_arena_init (&self->priv->arena);
+    self->priv->text_pool = g_ptr_array_new_with_free_func
+        ((GDestroyNotify) mtx_cmm_text_pool_free_el);
+    self->priv->args_pool = g_ptr_array_new_with_free_func
+        ((GDestroyNotify) g_array_unref);
 
     self->priv->link_table = g_ptr_array_new_with_free_func (g_free);
     self->priv->code_table = g_ptr_array_new_with_free_func (g_free);
+    /* Keys are borrowed from the tables above. */
+    self->priv->link_index = g_hash_table_new (g_str_hash, g_str_equal);
+    self->priv->code_index = g_hash_table_new (g_str_hash, g_str_equal);
 }
 
 /*< private >********************************************************/
@@ -145,20 +169,217 @@ mtx_cmm_init (MtxCmm *self)
 *                           PARSER TABLES                            *
 *********************************************************************/
 
+/*
+Compiled regular expressions are shared by all instances and threads.  Each
+mtx_cmm_regex_* accessor compiles its pattern once, on first use, with g_once.
+A GRegex is immutable, so matching against it concurrently is safe.
+*/
+
+typedef struct _mtx_cmm_regex_spec
+{
+    const gchar                          *name;    /* for error messages */
+    const gchar                          *pattern;
+} MtxCmmRegexSpec;
+
+/**
+mtx_cmm_regex_compile:
+GThreadFunc for g_once.
+@data: const MtxCmmRegexSpec *.
+Return: GRegex* or NULL on error.
+*/
+static gpointer
+mtx_cmm_regex_compile (gpointer data)
+{
+    const MtxCmmRegexSpec *spec = data;
+    GError *err = NULL;
+    GRegex *regex = g_regex_new (spec->pattern, G_REGEX_OPTIMIZE, 0, &err);
+    if (err != NULL)
+    {
+        g_printerr ("%s regex: %s\n", spec->name, err->message);
+        g_error_free (err);
+    }
+    return regex;
+}
+
+/*********************************************************************
+*                           PARSER ARENA                             *
+*********************************************************************/
+
+/*
+Parser units and their ->args strings are bump-allocated from a per-instance
+arena of large blocks.  Nothing allocated from the arena is freed one piece at
+a time; mtx_cmm_parser_clear_queues() rewinds the whole arena in O(1) and the
+blocks are kept for the next conversion.  Unit ->text GStrings and ->args
+GArrays can't live in the arena because the coda stages grow them in place,
+so they are recycled through the instance's text_pool and args_pool instead.
+*/
+
+static void
+mtx_cmm_arena_init (MtxCmmArena *arena)
+{
+    arena->blocks = g_array_new (FALSE, FALSE, sizeof (MtxCmmArenaBlock));
+    arena->current = 0;
+    arena->used = 0;
+}
+
+static void
+mtx_cmm_arena_free (MtxCmmArena *arena)
+{
+    if (arena->blocks == NULL)
+    {
+        return;
+    }
+    for (guint i = 0; i < arena->blocks->len; i++)
+    {
+        g_free (g_array_index (arena->blocks, MtxCmmArenaBlock, i).base);
+    }
+    g_array_free (arena->blocks, TRUE);
+    arena->blocks = NULL;
+}
+
+/**
+mtx_cmm_arena_reset:
+Rewind @arena keeping all its blocks allocated.
+*/
+static inline void
+mtx_cmm_arena_reset (MtxCmmArena *arena)
+{
+    arena->current = 0;
+    arena->used = 0;
+}
+
+/**
+mtx_cmm_arena_alloc:
+Bump-allocate @size bytes from @arena.
+
+Returns: uninitialized memory owned by @arena, valid until the next
+mtx_cmm_arena_reset().
+*/
+static gpointer
+mtx_cmm_arena_alloc (MtxCmmArena *arena,
+                     gsize size)
+{
+    MtxCmmArenaBlock *block, new_block;
+    gchar *p;
+
+    size = (size + G_MEM_ALIGN - 1) & ~((gsize) G_MEM_ALIGN - 1);
+
+    /* Fill the current block then move on to blocks kept from earlier runs. */
+    for (; arena->current < arena->blocks->len; arena->current++)
+    {
+        block = &g_array_index (arena->blocks, MtxCmmArenaBlock,
+                                arena->current);
+        if (block->size - arena->used >= size)
+        {
+            p = block->base + arena->used;
+            arena->used += size;
+            return p;
+        }
+        arena->used = 0;
+    }
+
+    /* Raise the high-water mark. */
+    new_block.size = MAX (size, MTX_CMM_ARENA_BLOCK_SIZE);
+    new_block.base = g_malloc (new_block.size);
+    g_array_append_val (arena->blocks, new_block);
+    arena->current = arena->blocks->len - 1;
+    arena->used = size;
+    return new_block.base;
+}
+
+static inline gpointer
+mtx_cmm_arena_alloc0 (MtxCmmArena *arena,
+                      gsize size)
+{
+    return memset (mtx_cmm_arena_alloc (arena, size), 0, size);
+}
+
+/**
+mtx_cmm_arena_strndup:
+Like g_strndup() but the copy is owned by @arena.
+*/
+static gchar *
+mtx_cmm_arena_strndup (MtxCmmArena *arena,
+                       const gchar *str,
+                       gsize len)
+{
+    gchar *p;
+
+    if (str == NULL)
+    {
+        return NULL;
+    }
+    p = mtx_cmm_arena_alloc (arena, len + 1);
+    memcpy (p, str, len);
+    p[len] = '\0';
+    return p;
+}
+
 static void
-mtx_cmm_parser_clear_regex_table_el (GRegex **e)
+mtx_cmm_text_pool_free_el (GString *text)
+{
+    g_string_free (text, TRUE);
+}
+
+/**
+mtx_cmm_parser_unit_text_new:
+Get a unit ->text GString, recycled if possible, initialized with @init.
+
+@self: %MtxCmm instance.
+@init: initial text. Nullable.
+@len: length of @init in bytes, or -1 if @init is NUL-terminated.
+*/
+static GString *
+mtx_cmm_parser_unit_text_new (MtxCmm *self,
+                              const gchar *init,
+                              const gssize len)
 {
-    if (*e)
+    GPtrArray *pool = self->priv->text_pool;
+    GString *text;
+
+    if (pool->len == 0)
+    {
+        return len < 0 ? g_string_new (init) : g_string_new_len (init, len);
+    }
+    text = g_ptr_array_steal_index_fast (pool, pool->len - 1);
+    if (init != NULL)
     {
-        g_regex_unref (*e);
-        *e = NULL;
+        g_string_append_len (text, init, len);
     }
+    return text;
 }
 
 /*********************************************************************
 *                         PARSER QUEUES                              *
 *********************************************************************/
 
+/*
+The parser queue is a stack of units laid out contiguously from the stack
+bottom (index 0) to the head (index len - 1).  Callers address units by their
+depth below the head through mtx_cmm_parser_unit_nth(), which is O(1), so
+that each coda stage is a linear scan of the queue.
+*/
+
+/**
+mtx_cmm_parser_unit_nth:
+Get the unit @n places below the head.
+
+@self: %MtxCmm instance.
+@n: depth; the head has depth zero.
+
+Returns: the unit or NULL if @n is out of range.
+*/
+static inline MtxCmmParserUnit *
+mtx_cmm_parser_unit_nth (MtxCmm *self,
+                         const gint n)
+{
+    GPtrArray *unitq = self->priv->unitq;
+
+    return n >= 0 && (guint) n < unitq->len ?
+        (MtxCmmParserUnit *) g_ptr_array_index (unitq, unitq->len - 1 - n)
+        : NULL;
+}
+
 /**
 mtx_cmm_parser_unit_cache_head:
 Cache and get the current head.
@@ -169,7 +390,7 @@ static inline MtxCmmParserUnit *
 mtx_cmm_parser_unit_cache_head (MtxCmm *self)
 {
     return (MtxCmmParserUnit *) (self->priv->unitq_head =
-                                 g_queue_peek_head (self->priv->unitq));
+                                 (gpointer) mtx_cmm_parser_unit_nth (self, 0));
 }
 
 /**
@@ -182,24 +403,13 @@ Returns: the popped head.
 static inline MtxCmmParserUnit *
 mtx_cmm_parser_unit_pop_head (MtxCmm *self)
 {
-    MtxCmmParserUnit* head = g_queue_pop_head (self->priv->unitq);
-    g_queue_push_tail (self->priv->junkq, head);
+    GPtrArray *unitq = self->priv->unitq;
+    MtxCmmParserUnit *head = g_ptr_array_remove_index (unitq, unitq->len - 1);
+    g_ptr_array_add (self->priv->junkq, head);
     mtx_cmm_parser_unit_cache_head (self);
     return head;
 }
 
-/**
-mtx_cmm_parser_unit_free_arg:
-@argptr: address of a unit argument's character array.
-
-Free the argument.
-*/
-static void
-mtx_cmm_parser_unit_free_arg (gchar **argptr)
-{
-    g_free (*argptr);
-}
-
 /**
 mtx_cmm_parser_unit_consume:
 
@@ -215,6 +425,8 @@ mtx_cmm_parser_unit_consume (MtxCmmParserUnit **unitptr)
 
 /**
 mtx_cmm_parser_unit_free:
+Return the unit's text and args containers to their pools.  The unit itself
+and its argument strings belong to the arena.
 
 @self: %MtxCmm instance.
 @unit: %MtxCmmParserUnit.
@@ -225,19 +437,27 @@ mtx_cmm_parser_unit_free (MtxCmm *self,
 {
     if (unit->text)
     {
-        g_string_free (unit->text, TRUE);
+        if (unit->text->allocated_len > MTX_CMM_POOLED_TEXT_MAX)
+        {
+            g_string_free (unit->text, TRUE);
+        }
+        else
+        {
+            g_string_truncate (unit->text, 0);
+            g_ptr_array_add (self->priv->text_pool, unit->text);
+        }
         unit->text = NULL;
     }
     if (unit->args)
     {
-        g_array_free (unit->args, TRUE);
+        g_array_set_size (unit->args, 0);
+        g_ptr_array_add (self->priv->args_pool, unit->args);
         unit->args = NULL;
     }
     if (unit == (MtxCmmParserUnit *) self->priv->unitq_head)
     {
         self->priv->unitq_head = NULL;
     }
-    g_free (unit);
 }
 
 /**
@@ -260,7 +480,8 @@ mtx_cmm_parser_clear_queues:
 
 @self: %MtxCmm instance.
 
-Clear parser unit queues leaving GQueue objects allocated.
+Clear parser unit queues leaving their arrays allocated at their current
+capacity, and rewind the parser arena.
 */
 
 static void
@@ -268,17 +489,18 @@ mtx_cmm_parser_clear_queues (MtxCmm *self)
 {
     if (self->priv->unitq != NULL)
     {
-        g_queue_foreach (self->priv->unitq, (GFunc) mtx_cmm_parser_unit_clear,
-                         self);
-        g_queue_clear (self->priv->unitq);
+        g_ptr_array_foreach (self->priv->unitq,
+                             (GFunc) mtx_cmm_parser_unit_clear, self);
+        g_ptr_array_set_size (self->priv->unitq, 0);
     }
     self->priv->unitq_head = NULL;
     if (self->priv->junkq != NULL)
     {
-        g_queue_foreach (self->priv->junkq, (GFunc) mtx_cmm_parser_unit_clear,
-                         self);
-        g_queue_clear (self->priv->junkq);
+        g_ptr_array_foreach (self->priv->junkq,
+                             (GFunc) mtx_cmm_parser_unit_clear, self);
+        g_ptr_array_set_size (self->priv->junkq, 0);
     }
+    mtx_cmm_arena_reset (&self->priv->arena);
 }
 
 /*< public  >********************************************************/
@@ -291,6 +513,8 @@ Create a new unit and push it on the private parser queue.
 @type: %MtxCmmParserUnitType.
 @flag_mask: %MtxCmmParserUnitFlag bit mask.
 
+The unit is allocated from the parser arena, and so are the strings appended
+to its ->args array.
 Freeing the new unit with mtx_cmm_parser_unit_free is generally unnecessary as
 mtx_cmm_parser_clear_queues() clears parser queues when parsing (re)starts, and
 when @self is finalized.
@@ -301,17 +525,20 @@ mtx_cmm_parser_unit_new (MtxCmm *self,
                          const MtxCmmParserUnitFlag flag_mask)
 {
     MtxCmmParserUnit *head;
+    GPtrArray *pool = self->priv->args_pool;
 
     head = (MtxCmmParserUnit *) (self->priv->unitq_head =
-                                 g_malloc0 (sizeof (MtxCmmParserUnit)));
-    g_queue_push_head (self->priv->unitq, head);
+                                 mtx_cmm_arena_alloc0 (&self->priv->arena,
+                                                       sizeof (MtxCmmParserUnit)));
+    g_ptr_array_add (self->priv->unitq, head);
     head->type = type;
     head->flag = flag_mask;
     if (head->flag & MTX_CMM_PARSER_UNIT_FLAG_ARGS)
     {
-        head->args = g_array_new (TRUE, FALSE, sizeof (gchar *));
-        g_array_set_clear_func (head->args,
-                                (GDestroyNotify) mtx_cmm_parser_unit_free_arg);
+        /* Argument strings are owned by the arena. */
+        head->args = pool->len > 0 ?
+            g_ptr_array_steal_index_fast (pool, pool->len - 1) :
+            g_array_new (TRUE, FALSE, sizeof (gchar *));
     }
 }
 
@@ -343,27 +570,49 @@ static const gchar * const _tag_info[] = {
 };
 
 /**
-mtx_cmm_tag_get_info:
+mtx_cmm_tag_annot_parse:
+Decode all MtxCmmTagInfo values of @tag in a single pass, so that consumers
+can read them as integers instead of searching the string once per subject.
 
 @tag: pango "font" tag
-@subject: MtxCmmTagInfo
-Return: `gint` @subject's value parsed from @tag
+@annot: filled with the parsed values, -1 where absent.
+Return: TRUE if @tag carries at least one value.
 */
-gint
-mtx_cmm_tag_get_info (MtxCmm *self,
-                      const gchar *tag,
-                      const MtxCmmTagInfo subject)
+gboolean
+mtx_cmm_tag_annot_parse (const gchar *tag,
+                         MtxCmmTagAnnot *annot)
 {
-    gchar *p = NULL;
-    gint ret = -1;
-
-    g_return_val_if_fail (self != NULL, -1);
-    g_return_val_if_fail (tag != NULL, -1);
-    g_return_val_if_fail (subject < MTX_TAG_INFO_LEN, -1);
-    p = strstr (tag, _tag_info[subject]);
-    if (p)
+    const gchar *p;
+    gboolean ret = FALSE;
+
+    g_return_val_if_fail (annot != NULL, FALSE);
+    for (guint i = 0; i < MTX_TAG_INFO_LEN; i++)
+    {
+        annot->info[i] = -1;
+    }
+    if (tag == NULL || (p = strchr (tag, '@')) == NULL)
+    {
+        return FALSE;
+    }
+    while (*p != '\0')
     {
-        ret = atoi (p + strlen (_tag_info[subject]));
+        gboolean found = FALSE;
+
+        for (guint i = 0; i < MTX_TAG_INFO_LEN && !found; i++)
+        {
+            gsize len = strlen (_tag_info[i]);
+            if (strncmp (p, _tag_info[i], len) == 0)
+            {
+                gchar *q;
+                annot->info[i] = (gint) g_ascii_strtoll (p + len, &q, 10);
+                p = q;
+                found = ret = TRUE;
+            }
+        }
+        if (!found)
+        {
+            ++p;
+        }
     }
     return ret;
 }
@@ -412,15 +661,29 @@ _print_priv_table (const GPtrArray *priv_table,
 mtx_cmm_make_code_ref:
 
 @id: id of an inline code segment stashed with `mtx_cmm_stash_code`.
-Return:
-dynamically-allocated string code_ref, which encodes @id
+@buf: buffer of at least MTX_CMM_CODE_REF_SIZE bytes.
+Return: @buf filled with the NUL-terminated code_ref that encodes @id.
 */
-static inline gchar*
-mtx_cmm_make_code_ref (const guint id)
+static inline gchar *
+mtx_cmm_make_code_ref (guint id,
+                       gchar *buf)
 {
-    return g_strdup_printf ("%s%dC;%s", sUNIPUA_CODE, id, sUNIPUA_CODE);
+    const gsize s = sizeof (sUNIPUA_CODE) - 1;
+
+    memcpy (buf, sUNIPUA_CODE, s);
+    for (gint i = MTX_CMM_CODE_REF_DIGITS - 1; i >= 0; i--)
+    {
+        buf[s + i] = '0' + id % 10;
+        id /= 10;
+    }
+    memcpy (buf + s + MTX_CMM_CODE_REF_DIGITS, sUNIPUA_CODE, s);
+    buf[MTX_CMM_CODE_REF_LEN] = '\0';
+    return buf;
 }
 
+static inline gsize mtx_cmm_parse_code_ref (const gchar *, const gchar *,
+                                            guint *);
+
 /**
 mtx_cmm_get_code_id:
 
@@ -431,13 +694,43 @@ static inline gint
 mtx_cmm_get_code_id (
     const gchar *ref)
 {
-    gint id = -1;
-    if (strncmp (ref, sUNIPUA_CODE, sizeof (sUNIPUA_CODE) - 1) == 0)
+    const gsize len = strnlen (ref, MTX_CMM_CODE_REF_SIZE);
+    guint id;
+
+    if (len == MTX_CMM_CODE_REF_LEN
+        && mtx_cmm_parse_code_ref (ref, ref + len, &id) > 0)
     {
-        id = atoi (ref + sizeof (sUNIPUA_CODE) - 1);
+        return id;
     }
+    return -1;
+}
 
-    return id;
+/**
+mtx_cmm_intern:
+Find or add @text in @table through its @index.
+
+@table: table owning the stashed strings.
+@index: hash table mapping each string of @table to its table index + 1.
+@text: string to intern.
+
+Return: the index of @text in @table.
+*/
+static guint
+mtx_cmm_intern (GPtrArray *table,
+                GHashTable *index,
+                const gchar *text)
+{
+    gpointer found = g_hash_table_lookup (index, text);
+    gchar *p;
+
+    if (found != NULL)
+    {
+        return GPOINTER_TO_UINT (found) - 1;
+    }
+    p = g_strdup (text);
+    g_ptr_array_add (table, p);
+    g_hash_table_insert (index, p, GUINT_TO_POINTER (table->len));
+    return table->len - 1;
 }
 
 /**
@@ -455,22 +748,8 @@ mtx_cmm_stash_code (MtxCmm *self,
     gint id = mtx_cmm_get_code_id (code);
     if (id < 0)
     {
-        gchar *p;
-        for (guint i = 0; i < self->priv->code_table->len; i++)
-        {
-            p = g_ptr_array_index (self->priv->code_table, i);
-            if (strcmp (code, p) == 0)
-            {
-                id = i;
-                break;
-            }
-        }
-        if (id < 0)
-        {
-            p = g_strdup (code);
-            g_ptr_array_add (self->priv->code_table, p);
-            id = self->priv->code_table->len - 1;
-        }
+        id = mtx_cmm_intern (self->priv->code_table, self->priv->code_index,
+                             code);
     }
 
     return id;
@@ -491,27 +770,41 @@ mtx_cmm_get_code (MtxCmm *self,
 }
 
 /**
-mtx_cmm_regex_code_ref:
+mtx_cmm_parse_code_ref:
+Decode the code_ref, if any, that starts at @p.
+
+@p: pointer into a buffer.
+@end: end of the buffer.
+@idptr: pointer to the decoded id.
 
-Return: a GRegex that matches the internal code_refs created by
-mtx_cmm_make_code_ref.
+Return: MTX_CMM_CODE_REF_LEN and set *@idptr, otherwise return zero if @p
+doesn't start a code_ref created by mtx_cmm_make_code_ref.
 */
-static GRegex *
-mtx_cmm_regex_code_ref (MtxCmm *self)
+static inline gsize
+mtx_cmm_parse_code_ref (const gchar *p,
+                        const gchar *end,
+                        guint *idptr)
 {
-    static GRegex **regex = NULL;
+    const gsize s = sizeof (sUNIPUA_CODE) - 1;
+    const gchar *q = p + s;
+    guint id = 0;
 
-    if (regex == NULL)
+    if (end - p < (gssize) MTX_CMM_CODE_REF_LEN
+        || memcmp (p, sUNIPUA_CODE, s) != 0
+        || memcmp (q + MTX_CMM_CODE_REF_DIGITS, sUNIPUA_CODE, s) != 0)
     {
-        regex =
-         &g_array_index (self->priv->regex_table, GRegex *,
-                         MTX_CMM_REGEX_CODE_REF);
+        return 0;
     }
-    if (*regex == NULL)
+    for (gint i = 0; i < MTX_CMM_CODE_REF_DIGITS; i++)
     {
-        *regex = g_regex_new (sUNIPUA_CODE "(\\d+)C;" sUNIPUA_CODE, 0, 0, NULL);
+        if ((guchar) (q[i] - '0') > 9)
+        {
+            return 0;
+        }
+        id = id * 10 + (q[i] - '0');
     }
-    return *regex;
+    *idptr = id;
+    return MTX_CMM_CODE_REF_LEN;
 }
 
 /**
@@ -549,22 +842,8 @@ mtx_cmm_stash_link_dest (MtxCmm *self,
     gint id = mtx_cmm_get_link_dest_id (dest);
     if (id < 0)
     {
-        gchar *p;
-        for (guint i = 0; i < self->priv->link_table->len; i++)
-        {
-            p = g_ptr_array_index (self->priv->link_table, i);
-            if (strcmp (dest, p) == 0)
-            {
-                id = i;
-                break;
-            }
-        }
-        if (id < 0)
-        {
-            p = g_strdup (dest);
-            g_ptr_array_add (self->priv->link_table, p);
-            id = self->priv->link_table->len - 1;
-        }
+        id = mtx_cmm_intern (self->priv->link_table, self->priv->link_index,
+                             dest);
     }
     return id;
 }
@@ -584,6 +863,35 @@ mtx_cmm_get_link_dest (MtxCmm *self,
     return (const gchar *) g_ptr_array_index(self->priv->link_table, id);
 }
 
+/**
+mtx_cmm_get_link_dest_count:
+
+Return: the number of entries in @self's link_table, i.e., the upper bound of
+valid ids for %mtx_cmm_get_link_dest.
+*/
+guint
+mtx_cmm_get_link_dest_count (MtxCmm *self)
+{
+    return self->priv->link_table->len;
+}
+
+/**
+mtx_cmm_set_link_dest_seed:
+Start the link_table of the next conversions with @dests, so that the
+link_dest ids of new destinations continue those of an earlier conversion, and
+its destinations keep their ids.  Used to append a conversion to a page.
+
+@dests: NULLABLE; borrowed (gchar *) destinations, e.g. the link_table of an
+earlier conversion.  They must stay valid until the seed is set to NULL.
+*/
+void
+mtx_cmm_set_link_dest_seed (MtxCmm *self,
+                            GPtrArray *dests)
+{
+    g_return_if_fail (MTX_IS_CMM (self));
+    self->priv->link_seed = dests;
+}
+
 /**
 mtx_cmm_mtx_reset:
 */
@@ -593,6 +901,10 @@ mtx_cmm_mtx_reset (MtxCmm *self)
     gsize i, sz;
     gchar **a;
 
+    /* Drop the borrowed keys first. */
+    g_hash_table_remove_all (self->priv->link_index);
+    g_hash_table_remove_all (self->priv->code_index);
+
     a = (gchar **) g_ptr_array_steal (self->priv->link_table, &sz);
     for (i = 0; i < sz; i++)
     {
@@ -607,11 +919,13 @@ mtx_cmm_mtx_reset (MtxCmm *self)
     }
     g_free (a);
 
+    for (i = 0; self->priv->link_seed && i < self->priv->link_seed->len; i++)
+    {
+        (void) mtx_cmm_intern (self->priv->link_table, self->priv->link_index,
+                               g_ptr_array_index (self->priv->link_seed, i));
+    }
+
     mtx_cmm_parser_clear_queues (self);
-    g_queue_free (self->priv->unitq);
-    g_queue_free (self->priv->junkq);
-    self->priv->unitq = g_queue_new ();
-    self->priv->junkq = g_queue_new ();
 }
 
 /**
@@ -620,9 +934,10 @@ Stash text in @self->priv->code_table and return the corresponding `code_ref`.
 
 @self:  the %MtxCmm instance.
 @text:  the text to stash and protect.
+@buf:   buffer of at least MTX_CMM_CODE_REF_SIZE bytes.
 
-Return: a `code_ref` string that can be used to replace @text in its original
-location. The caller owns the memory.  Return NULL on error.
+Return: @buf filled with a `code_ref` string that can be used to replace @text
+in its original location.  Return NULL on error.
 
 This function is used to encode text in opaque strings, hence preventing the
 text from entangling with other text in subsequent parsing and rendering stages.
@@ -631,58 +946,144 @@ protected segments.
 */
 static inline gchar *
 mtx_cmm_protect (MtxCmm *self,
-                 const gchar *text)
+                 const gchar *text,
+                 gchar *buf)
 {
     gint id = mtx_cmm_stash_code (self, text);
-    return id < 0 ? NULL : mtx_cmm_make_code_ref (id);
+    return id < 0 || id > MTX_CMM_CODE_ID_MAX ? NULL :
+        mtx_cmm_make_code_ref (id, buf);
 }
 
 /**
-mtx_replace_code_ref_cb:
-Callback to replace a code_ref match with the referenced text.
+mtx_cmm_expand_code_refs:
+Append @src to @out replacing each code_ref with the text it references.
+
+@src: text, not necessarily NUL-terminated.
+@len: length of @src in bytes.
+@out: output buffer.
+@recursive: if TRUE, code_refs found in referenced text are expanded too, so
+the output contains no code_ref at all.
+@unipua: NULL or a table of MTX_CMM_UNIPUA_TABLE_LEN strings; a UNIPUA
+singleton with a non-NULL entry is replaced with it.
+
+Returns: the number of code_refs that were expanded.
 */
-static gboolean
-mtx_release_code_ref_cb (const GMatchInfo *match_info,
-                         GString *buf,
-                         gpointer data)
+static gint
+mtx_cmm_expand_code_refs (MtxCmm *self,
+                          const gchar *src,
+                          const gsize len,
+                          GString *out,
+                          const gboolean recursive,
+                          const gchar *const *unipua)
 {
-    MtxCmm *self = data;
-    gchar *match = g_match_info_fetch (match_info, 1);
-    gint id = atoi (match);
-    gchar *code = mtx_cmm_get_code (self, id);
-    g_string_append (buf, code);
-    g_free (match);
-    self->priv->ctr_repl_eval++;
+    GPtrArray *code_table = self->priv->code_table;
+    const gchar *end = src + len, *p = src, *q;
+    const gchar *code;
+    gint ctr = 0;
+    gsize n;
+    guint id, c;
+
+    while (p < end
+           && (q = memchr (p, cUNIPUA_PREFIX0, end - p)) != NULL)
+    {
+        /* c indexes the UNIPUA table, or is out of range */
+        c = end - q > 2 && q[1] == cUNIPUA_PREFIX1 ?
+            (guint) (guchar) q[2] - (guchar) cUNIPUA_FIRST2 :
+            MTX_CMM_UNIPUA_TABLE_LEN;
+
+        if (c == MTX_CMM_UNIPUA_INDEX (iUNIPUA_CODE)
+            && (n = mtx_cmm_parse_code_ref (q, end, &id)) > 0
+            && id < code_table->len)
+        {
+            g_string_append_len (out, p, q - p);
+            code = mtx_cmm_get_code (self, id);
+            if (recursive)
+            {
+                ctr += mtx_cmm_expand_code_refs (self, code, strlen (code),
+                                                 out, TRUE, unipua);
+            }
+            else
+            {
+                g_string_append (out, code);
+            }
+            ctr++;
+            p = q + n;
+        }
+        else if (c < MTX_CMM_UNIPUA_TABLE_LEN
+                 && unipua != NULL && unipua[c] != NULL)
+        {
+            g_string_append_len (out, p, q - p);
+            g_string_append (out, unipua[c]);
+            p = q + sizeof (sUNIPUA_BR) - 1;
+        }
+        else
+        {
+            g_string_append_len (out, p, q + 1 - p);
+            p = q + 1;
+        }
+    }
+    g_string_append_len (out, p, end - p);
+    return ctr;
+}
 
-    return FALSE;
+/**
+mtx_cmm_string_release:
+Replace the code_refs in @str in a single pass, and the UNIPUA singletons
+too if @unipua isn't NULL.  See mtx_cmm_expand_code_refs.
+*/
+static gint
+mtx_cmm_string_release (MtxCmm *self,
+                        GString *str,
+                        const gboolean recursive,
+                        const gchar *const *unipua)
+{
+    GString *out, tmp;
+    gint ctr;
+
+    if (memchr (str->str, cUNIPUA_PREFIX0, str->len) == NULL)
+    {
+        return 0;
+    }
+    out = g_string_sized_new (str->len + str->len / 2);
+    ctr = mtx_cmm_expand_code_refs (self, str->str, str->len, out, recursive,
+                                    unipua);
+
+    /* Hand the expanded buffer over to @str. */
+    tmp = *str;
+    *str = *out;
+    *out = tmp;
+    g_string_free (out, TRUE);
+    return ctr;
 }
 
 /**
 mtx_cmm_string_release_protected:
-Replace all code_refs in @str with the text they reference.
+Replace all code_refs in @str with the text they reference.  Code_refs nested
+in the referenced text are left in place.
 @str: GString
 
-Returns: the number of matches or -1 on error.
+Returns: the number of replacements.
 */
 static gint
 mtx_cmm_string_release_protected (MtxCmm *self,
                                   GString *str)
 {
-    GRegex *regex = mtx_cmm_regex_code_ref (self);
-    GError *err = NULL;
+    return mtx_cmm_string_release (self, str, FALSE, NULL);
+}
 
-    self->priv->ctr_repl_eval = 0; /* NON-RE-ENTRANT */
-    g_autofree gchar *temp =
-    g_regex_replace_eval (regex, str->str, -1, 0, 0,
-                          mtx_release_code_ref_cb, self, &err);
-    if (err != NULL)
-    {
-        g_printerr ("%s: %s\n", __FUNCTION__, err->message);
-        g_error_free (err);
-        return -1;
-    }
-    g_string_assign (str, temp);
-    return self->priv->ctr_repl_eval;
+/**
+mtx_cmm_string_release_protected_all:
+Recursively replace all code_refs in @str with the text they reference,
+in a single linear pass.
+@str: GString
+
+Returns: the number of replacements.
+*/
+static gint
+mtx_cmm_string_release_protected_all (MtxCmm *self,
+                                      GString *str)
+{
+    return mtx_cmm_string_release (self, str, TRUE, NULL);
 }
 
 /**
@@ -740,22 +1141,14 @@ result.
 
 @str: GString
 
-Returns: the number of matches or -1 on error. In either case @str->str
-may have changed.
+Returns: the number of matches.
 */
 static gint
 mtx_cmm_string_release_protected_unmarked (MtxCmm *self,
                                            GString *str)
 {
-    gint ret, ctr = 0;
+    gint ctr = mtx_cmm_string_release_protected_all (self, str);
 
-    do {
-        ret = mtx_cmm_string_release_protected (self, str);
-        if (ret > 0)
-        {
-            ctr += ret;
-        }
-    } while (ret > 0);
     if (ctr > 0)
     {
 #if 0
@@ -769,7 +1162,7 @@ mtx_cmm_string_release_protected_unmarked (MtxCmm *self,
         str->len = strlen (str->str);
 #endif
     }
-    return ret < 0 ? -1 : ctr;
+    return ctr;
 }
 
 /**
@@ -792,9 +1185,9 @@ mtx_cmm_linkbuilder_pango (MtxCmm *self,
     Here and in mtx_cmm_imagebuilder_pango(), We need to pass extra data
     directly to the application that will render the link in the MTX TextView.
     Our data will piggyback the Pango markup "font" attribute. The TextView will
-    receive the font string as a GtkTextTag, decode it to get the font attribute
-    (string), decode the attribute and call mtx_cmm_get_link_dest() et al. to
-    obtain the link DEST.
+    receive the font string as a GtkTextTag, decode it once per tag with
+    mtx_cmm_tag_annot_parse() into a typed MtxCmmTagAnnot, and look up the link
+    DEST by the decoded id.
 
     The font attribute string looks like this:
       font="@dest=<type><id>[<type><value>...]",   with
@@ -842,7 +1235,7 @@ mtx_cmm_linkbuilder_pango (MtxCmm *self,
     if (text)
     {
         gint id = -1, repl_ctr = -1;
-        gchar *p;
+        gchar *p, ref[MTX_CMM_CODE_REF_SIZE];
 
         mtx_dbg_errout (-1, "(%s)", text);
         /* Text could be encoded; we must decode to tell. */
@@ -860,8 +1253,10 @@ mtx_cmm_linkbuilder_pango (MtxCmm *self,
         */
         if (repl_ctr > 0)
         {
-            id = mtx_cmm_tag_get_info (self, markup->str,
-                                       MTX_TAG_DEST_IMAGE_PATH_ID);
+            MtxCmmTagAnnot annot;
+
+            (void) mtx_cmm_tag_annot_parse (markup->str, &annot);
+            id = annot.info[MTX_TAG_DEST_IMAGE_PATH_ID];
             if (id >= 0)
             {
                 merge_img =
@@ -874,8 +1269,10 @@ mtx_cmm_linkbuilder_pango (MtxCmm *self,
                 mtx_dbg_errseq (-1, " ==> markup(%s)", markup->str);
             }
         }
-        g_string_assign (markup, p = mtx_cmm_protect (self, markup->str));
-        g_free (p);
+        if ((p = mtx_cmm_protect (self, markup->str, ref)))
+        {
+            g_string_assign (markup, p);
+        }
         mtx_dbg_errseq (-1, " ==> protected_markup(%s)", markup->str);
     }
     else
@@ -1219,6 +1616,53 @@ mtx_cmm_get_render_indent (MtxCmm *self)
             || self->priv->output == MTX_CMM_OUTPUT_TTY);
 }
 
+/**
+mtx_cmm_update_unipua_table:
+Precompute what each UNIPUA singleton releases to for the current output,
+tweaks and escape settings.
+*/
+static void
+mtx_cmm_update_unipua_table (MtxCmm *self)
+{
+    const gchar **repl = self->priv->unipua_repl;
+    const MtxCmmTags *tags = &self->priv->tags;
+    const gboolean html = self->priv->output == MTX_CMM_OUTPUT_HTML;
+
+    self->priv->escaping = self->priv->escape || html;
+    memset (repl, 0, sizeof (self->priv->unipua_repl));
+    g_clear_pointer (&self->priv->unipua_br, g_free);
+    if (self->priv->output == MTX_CMM_OUTPUT_UNKNOWN)
+    {
+        return;
+    }
+
+    self->priv->unipua_br = g_strconcat (tags->br, !html ? "" :
+                                         self->priv->tweaks &
+                                         MTX_CMM_TWEAK_HTML5 ?
+                                         ">\n" : " />\n", NULL);
+    repl[MTX_CMM_UNIPUA_INDEX (iUNIPUA_BR)]   = self->priv->unipua_br;
+    repl[MTX_CMM_UNIPUA_INDEX (iUNIPUA_E1)]   = tags->em_start;
+    repl[MTX_CMM_UNIPUA_INDEX (iUNIPUA_E0)]   = tags->em_end;
+    repl[MTX_CMM_UNIPUA_INDEX (iUNIPUA_B1)]   = tags->strong_start;
+    repl[MTX_CMM_UNIPUA_INDEX (iUNIPUA_B0)]   = tags->strong_end;
+
+    /* render_html_escaped */
+    if (self->priv->escaping)
+    {
+        repl[MTX_CMM_UNIPUA_INDEX (iUNIPUA_AMP)]  = "&amp;";
+        repl[MTX_CMM_UNIPUA_INDEX (iUNIPUA_LT)]   = "&lt;";
+        repl[MTX_CMM_UNIPUA_INDEX (iUNIPUA_GT)]   = "&gt;";
+        repl[MTX_CMM_UNIPUA_INDEX (iUNIPUA_QUOT)] = "&quot;";
+    }
+    else
+    {
+        repl[MTX_CMM_UNIPUA_INDEX (iUNIPUA_AMP)]  = "&";
+        repl[MTX_CMM_UNIPUA_INDEX (iUNIPUA_LT)]   = "<";
+        repl[MTX_CMM_UNIPUA_INDEX (iUNIPUA_GT)]   = ">";
+        repl[MTX_CMM_UNIPUA_INDEX (iUNIPUA_QUOT)] = "'";
+    }
+}
+
 /**
 mtx_cmm_get_escape:
 */
@@ -1238,6 +1682,7 @@ mtx_cmm_set_escape (MtxCmm *self,
 {
     g_return_val_if_fail (MTX_IS_CMM (self), FALSE);
     self->priv->escape = escape;
+    mtx_cmm_update_unipua_table (self);
     return TRUE;
 }
 
@@ -1281,6 +1726,7 @@ mtx_cmm_set_tweaks (MtxCmm *self,
 {
     g_return_val_if_fail (MTX_IS_CMM (self), FALSE);
     self->priv->tweaks = flags;
+    mtx_cmm_update_unipua_table (self);
     return TRUE;
 }
 
@@ -1601,12 +2047,15 @@ mtx_cmm_set_output (MtxCmm *self,
 
     /* save if valid */
     if (ret)
+    {
         self->priv->output = output;
+        mtx_cmm_update_unipua_table (self);
+    }
     return ret;
 } /* *INDENT*ON* */
 
 #ifdef MTX_DEBUG
-static void mtx_dump_queue(gpointer instance, int fd, GQueue* queue, gboolean print_junk);
+static void mtx_dump_queue(gpointer instance, int fd, GPtrArray* queue, gboolean print_junk);
 #endif
 
 /**
@@ -1656,78 +2105,92 @@ mtx_cmm_format_image (MtxCmm *self,
 }
 
 /**
-mtx_cmm_regex_directives:
-Return: GRegex* matcher for %%directives.
+mtx_cmm_directive_line_len:
+Match a mdview3 legacy directive line: `%%nopot` or `%%textdomain`, followed
+by blanks and anything up to the end of the line.
+@p: start of line.
+@end: end of text.
+@eol: set to the length of the line ending, if any.
+Return: length of the directive line, including its line ending, or 0 if @p
+doesn't start a directive line.
 */
-static GRegex *
-mtx_cmm_regex_directives (MtxCmm *self)
+static gsize
+mtx_cmm_directive_line_len (const gchar *p,
+                            const gchar *end,
+                            gsize *eol)
 {
-    static GRegex **regex = NULL;
-/*
-/
-(\R|^)%%(?|(nopot)[ \t]+(.*?)|(textdomain)[ \t]+(.*?))($|\R)
-/gm
-*/
-    if (regex == NULL)
-    {
-        regex = &g_array_index (self->priv->regex_table, GRegex *,
-                                MTX_CMM_REGEX_DIRECTIVE);
-    }
-    if (*regex == NULL)
+    static const gchar *const directive[] = { "%%nopot", "%%textdomain" };
+    const gchar *q = NULL, *r;
+    gsize n;
+
+    for (guint i = 0; i < G_N_ELEMENTS (directive); i++)
     {
-        GError *err = NULL;
-        *regex = g_regex_new (
-            "(\\R|^)%%(?|"                    /* group  1 in callback */
-              "(nopot)[ \\t]+(.*?)"           /* groups 2 and 3 in callback */
-              "|(textdomain)[ \\t]+(.*?)"     /* groups 2 and 3 in callback */
-            ")($|\\R)"                        /* group  4 in callback */
-            "", 0, 0, &err);
-        if (err != NULL)
+        n = strlen (directive[i]);
+        if ((gsize) (end - p) > n && memcmp (p, directive[i], n) == 0
+            && (p[n] == ' ' || p[n] == '\t'))
         {
-            g_printerr ("directive regex: %s\n", err->message);
-            g_error_free (err);
+            q = p + n;
+            break;
         }
     }
-    return *regex;
+    if (q == NULL)
+    {
+        return 0;
+    }
+    while (q < end && *q != '\n' && *q != '\r')
+    {
+        q++;
+    }
+    r = q;
+    if (q < end && *q++ == '\r' && q < end && *q == '\n')
+    {
+        q++;
+    }
+    *eol = q - r;
+    return q - p;
 }
 
 /**
-mtx_replace_directive_cb:
-Erase mdview3 legacy directives.
+mtx_cmm_erase_directives:
+Erase legacy directive lines.  A directive on the first line leaves an empty
+line behind.
+@src: text, not necessarily NUL-terminated.
+@len: length of @src in bytes.
+Return: NULL if @src has no directives, otherwise a newly-allocated GString
+holding the segments of @src between the directive lines.
 */
-static gboolean
-mtx_replace_directive_cb (const GMatchInfo *info,
-                          GString *res,
-                          gpointer data __attribute__((unused)))
+static GString *
+mtx_cmm_erase_directives (const gchar *src,
+                          const gsize len)
 {
-    g_autofree gchar *b = g_match_info_fetch (info, 1);
-    g_autofree gchar *e = g_match_info_fetch (info, 4);
-    g_string_append (res, *b ? b : e);
-    return FALSE;
-}
+    GString *out = NULL;
+    const gchar *end = src + len, *seg = src, *p = src, *q;
+    gsize n, eol;
 
-/**
-mtx_cmm_string_replace_directives:
-Replace directives with nothing (erase).
-@self: MtxCmm instance.
-@str: GString
-*/
-static void
-mtx_cmm_string_replace_directives (MtxCmm *self,
-                                   GString *str)
-{
-    GRegex *regex = mtx_cmm_regex_directives (self);
-    GError *err = NULL;
-    g_autofree gchar *temp =
-    g_regex_replace_eval (regex, str->str, -1, 0, 0,
-                          mtx_replace_directive_cb, self, &err);
-    if (err != NULL)
+    while (p < end && (q = memchr (p, '%', end - p)) != NULL)
     {
-        g_printerr ("%s internal error:\t%s\n", __FUNCTION__, err->message);
-        g_error_free (err);
-        return;
+        p = q + 1;
+        if ((q > src && q[-1] != '\n' && q[-1] != '\r')
+            || (n = mtx_cmm_directive_line_len (q, end, &eol)) == 0)
+        {
+            continue;
+        }
+        if (out == NULL)
+        {
+            out = g_string_sized_new (len);
+        }
+        g_string_append_len (out, seg, q - seg);
+        if (q == src)
+        {
+            g_string_append_len (out, q + n - eol, eol);
+        }
+        p = seg = q + n;
     }
-    g_string_assign (str, temp);
+    if (out != NULL)
+    {
+        g_string_append_len (out, seg, end - seg);
+    }
+    return out;
 }
 
 /**
@@ -1735,40 +2198,26 @@ mtx_cmm_regex_word_split:
 Return: GRegex* matcher to split segment on word separators.
 */
 static GRegex *
-mtx_cmm_regex_word_split (MtxCmm *self)
+mtx_cmm_regex_word_split (void)
 {
-    static GRegex **regex = NULL;
+    static GOnce once = G_ONCE_INIT;
 /*
 (?<!\\)([\p{Zs}\v\x{F600}\x{F60A}\x{F60B}\x{F608}\x{F609}\x{F60F}\x{F601}]+)
 */
-
-    if (regex == NULL)
-    {
-        regex = &g_array_index (self->priv->regex_table, GRegex *,
-                                MTX_CMM_REGEX_WORD_SPLIT);
-    }
-    if (*regex == NULL)
-    {
-        GError *err = NULL;
-        *regex = g_regex_new (
-            "(?<!\\\\)(["
-              "\\p{Zs}\\v"
-              rUNIPUA_BR
-              rUNIPUA_B1
-              rUNIPUA_B0
-              rUNIPUA_E1
-              rUNIPUA_E0
-              rUNIPUA_QUOT
-              rUNIPUA_CODE
-            "]+)"
-            "", 0, 0, &err);
-        if (err != NULL)
-        {
-            g_printerr ("word split regex: %s\n", err->message);
-            g_error_free (err);
-        }
-    }
-    return *regex;
+    static const MtxCmmRegexSpec spec = {
+        "word split",
+        "(?<!\\\\)(["
+          "\\p{Zs}\\v"
+          rUNIPUA_BR
+          rUNIPUA_B1
+          rUNIPUA_B0
+          rUNIPUA_E1
+          rUNIPUA_E0
+          rUNIPUA_QUOT
+          rUNIPUA_CODE
+        "]+)"
+    };
+    return g_once (&once, mtx_cmm_regex_compile, (gpointer) &spec);
 }
 
 /**
@@ -1788,7 +2237,7 @@ mtx_cmm_discover_auto_code_spans (MtxCmm *self,
 {
     gchar *p;
     GError *err = NULL;
-    GRegex *regex = mtx_cmm_regex_word_split (self);
+    GRegex *regex = mtx_cmm_regex_word_split ();
     gchar **words;
 
     words = g_regex_split_full (regex, text, strlen (text), 0, 0, 0, &err);
@@ -1798,9 +2247,6 @@ mtx_cmm_discover_auto_code_spans (MtxCmm *self,
         g_error_free (err);
     }
 
-/* Generous approximation, see mtx_cmm_regex_code_ref. */
-#define CODE_REF_SIZE     (16 + 2 * sizeof sUNIPUA_CODE)
-
     for (gint j = 0; words[j] != NULL; j++)
     {
         gint start = -1;
@@ -1831,7 +2277,8 @@ mtx_cmm_discover_auto_code_spans (MtxCmm *self,
             gchar *w = word;
             gint i, ref_start;
             guint len = strlen (words[j]) + strlen (prefix) + strlen (suffix);
-            gchar *buf = g_malloc0 ((len + CODE_REF_SIZE + 1) * sizeof *word);
+            gchar *buf = g_malloc0 ((len + MTX_CMM_CODE_REF_SIZE) * sizeof *word);
+            gchar ref[MTX_CMM_CODE_REF_SIZE];
 
             /* Copy text before the span. */
             for (i = 0; w != s; w++)
@@ -1875,11 +2322,10 @@ mtx_cmm_discover_auto_code_spans (MtxCmm *self,
             }
             /* Replace code_ref for discovered span. */
             buf[i + 1] = '\0';
-            if ((p = mtx_cmm_protect (self, buf + ref_start)))
+            if ((p = mtx_cmm_protect (self, buf + ref_start, ref)))
             {
-                len = strlen (p);
+                len = MTX_CMM_CODE_REF_LEN;
                 memcpy (buf + ref_start, p, len);
-                g_free (p);
 
                 /* Copy text after the span. */
                 for (i = ref_start + len; *w; w++)
@@ -1959,41 +2405,27 @@ match: 'it's'"a" (first double quote preceded by punctuation.
 no match: '' "" (both empty)
 */
 static GRegex *
-mtx_cmm_regex_dumb_quote_pairs (MtxCmm *self)
+mtx_cmm_regex_dumb_quote_pairs (void)
 {
-    static GRegex **regex = NULL;
+    static GOnce once = G_ONCE_INIT;
 /*
 (?<B>^|[\p{Zs}\p{P}\x{F600}])(?<L>['"\x{F60F}])(?<M>.+?)(?<R>\g{L})(?=$|[\p{Zs}\p{P}\x{F600}])
 */
-
-    if (regex == NULL)
-    {
-        regex = &g_array_index (self->priv->regex_table, GRegex *,
-                                MTX_CMM_REGEX_DUMB_QUOTE_PAIR);
-    }
-    if (*regex == NULL)
-    {
-        GError *err = NULL;
-        *regex = g_regex_new (
-            "(?<B>^|[\\p{Zs}\\p{P}"             /* group 1 in callback */
-                rUNIPUA_BR
-            "])"
-              "(?<L>['\""                       /* group 2 in callback */
-                rUNIPUA_QUOT
-              "])"
-                  "(?<M>.+?)"                   /* group 3 in callback */
-              "(?<R>\\g{L})"
-            "(?=$|[\\p{Zs}\\p{P}"
-                rUNIPUA_BR
-            "])"
-              "", 0, 0, &err);
-        if (err != NULL)
-        {
-            g_printerr ("dumb quote pair regex: %s\n", err->message);
-            g_error_free (err);
-        }
-    }
-  return *regex;
+    static const MtxCmmRegexSpec spec = {
+        "dumb quote pair",
+        "(?<B>^|[\\p{Zs}\\p{P}"             /* group 1 in callback */
+            rUNIPUA_BR
+        "])"
+          "(?<L>['\""                       /* group 2 in callback */
+            rUNIPUA_QUOT
+          "])"
+              "(?<M>.+?)"                   /* group 3 in callback */
+          "(?<R>\\g{L})"
+        "(?=$|[\\p{Zs}\\p{P}"
+            rUNIPUA_BR
+        "])"
+    };
+    return g_once (&once, mtx_cmm_regex_compile, (gpointer) &spec);
 }
 
 /**
@@ -2036,7 +2468,7 @@ static void
 mtx_cmm_string_replace_smart_quotes (MtxCmm *self,
                                      GString *str)
 {
-    GRegex *regex = mtx_cmm_regex_dumb_quote_pairs (self);
+    GRegex *regex = mtx_cmm_regex_dumb_quote_pairs ();
     GError *err = NULL;
 
     gchar *temp =
@@ -2120,9 +2552,10 @@ mtx_cmm_replace_smart_text (MtxCmm *self,
         return;
     }
     /* Prepare space-padded work string. */
-    work = g_string_new_len (" ", target->len - start + 2);
-    memcpy (work->str + 1, target->str + start, target->len - start);
-    *(work->str + (work->len - 1)) = ' ';
+    work = g_string_sized_new (target->len - start + 2);
+    g_string_append_c (work, ' ');
+    g_string_append_len (work, target->str + start, target->len - start);
+    g_string_append_c (work, ' ');
 
     if (found & MDASH)
     {
@@ -2142,156 +2575,41 @@ mtx_cmm_replace_smart_text (MtxCmm *self,
     g_string_free (work, TRUE);
 }
 
-/**
-mtx_cmm_regex_unipua:
-Return: GRegex* matcher to match UNIPUA singletons.
-The render_* functions insert singletons in lieu of some output tags.
-*/
-static GRegex *
-mtx_cmm_regex_unipua (MtxCmm *self)
-{
-    static GRegex **regex = NULL;
-
-    if (regex == NULL)
-    {
-        regex = &g_array_index (self->priv->regex_table, GRegex *,
-                                MTX_CMM_REGEX_UNIPUA);
-    }
-    if (*regex == NULL)
-    {
-        GError *err = NULL;
-        *regex = g_regex_new (
-            rUNIPUA_BR   "|"
-            rUNIPUA_B1   "|"
-            rUNIPUA_B0   "|"
-            rUNIPUA_E1   "|"
-            rUNIPUA_E0   "|"
-            rUNIPUA_AMP  "|"
-            rUNIPUA_LT   "|"
-            rUNIPUA_GT   "|"
-            rUNIPUA_QUOT
-            "", 0, 0, &err);
-        if (err != NULL)
-        {
-            g_printerr ("unipua regex: %s\n", err->message);
-            g_error_free (err);
-        }
-    }
-    return *regex;
-}
-
-/**
-mtx_replace_unipua_cb:
-*/
-static gboolean
-mtx_replace_unipua_cb (const GMatchInfo *info,
-                       GString *res,
-                       gpointer data)
-{
-    gchar * match = g_match_info_fetch (info, 0);
-    gchar *r = g_hash_table_lookup ((GHashTable *)data, match);
-    g_string_append (res, r);
-    g_free (match);
-    return FALSE;
-}
-
-/**
-mtx_cmm_string_release_unipua:
-Replace all UNIPUA singletons in @str with the formatted text they stand for.
-@str: GString
-*/
-static void
-mtx_cmm_string_release_unipua (MtxCmm *self,
-                               GString *str)
-{
-    GRegex *regex = mtx_cmm_regex_unipua (self);
-    GError *err = NULL;
-
-    GHashTable *h = g_hash_table_new (g_str_hash, g_str_equal);
-
-    GString *tag_br = g_string_new (self->priv->tags.br);
-    if (self->priv->output == MTX_CMM_OUTPUT_HTML)
-    {
-        g_string_append (tag_br, self->priv->tweaks & MTX_CMM_TWEAK_HTML5 ?
-                         ">\n" : " />\n");
-    }
-    g_hash_table_insert (h, sUNIPUA_BR, tag_br->str);
-    g_hash_table_insert (h, sUNIPUA_E1, (gchar *) self->priv->tags.em_start);
-    g_hash_table_insert (h, sUNIPUA_E0, (gchar *) self->priv->tags.em_end);
-    g_hash_table_insert (h, sUNIPUA_B1,
-                         (gchar *) self->priv->tags.strong_start);
-    g_hash_table_insert (h, sUNIPUA_B0, (gchar *) self->priv->tags.strong_end);
-
-    /* render_html_escaped */
-    if (self->priv->escaping)
-    {
-        g_hash_table_insert (h, sUNIPUA_AMP, "&amp;");
-        g_hash_table_insert (h, sUNIPUA_LT, "&lt;");
-        g_hash_table_insert (h, sUNIPUA_GT, "&gt;");
-        g_hash_table_insert (h, sUNIPUA_QUOT, "&quot;");
-    }
-    else
-    {
-        g_hash_table_insert (h, sUNIPUA_AMP, "&");
-        g_hash_table_insert (h, sUNIPUA_LT, "<");
-        g_hash_table_insert (h, sUNIPUA_GT, ">");
-        g_hash_table_insert (h, sUNIPUA_QUOT, "'");
-    }
-    g_autofree gchar *temp =
-    g_regex_replace_eval (regex, str->str, -1, 0, 0,
-                          mtx_replace_unipua_cb, h, &err);
-    g_string_free (tag_br, TRUE);
-    g_hash_table_destroy (h);
-    if (err)
-    {
-        g_printerr ("%s internal error:\t%s\n", __FUNCTION__, err->message);
-        g_error_free (err);
-        return;
-    }
-    g_string_assign (str, temp);
-}
-
 /**
 mtx_cmm_regex_tilde_code_fence:
 
 Return: GRegex* matcher for markdown markdown `~` code fence.
 */
 static const GRegex *
-mtx_cmm_regex_tilde_code_fence (MtxCmm *self)
+mtx_cmm_regex_tilde_code_fence (void)
 {
-    static GRegex **regex = NULL;
-
-    if (regex == NULL)
-    {
-        regex = &g_array_index (self->priv->regex_table, GRegex *,
-                                MTX_CMM_REGEX_TILDE_CODE_FENCE);
-    }
-    if (*regex == NULL)
-    {
-        GError *err = NULL;
-        *regex = g_regex_new ("(^|\\R) {0,3}~{3,}+", 0, 0, &err);
-        if (err != NULL)
-        {
-            g_printerr ("tilde_code_fence regex: %s\n", err->message);
-            g_error_free (err);
-        }
-    }
-    return *regex;
+    static GOnce once = G_ONCE_INIT;
+    static const MtxCmmRegexSpec spec = {
+        "tilde_code_fence",
+        "(^|\\R) {0,3}~{3,}+"
+    };
+    return g_once (&once, mtx_cmm_regex_compile, (gpointer) &spec);
 }
 
 /**
 mtx_cmm_str_tilde_code_fence_max_len:
 Return: length of the longest markdown `~` code fence in the input string.
+@str: not necessarily NUL-terminated.
+@len: length of @str in bytes.
 */
 static guint
-mtx_cmm_str_tilde_code_fence_max_len (MtxCmm *self, const gchar *str)
+mtx_cmm_str_tilde_code_fence_max_len (MtxCmm *self,
+                                      const gchar *str,
+                                      const gsize len)
 {
     GMatchInfo *match_info;
-    const GRegex *regex = mtx_cmm_regex_tilde_code_fence (self);
+    const GRegex *regex = mtx_cmm_regex_tilde_code_fence ();
     guint ret = 0; /* also in case of errors */
-    if (g_regex_match_all (regex, str, 0, &match_info))
+    gint start, end;
+    if (g_regex_match_all_full (regex, str, len, 0, 0, &match_info, NULL)
+        && g_match_info_fetch_pos (match_info, 0, &start, &end))
     {
-        ret = strlen (g_match_info_fetch (match_info, 0));
+        ret = end - start;
     }
     g_match_info_free (match_info);
     return ret;
@@ -2308,7 +2626,7 @@ static inline MtxCmmParserUnit *
 mtx_cmm_parser_get_unit_head (MtxCmm *self)
 {
     /* stack: x -- x */
-    g_assert(g_queue_get_length (self->priv->unitq) > 0);
+    g_assert (self->priv->unitq->len > 0);
     return (MtxCmmParserUnit *) self->priv->unitq_head;
 }
 
@@ -2331,7 +2649,7 @@ mtx_cmm_parser_find_unit_index (MtxCmm *self,
                                 MtxCmmParserUnit **unitptr)
 {
     MtxCmmParserUnit *unit;
-    for (gint i = start; (unit = g_queue_peek_nth (self->priv->unitq, i)); i++)
+    for (gint i = start; (unit = mtx_cmm_parser_unit_nth (self, i)); i++)
     {
         if (unit->type & type && unit->flag & flag)
         {
@@ -2345,6 +2663,26 @@ mtx_cmm_parser_find_unit_index (MtxCmm *self,
     return -1;
 }
 
+/**
+mtx_cmm_parser_unit_nth_matches:
+Test whether the unit @n places below the head intersects type and flag.
+@type: %MtxCmmParserUnitType bit mask.
+@flag: %MtxCmmParserUnitFlag bit mask.
+@n: depth; the head has depth zero.
+Return: TRUE if the unit exists and matches. Unlike
+mtx_cmm_parser_find_unit_index() this never scans the queue.
+*/
+/*static*/ gboolean
+mtx_cmm_parser_unit_nth_matches (MtxCmm *self,
+                                 const MtxCmmParserUnitType type,
+                                 const MtxCmmParserUnitFlag flag,
+                                 const int n)
+{
+    MtxCmmParserUnit *unit = mtx_cmm_parser_unit_nth (self, n);
+
+    return unit != NULL && unit->type & type && unit->flag & flag;
+}
+
 /**
 mtx_cmm_parser_unit_ends_with_c:
 */
@@ -2395,7 +2733,7 @@ mtx_cmm_parser_get_unit_arg_under (MtxCmm *self,
                                    const guint index)
 {
     MtxCmmParserUnit *unit;
-    for (gint i = 0; (unit = g_queue_peek_nth (self->priv->unitq, i)); i++)
+    for (gint i = 0; (unit = mtx_cmm_parser_unit_nth (self, i)); i++)
     {
         if (unit->type & type && unit->flag & flag)
         {
@@ -2426,7 +2764,7 @@ mtx_cmm_parser_merge_down_unit_arg (MtxCmm *self)
     gchar *value;
 
     /* stack: ARG ARG receiver -- receiver */
-    g_assert (g_queue_get_length (self->priv->unitq) > 2);
+    g_assert (self->priv->unitq->len > 2);
 
     g_assert (((MtxCmmParserUnit *) self->priv->unitq_head)->type ==
               MTX_CMM_PARSER_UNIT_ARG);
@@ -2438,7 +2776,9 @@ mtx_cmm_parser_merge_down_unit_arg (MtxCmm *self)
     (MtxCmmParserUnit *) self->priv->unitq_head;    /* receiver   */
 
     g_assert (below->args != NULL);
-    value = arg->text ? g_strdup (arg->text->str) : NULL;
+    value = arg->text ? mtx_cmm_arena_strndup (&self->priv->arena,
+                                               arg->text->str,
+                                               arg->text->len) : NULL;
     g_array_append_val (below->args, value);
 }
 
@@ -2474,7 +2814,7 @@ mtx_cmm_parser_merge_down_unit_arg_inlines (MtxCmm *self)
     GString *buf = NULL;
 
     /* stack: ARG_INLINES... ARG_INLINES receiver -- receiver */
-    g_assert (g_queue_get_length (self->priv->unitq) > 2);
+    g_assert (self->priv->unitq->len > 2);
 
     g_assert (((MtxCmmParserUnit *) self->priv->unitq_head)->type ==
               MTX_CMM_PARSER_UNIT_ARG_INLINES);
@@ -2482,22 +2822,20 @@ mtx_cmm_parser_merge_down_unit_arg_inlines (MtxCmm *self)
 
     /* Reach the opening ARG_INLINES. */
     for (i = 0;
-         (p = (MtxCmmParserUnit *) g_queue_peek_nth (self->priv->unitq, i))
+         (p = mtx_cmm_parser_unit_nth (self, i))
          && p->type != MTX_CMM_PARSER_UNIT_ARG_INLINES; i++)
         ;
     /* Collect inlines above until top unit. */
     for (j = i;
-         j >= 0 && (p = (MtxCmmParserUnit *) g_queue_peek_nth
-                    (self->priv->unitq, j)); j--)
+         j >= 0 && (p = mtx_cmm_parser_unit_nth (self, j)); j--)
     {
         if (p->type == MTX_CMM_PARSER_UNIT_SPAN_IMG)
         {
-            gchar *ref;
+            gchar ref[MTX_CMM_CODE_REF_SIZE];
             mtx_cmm_render_link_unit (self, p, mtx_cmm_format_image);
-            if ((ref = mtx_cmm_protect (self, p->text->str)))
+            if (mtx_cmm_protect (self, p->text->str, ref))
             {
                 g_string_assign (p->text, ref);
-                g_free (ref);
             }
         }
         if (p->text)
@@ -2523,8 +2861,8 @@ mtx_cmm_parser_merge_down_unit_arg_inlines (MtxCmm *self)
     g_assert (below->args != NULL);
     if (buf)
     {
-        value = buf->str;
-        g_string_free (buf, FALSE);
+        value = mtx_cmm_arena_strndup (&self->priv->arena, buf->str, buf->len);
+        g_string_free (buf, TRUE);
     }
     else
     {
@@ -2541,7 +2879,7 @@ mtx_cmm_render_link_unit (MtxCmm *self,
                           MtxCmmParserUnit *unit,
                           MtxCmmAImgFormatter *formatter)
 {
-    gchar *temp, *ref;
+    gchar *temp, ref[MTX_CMM_CODE_REF_SIZE];
     enum
     {
         DEST, TITLE, TEXT
@@ -2558,10 +2896,9 @@ mtx_cmm_render_link_unit (MtxCmm *self,
     {
         GString *str = g_string_new (text + 1);
         mtx_cmm_replace_smart_text (self, str, 0, str->len);
-        text = str->str;
-        g_string_free (str, FALSE);
-        g_array_remove_index (unit->args, TEXT);
-        g_array_insert_val (unit->args, TEXT, text);
+        text = mtx_cmm_arena_strndup (&self->priv->arena, str->str, str->len);
+        g_string_free (str, TRUE);
+        g_array_index (unit->args, gchar *, TEXT) = text;
     }
     else
     {
@@ -2570,7 +2907,7 @@ mtx_cmm_render_link_unit (MtxCmm *self,
 
     /* FIXME: auto-code should be applied to text */
     temp = formatter (self, text[0] ? text : NULL, dest, title);
-    if ((ref = mtx_cmm_protect (self, temp)))
+    if (mtx_cmm_protect (self, temp, ref))
     {
         if (unit->text)
         {
@@ -2578,9 +2915,9 @@ mtx_cmm_render_link_unit (MtxCmm *self,
         }
         else
         {
-            unit->text = g_string_new (ref);
+            unit->text = mtx_cmm_parser_unit_text_new (self, ref,
+                                                       MTX_CMM_CODE_REF_LEN);
         }
-        g_free (ref);
     }
     self->priv->inside_table = FALSE;
     g_free (temp);
@@ -2658,7 +2995,7 @@ mtx_cmm_render_process_output (const MD_CHAR *out,
         if (length > 0 || head->type == MTX_CMM_PARSER_UNIT_ARG)
         {
             if (head->text == NULL)
-                head->text = g_string_new_len (out, length);
+                head->text = mtx_cmm_parser_unit_text_new (self, out, length);
             else
                 g_string_append_len (head->text, out, length);
         }
@@ -2678,19 +3015,19 @@ Function mtx_dump_queue is useful to inspect the stack.  In gdb invoke
 
 /**
 mtx_dump_queue:
-Debug: dump parser GQueue queue.
+Debug: dump parser queue.
 @instance: parser instance whose `initq` is dumped if @queue is NULL.
 @fd: output file descriptor
 @queue: parser queue to dump, nullable.
 @print_junk:
 */
 __attribute__((unused))
-static void mtx_dump_queue (gpointer, int, GQueue *, gboolean);
+static void mtx_dump_queue (gpointer, int, GPtrArray *, gboolean);
 
 static void
 mtx_dump_queue (gpointer instance,
                 int fd,
-                GQueue *queue,
+                GPtrArray *queue,
                 gboolean print_junk)
 {
     MtxCmmParserUnit *unit;
@@ -2702,12 +3039,13 @@ mtx_dump_queue (gpointer instance,
     }
     dprintf (fd, "%5s%c%3s%5s %4s %9s %s   [STACK BOTTOM]\n", "UNIT", ',',
              "ARG", "TYPE", "FLAG", "ADDR", "TEXT AND ARGS");
-    for (gint i = g_queue_get_length (queue) - 1; i >= 0; i--)
+    for (gint i = (gint) queue->len - 1; i >= 0; i--)
     {
         gchar type_str[16];
         gchar flag_str[16] = { ' ' };
 
-        unit = (MtxCmmParserUnit *) g_queue_peek_nth (queue, i);
+        unit = (MtxCmmParserUnit *) g_ptr_array_index (queue,
+                                                       queue->len - 1 - i);
         if (unit->type == MTX_CMM_PARSER_UNIT_JUNK && !print_junk)
         {
             continue;
@@ -2861,6 +3199,91 @@ _col_strlen (const gchar *p)
     return len;
 }
 
+/**
+mtx_cmm_emitter:
+Forward output chunks to a MtxCmmSinkFunc.  The last '\n' seen is held back
+until more output follows, so the final line ending of the whole output is
+never emitted.
+*/
+typedef struct _mtx_cmm_emitter
+{
+    MtxCmmSinkFunc      sink;
+    gpointer            user_data;
+    gboolean            newline;        /* held back */
+    gboolean            ok;             /* FALSE after the sink failed */
+    gsize               emitted;        /* bytes passed to the sink */
+} MtxCmmEmitter;
+
+static gboolean
+mtx_cmm_emit (MtxCmmEmitter *e,
+              const gchar *data,
+              gsize len)
+{
+    if (!e->ok || len == 0)
+    {
+        return e->ok;
+    }
+    if (e->newline)
+    {
+        e->newline = FALSE;
+        if (!(e->ok = e->sink ("\n", 1, e->user_data)))
+        {
+            return FALSE;
+        }
+        ++e->emitted;
+    }
+    if (data[len - 1] == '\n')
+    {
+        e->newline = TRUE;
+        --len;
+    }
+    if (len > 0)
+    {
+        e->ok = e->sink (data, len, e->user_data);
+        e->emitted += len;
+    }
+    return e->ok;
+}
+
+/**
+mtx_cmm_emit_released:
+Emit @text with its code_refs and UNIPUA singletons released.
+@scratch: work buffer, reused across calls.
+*/
+static gboolean
+mtx_cmm_emit_released (MtxCmm *self,
+                       MtxCmmEmitter *e,
+                       const GString *text,
+                       GString *scratch)
+{
+    if (memchr (text->str, cUNIPUA_PREFIX0, text->len) == NULL)
+    {
+        return mtx_cmm_emit (e, text->str, text->len);
+    }
+    g_string_truncate (scratch, 0);
+    (void) mtx_cmm_expand_code_refs (self, text->str, text->len, scratch, TRUE,
+                                     (const gchar *const *)
+                                     self->priv->unipua_repl);
+    return mtx_cmm_emit (e, scratch->str, scratch->len);
+}
+
+/**
+mtx_cmm_sink_gstring:
+MtxCmmSinkFunc that appends to the GString @user_data.
+*/
+static gboolean
+mtx_cmm_sink_gstring (const gchar *data,
+                      gsize len,
+                      gpointer user_data)
+{
+    g_string_append_len ((GString *) user_data, data, len);
+    return TRUE;
+}
+
+static gboolean mtx_cmm_mtx_real (MtxCmm *, const gchar *, const gsize,
+                                  gchar **, MtxCmmSinkFunc, gpointer,
+                                  GArray *);
+
 /**
 mtx_cmm_mtx:
 Convert markdown to the desired output format.
@@ -2883,46 +3306,138 @@ the returned string in bytes. On error, it returns NULL and *@size is
 undefined.  In both cases if clear_markdown is TRUE, *@markdown is freed
 and *@markdown is set to NULL.
 */
-/*
-Conversion takes place in two stages. The first stage (mtx_render)
-closely interfaces with MD4C. The interface is derived from the MD4C
-html renderer (md4c-html.c). In the first stage, render_* functions
-push text units on the MtxCmmParserUnit ->priv->unitq stack. In the
-second stage (mtx_cmm_mtx render CODA), units are popped to apply
-transformations, and joined together for final output.
-*/
 gchar *
 mtx_cmm_mtx (MtxCmm *self,
              gchar **markdown,
              gsize *size,
              const gboolean clear_markdown)
+{
+    return mtx_cmm_mtx_blocks (self, markdown, size, clear_markdown, NULL);
+}
+
+/**
+mtx_cmm_mtx_blocks:
+Like `mtx_cmm_mtx` and also report where each top-level block of the output
+ends.  A top-level block is a run of output that no container (block quote,
+list, table) spans across; its markup is self-contained.
+
+@block_ends: NULLABLE; a GArray of gsize.  On success it is set to the
+increasing byte offsets of the block ends in the returned string; the last
+offset equals *@size.  It is left empty if the output could not be split.
+*/
+gchar *
+mtx_cmm_mtx_blocks (MtxCmm *self,
+                    gchar **markdown,
+                    gsize *size,
+                    const gboolean clear_markdown,
+                    GArray *block_ends)
+{
+    GString *out;
+
+    g_return_val_if_fail (MTX_IS_CMM (self), NULL);
+    g_return_val_if_fail (self->priv->output != MTX_CMM_OUTPUT_UNKNOWN, NULL);
+
+    out = g_string_new ("");
+    if (!mtx_cmm_mtx_real (self, *markdown ? *markdown : "",
+                           *markdown ? strlen (*markdown) : 0,
+                           clear_markdown ? markdown : NULL,
+                           mtx_cmm_sink_gstring, out, block_ends))
+    {
+        g_string_free (out, TRUE);
+        return NULL;
+    }
+    if (size != NULL)
+    {
+        *size = out->len;
+    }
+    return g_string_free (out, FALSE);
+}
+
+/**
+mtx_cmm_mtx_to_sink:
+Convert markdown to the desired output format, passing the output to @sink
+in chunks as it is produced instead of assembling it in memory.
+
+@self:
+@markdown: markdown text, not necessarily NUL-terminated, e.g., a read-only
+memory map.  It is borrowed and never copied unless the shebang extension
+applies or legacy directives must be erased.
+@len: length of @markdown in bytes.
+@sink: called for each output chunk, in order.  The concatenated chunks equal
+the string that `mtx_cmm_mtx` would return.
+@user_data: passed to @sink.
+
+The same requirements as for `mtx_cmm_mtx` apply.
+
+Return: FALSE on conversion error or if @sink returned FALSE, in which case
+the output is incomplete.
+*/
+gboolean
+mtx_cmm_mtx_to_sink (MtxCmm *self,
+                     const gchar *markdown,
+                     const gsize len,
+                     MtxCmmSinkFunc sink,
+                     gpointer user_data)
 {
     g_return_val_if_fail (MTX_IS_CMM (self), FALSE);
     g_return_val_if_fail (self->priv->output != MTX_CMM_OUTPUT_UNKNOWN, FALSE);
+    g_return_val_if_fail (sink != NULL, FALSE);
+
+    return mtx_cmm_mtx_real (self, markdown, len, NULL, sink, user_data,
+                             NULL);
+}
 
+/**
+mtx_cmm_mtx_real:
+@markdown: borrowed markdown text, not necessarily NUL-terminated.
+@len: length of @markdown in bytes.
+@clear_markdown: NULLABLE; if not NULL, free *@clear_markdown and set it to
+NULL as soon as the markdown parser is done with @markdown.
+@block_ends: NULLABLE; see `mtx_cmm_mtx_blocks`.
+*/
+/*
+Conversion takes place in two stages. The first stage (mtx_render)
+closely interfaces with MD4C. The interface is derived from the MD4C
+html renderer (md4c-html.c). In the first stage, render_* functions
+push text units on the MtxCmmParserUnit ->priv->unitq stack. In the
+second stage (mtx_cmm_mtx render CODA), units are popped to apply
+transformations, and joined together for final output.
+*/
+static gboolean
+mtx_cmm_mtx_real (MtxCmm *self,
+                  const gchar *markdown,
+                  const gsize len,
+                  gchar **clear_markdown,
+                  MtxCmmSinkFunc sink,
+                  gpointer user_data,
+                  GArray *block_ends)
+{
     mtx_cmm_mtx_reset (self);
+    if (block_ends != NULL)
+    {
+        g_array_set_size (block_ends, 0);
+    }
 
-    if (!(*markdown && *markdown[0]))
+    if (len == 0)
     {
-        if (clear_markdown)
-        {
-            g_free (*markdown);
-            *markdown = NULL;
-        }
-        if (size != NULL)
+        if (clear_markdown != NULL)
         {
-            *size = 0;
+            g_free (*clear_markdown);
+            *clear_markdown = NULL;
         }
-        return g_strdup ("");
+        return TRUE;
     }
 #if MTX_DEBUG > 2
     gchar *phase;
 #endif
-    GString *ret;
+    GString *edit = NULL, *scratch;
+    const gchar *text = markdown;
+    gsize text_len = len;
+    MtxCmmEmitter emitter = { sink, user_data, FALSE, TRUE, 0 };
     gint i;
-    gchar *ref, *temp;
+    gchar ref[MTX_CMM_CODE_REF_SIZE], *temp;
     MtxCmmParserUnit *unit;
-    GQueue *unitq = self->priv->unitq;
+    GPtrArray *unitq = self->priv->unitq;
     const gboolean do_autocode =
         self->priv->extensions & MTX_CMM_EXTENSION_AUTO_CODE;
     const gboolean do_permlink =
@@ -2935,33 +3450,33 @@ mtx_cmm_mtx (MtxCmm *self,
     gboolean do_tables =
         self->priv->extensions & MTX_CMM_EXTENSION_TABLE;
     gboolean do_margin = self->priv->output == MTX_CMM_OUTPUT_PANGO;
-    self->priv->escaping = self->priv->escape
-        || self->priv->output == MTX_CMM_OUTPUT_HTML;
-    ret = g_string_new (*markdown);
-    if (clear_markdown)
-    {
-        g_free (*markdown);
-        *markdown = NULL;
-    }
+    gint container_depth = 0;
 
     /*********************************************************************
     *                         SHEBANG EXTENSION                          *
     *********************************************************************/
-    if (do_shebang)
+    if (do_shebang && len > 2 && markdown[0] == '#' && markdown[1] == '!')
     {
-        gchar *p = ret->str;
-        if (*p++ == '#' && *p++ == '!')
+        const gchar *p = markdown + 2, *end = markdown + len;
+        for (; p < end && (*p == ' ' || *p == '\t'); p++)
+            ;
+        if (p < end && *p == '/')
         {
-            for (; *p == ' ' || *p == '\t'; p++)
-                ;
-            if (*p && *p++ == '/')
+            /*
+            Fence the whole input.  MD4C wants contiguous input, so the fence
+            and the input are written once into a buffer of the final size.
+            */
+            in_shebang = TRUE;
+            guint m = mtx_cmm_str_tilde_code_fence_max_len (self, markdown,
+                                                            len);
+            m = m > 0 ? m + 1 : 3;
+            edit = g_string_sized_new (m + 1 + len);
+            for (guint j = 0; j < m; j++)
             {
-                in_shebang = TRUE;
-                gint m = mtx_cmm_str_tilde_code_fence_max_len (self, ret->str);
-                g_autofree gchar *fence = g_strnfill (m > 0 ? m + 1 : 3, '~');
-                g_autofree gchar *line = g_strdup_printf ("%s\n", fence);
-                g_string_prepend (ret, line);
+                g_string_append_c (edit, '~');
             }
+            g_string_append_c (edit, '\n');
+            g_string_append_len (edit, markdown, len);
         }
     }
 
@@ -2975,11 +3490,17 @@ mtx_cmm_mtx (MtxCmm *self,
     */
     if (!in_shebang)
     {
-        mtx_cmm_string_replace_directives (self, ret);
+        edit = mtx_cmm_erase_directives (markdown, len);
+    }
+    if (edit != NULL)
+    {
+        text = edit->str;
+        text_len = edit->len;
     }
 
 #if MTX_DEBUG > 1
-    g_printerr ("@@@@@@@@@@ markdown:\n%s\n@@@@@@@@@@\n", ret->str);
+    g_printerr ("@@@@@@@@@@ markdown:\n%.*s\n@@@@@@@@@@\n", (int) text_len,
+                text);
 #endif
 
 #if MTX_DEBUG > 2
@@ -2991,16 +3512,26 @@ mtx_cmm_mtx (MtxCmm *self,
 
     self->priv->seen_unit_types = 0;
     i =
-    mtx_cmm_render (self, ret->str, ret->len, mtx_cmm_render_process_output,
+    mtx_cmm_render (self, text, text_len, mtx_cmm_render_process_output,
                     NULL,
                     (do_tables ? MD_FLAG_TABLES : 0) |
                     MD_FLAG_STRIKETHROUGH |
                     (do_permlink ? MD_FLAG_PERMISSIVEAUTOLINKS : 0),
                     MD_HTML_FLAG_SKIP_UTF8_BOM | MD_HTML_FLAG_XHTML);
-    g_string_free (ret, TRUE);
+
+    /* The parser queue owns copies of all the text it needs from here on. */
+    if (edit != NULL)
+    {
+        g_string_free (edit, TRUE);
+    }
+    if (clear_markdown != NULL)
+    {
+        g_free (*clear_markdown);
+        *clear_markdown = NULL;
+    }
     if (i < 0)
     {
-        return NULL;
+        return FALSE;
     }
 #if MTX_DEBUG > 2
     g_printerr ("%s\n", phase);
@@ -3057,9 +3588,9 @@ mtx_cmm_mtx (MtxCmm *self,
     adding them to the pass-through set unless handled by an earlier case label.
     */
 
-    for (i = g_queue_get_length (unitq) - 1; i >= 0; i--)
+    for (i = (gint) unitq->len - 1; i >= 0; i--)
     {
-        unit = (MtxCmmParserUnit *) g_queue_peek_nth (unitq, i);
+        unit = mtx_cmm_parser_unit_nth (self, i);
         switch (unit->type)
         {
         /*********************************************************************
@@ -3079,13 +3610,11 @@ mtx_cmm_mtx (MtxCmm *self,
             }
             /* fall through */
         case MTX_CMM_PARSER_UNIT_RAW_HTML:     /* inline tag */
-            ref = mtx_cmm_protect (self, (self->priv->tweaks &
-                                          MTX_CMM_TWEAK_UNSAFE_HTML) ?
-                                   unit->text->str : SAFE_HTML);
-            if (ref)
+            if (mtx_cmm_protect (self, (self->priv->tweaks &
+                                        MTX_CMM_TWEAK_UNSAFE_HTML) ?
+                                 unit->text->str : SAFE_HTML, ref))
             {
                 g_string_assign (unit->text, ref);
-                g_free (ref);
             }
             if (unit->type == MTX_CMM_PARSER_UNIT_BLOCK_HTML
                 && !(self->priv->tweaks & MTX_CMM_TWEAK_UNSAFE_HTML))
@@ -3121,10 +3650,9 @@ mtx_cmm_mtx (MtxCmm *self,
             break;
 
         case MTX_CMM_PARSER_UNIT_SPAN_CODE:
-            if ((ref = mtx_cmm_protect (self, unit->text->str)))
+            if (mtx_cmm_protect (self, unit->text->str, ref))
             {
                 g_string_assign (unit->text, ref);
-                g_free (ref);
             }
             break;
 
@@ -3149,12 +3677,12 @@ mtx_cmm_mtx (MtxCmm *self,
 
                 g_assert (unit->text == NULL);
                 g_assert (unit->args->len == 1);
-                below = g_queue_peek_nth (self->priv->unitq, i + 1);
+                below = mtx_cmm_parser_unit_nth (self, i + 1);
                 g_assert (below && below->flag & MTX_CMM_PARSER_UNIT_FLAG_OPEN);
                 if (self->priv->output == MTX_CMM_OUTPUT_TEXT && below->text
                     == NULL)
                 {
-                    below->text = g_string_new ("");
+                    below->text = mtx_cmm_parser_unit_text_new (self, "", -1);
                 }
                 else
                 {
@@ -3163,10 +3691,9 @@ mtx_cmm_mtx (MtxCmm *self,
                 g_string_append (below->text, g_array_index (unit->args, gchar
                                                              *, 0));
                 mtx_cmm_parser_unit_consume (&unit);
-                if ((ref = mtx_cmm_protect (self, below->text->str)))
+                if (mtx_cmm_protect (self, below->text->str, ref))
                 {
                     g_string_assign (below->text, ref);
-                    g_free (ref);
                 }
             }
             break;
@@ -3241,9 +3768,9 @@ mtx_cmm_mtx (MtxCmm *self,
     the inline mix mentioned above. This happens for loose lists. In this case
     LI delegates text harvesting to the contained P blocks.
     */
-    for (i = g_queue_get_length (unitq) - 1; i >= 0; i--)
+    for (i = (gint) unitq->len - 1; i >= 0; i--)
     {
-        unit = (MtxCmmParserUnit *) g_queue_peek_nth (unitq, i);
+        unit = mtx_cmm_parser_unit_nth (self, i);
         MtxCmmParserUnit *curr;
 
         switch (unit->type)
@@ -3261,8 +3788,7 @@ mtx_cmm_mtx (MtxCmm *self,
                 g_assert (unit->text == NULL);
 
                 /* Harvest text fields up to my closing unit. */
-                while ((curr = (MtxCmmParserUnit *) g_queue_peek_nth
-                        (unitq, --i))
+                while ((curr = mtx_cmm_parser_unit_nth (self, --i))
                        && !(curr->type & unit->type
                             && curr->flag & MTX_CMM_PARSER_UNIT_FLAG_CLOSE))
                 {
@@ -3275,7 +3801,9 @@ mtx_cmm_mtx (MtxCmm *self,
                         }
                         else
                         {
-                            unit->text = g_string_new (curr->text->str);
+                            unit->text =
+                                mtx_cmm_parser_unit_text_new
+                                (self, curr->text->str, curr->text->len);
                         }
                     }
                     mtx_cmm_parser_unit_consume (&curr);
@@ -3320,9 +3848,8 @@ mtx_cmm_mtx (MtxCmm *self,
                 {
                     /* Harvest text fields up to my closing unit  */
                     /* or to the start of a sub-list.             */
-                    unit->text = g_string_new ("");
-                    while ((curr = (MtxCmmParserUnit *) g_queue_peek_nth
-                            (unitq, --i))
+                    unit->text = mtx_cmm_parser_unit_text_new (self, "", -1);
+                    while ((curr = mtx_cmm_parser_unit_nth (self, --i))
                            && !((curr->type & MTX_CMM_PARSER_UNIT_BLOCK_LI
                                  && curr->flag & MTX_CMM_PARSER_UNIT_FLAG_CLOSE)
                                 || (curr->type & (MTX_CMM_PARSER_UNIT_BLOCK_OL |
@@ -3339,7 +3866,9 @@ mtx_cmm_mtx (MtxCmm *self,
                             }
                             else
                             {
-                                unit->text = g_string_new (curr->text->str);
+                                unit->text =
+                                    mtx_cmm_parser_unit_text_new
+                                    (self, curr->text->str, curr->text->len);
                             }
                         }
                         if (curr->type != MTX_CMM_PARSER_UNIT_BLOCK_QUOTE)
@@ -3377,8 +3906,7 @@ mtx_cmm_mtx (MtxCmm *self,
                     g_assert (unit->args && unit->args->len == 1);
                 }
                 /* Harvest text fields up to my closing unit. */
-                while ((curr = (MtxCmmParserUnit *) g_queue_peek_nth
-                        (unitq, --i))
+                while ((curr = mtx_cmm_parser_unit_nth (self, --i))
                        && !(curr->type & unit->type
                             && curr->flag & MTX_CMM_PARSER_UNIT_FLAG_CLOSE))
                 {
@@ -3391,7 +3919,9 @@ mtx_cmm_mtx (MtxCmm *self,
                         }
                         else
                         {
-                            unit->text = g_string_new (curr->text->str);
+                            unit->text =
+                                mtx_cmm_parser_unit_text_new
+                                (self, curr->text->str, curr->text->len);
                         }
                     }
                     mtx_cmm_parser_unit_consume (&curr);
@@ -3435,16 +3965,16 @@ mtx_cmm_mtx (MtxCmm *self,
         && (self->priv->seen_unit_types & MTX_CMM_PARSER_UNIT_BLOCK_QUOTE))
     {
         MtxCmmParserUnit *above;
-        for (i = g_queue_get_length (unitq) - 1; i > 0; i--)
+        for (i = (gint) unitq->len - 1; i > 0; i--)
         {
-            unit = (MtxCmmParserUnit *) g_queue_peek_nth (unitq, i);
+            unit = mtx_cmm_parser_unit_nth (self, i);
 
             if (unit->type == MTX_CMM_PARSER_UNIT_BLOCK_QUOTE
                 && unit->flag & MTX_CMM_PARSER_UNIT_FLAG_CLOSE)
             {
                 for (gint j = i - 1; j >= 0; j--)
                 {
-                    above = g_queue_peek_nth (self->priv->unitq, j);
+                    above = mtx_cmm_parser_unit_nth (self, j);
                     if (above->type != MTX_CMM_PARSER_UNIT_JUNK)
                     {
                         break;
@@ -3492,9 +4022,9 @@ mtx_cmm_mtx (MtxCmm *self,
         glong cmax, clen;
 
         /* Read reversed tables, from </table> to <table> */
-        for (i = 0; i < (gint) g_queue_get_length (unitq) - 1; i++)
+        for (i = 0; i < (gint) unitq->len - 1; i++)
         {
-            unit = (MtxCmmParserUnit *) g_queue_peek_nth (unitq, i);
+            unit = mtx_cmm_parser_unit_nth (self, i);
 
             switch (unit->type)
             {
@@ -3558,10 +4088,10 @@ mtx_cmm_mtx (MtxCmm *self,
                                                 g_ptr_array_index
                                                 (max_col_width, c));
                     }
-                    gchar **a0 = &g_array_index (unit->args, gchar *, 0);
-                    g_free (*a0);
-                    *a0 = serialize->str;
-                    g_string_free (serialize, FALSE);
+                    g_array_index (unit->args, gchar *, 0) =
+                        mtx_cmm_arena_strndup (&self->priv->arena,
+                                               serialize->str, serialize->len);
+                    g_string_free (serialize, TRUE);
                     g_ptr_array_free (max_col_width, TRUE);
                 }
                 break;
@@ -3600,12 +4130,13 @@ mtx_cmm_mtx (MtxCmm *self,
     {
         GPtrArray *max_col_width = NULL;
         gint curr_col = -1;
-        gint cmax, clen, len, end, bufend;
+        gint cmax, clen, len, end;
+        gsize bufsize = 0;
         gchar *a0, *buf = NULL, *p;
 
-        for (i = g_queue_get_length (unitq) - 1; i > 0; i--)
+        for (i = (gint) unitq->len - 1; i > 0; i--)
         {
-            unit = (MtxCmmParserUnit *) g_queue_peek_nth (unitq, i);
+            unit = mtx_cmm_parser_unit_nth (self, i);
 
             switch (unit->type)
             {
@@ -3615,21 +4146,15 @@ mtx_cmm_mtx (MtxCmm *self,
                     max_col_width = g_ptr_array_new ();
                     a0 = g_array_index (unit->args, gchar *, 0);
                     gchar *pos = NULL;
-                    gint tmax = 0;
                     gchar *token = strtok_r (a0, " ", &pos);
 
                     while (token != NULL)
                     {
-                        if ((cmax = atoi (token)) > tmax)
-                        {
-                            tmax = cmax;
-                        }
+                        cmax = atoi (token);
                         g_ptr_array_add (max_col_width,
                                          (gpointer) (glong) cmax);
                         token = strtok_r (NULL, " ", &pos);
                     }
-                    bufend = 4 * tmax; /* UTF-8 */
-                    buf = g_malloc (bufend + 2);
                 }
                 else
                 {
@@ -3660,6 +4185,15 @@ mtx_cmm_mtx (MtxCmm *self,
                     /* corrected for the {'N','L','C','R'} before src */
                     len -= 1; /* bytes */
 
+                    /* The cell bytes include markup and protected code
+                       references, so they can exceed any multiple of the
+                       column width. */
+                    if ((gsize) (len + cmax - clen + 1) > bufsize)
+                    {
+                        bufsize = len + cmax - clen + 1;
+                        buf = g_realloc (buf, bufsize);
+                    }
+
                     /* justify text */
                     switch (src[0])
                     {
@@ -3731,9 +4265,9 @@ mtx_cmm_mtx (MtxCmm *self,
 
     guint blockquote_level = 0, ol_ul_level = 0;
     gchar *copy_of_blockquote_open_str = NULL;
-    for (i = g_queue_get_length (unitq) - 1; i >= 0; i--)
+    for (i = (gint) unitq->len - 1; i >= 0; i--)
     {
-        unit = (MtxCmmParserUnit *) g_queue_peek_nth (unitq, i);
+        unit = mtx_cmm_parser_unit_nth (self, i);
 
         switch (unit->type)
         {
@@ -3773,7 +4307,7 @@ mtx_cmm_mtx (MtxCmm *self,
                 }
                 else
                 {
-                    unit->text = g_string_new (temp);
+                    unit->text = mtx_cmm_parser_unit_text_new (self, temp, -1);
                 }
             }
             else     /* Closing unit. */
@@ -3782,8 +4316,8 @@ mtx_cmm_mtx (MtxCmm *self,
                 g_assert (unit->args && unit->args->len == 1);
                 /* Insert end tag. */
                 unit->text =
-                    g_string_new ((gchar *) g_array_index (unit->args, gchar
-                                                           *, 0));
+                    mtx_cmm_parser_unit_text_new
+                    (self, (gchar *) g_array_index (unit->args, gchar *, 0), -1);
             }
             break;
 
@@ -3821,7 +4355,7 @@ mtx_cmm_mtx (MtxCmm *self,
                 }
                 else
                 {
-                    unit->text = g_string_new ("");
+                    unit->text = mtx_cmm_parser_unit_text_new (self, "", -1);
                 }
 
                 /* Insert start tag. */
@@ -3836,7 +4370,7 @@ mtx_cmm_mtx (MtxCmm *self,
                     temp = (gchar *) g_array_index (unit->args, gchar *, 0);
                     /*
                     NEVER embed LI contents in a font="..." span due to the
-                    limitation of our TextView's _text_buffer_insert_markup()
+                    limitation of our TextView's _text_tag_intern()
                     */
                     temp =
                         g_strdup_printf
@@ -3867,7 +4401,8 @@ mtx_cmm_mtx (MtxCmm *self,
                 render_close_li_block collapses a run of closing LI tags.
                 */
                 unit->text =
-                g_string_new ((gchar *) g_array_index (unit->args, gchar *, 0));
+                mtx_cmm_parser_unit_text_new
+                (self, (gchar *) g_array_index (unit->args, gchar *, 0), -1);
             }
             break;
 
@@ -3894,7 +4429,7 @@ mtx_cmm_mtx (MtxCmm *self,
                 open = unit->flag & MTX_CMM_PARSER_UNIT_FLAG_OPEN;
                 for (gint j = i - 1; j >= 0; j--)
                 {
-                    above = g_queue_peek_nth (self->priv->unitq, j);
+                    above = mtx_cmm_parser_unit_nth (self, j);
                     if (above->type != MTX_CMM_PARSER_UNIT_JUNK)
                         break;
                 }
@@ -3904,7 +4439,8 @@ mtx_cmm_mtx (MtxCmm *self,
                 if (unit->text == NULL || unit->text->len == 0)
                 {
                     unit->text =
-                    g_string_new (open ? "    " : sUNIPUA_PANGO_EMPTY_SPAN);
+                    mtx_cmm_parser_unit_text_new
+                    (self, open ? "    " : sUNIPUA_PANGO_EMPTY_SPAN, -1);
                 }
                 collapse =
                     above ? (above->type == MTX_CMM_PARSER_UNIT_BLOCK_QUOTE
@@ -4026,7 +4562,9 @@ mtx_cmm_mtx (MtxCmm *self,
                 /* Insert filler to keep Pango from dropping an empty span. */
                 if (unit->text == NULL || unit->text->len == 0)
                 {
-                    unit->text = g_string_new (sUNIPUA_PANGO_EMPTY_SPAN);
+                    unit->text =
+                        mtx_cmm_parser_unit_text_new
+                        (self, sUNIPUA_PANGO_EMPTY_SPAN, -1);
                 }
                 snprintf (gap, sizeof (gap), "<span font=\"@%s%d\">",
                           _tag_info[MTX_TAG_OL_UL_LEVEL], ol_ul_level);
@@ -4064,24 +4602,83 @@ mtx_cmm_mtx (MtxCmm *self,
     **********************************************************************";
 #endif
 
+#if MTX_DEBUG > 1
+    _print_priv_table (self->priv->code_table, _SOyel "%s: CODE TABLE:" _SE
+                       "\n", __FUNCTION__);
+#endif
+
     /*
-    Here mtx_cmm_mtx assembles the return value by concatenating unit texts.
-    Unit ->args elements, if any, that weren't merged into a unit text field
-    before this point are ignored and sink for good.
+    Here mtx_cmm_mtx emits the output by concatenating unit texts, releasing
+    (re)protected spans and UNIPUA singletons on the fly.  Each code_ref and
+    singleton lies whole within one unit text, so units are released one at a
+    time.  Unit ->args elements, if any, that weren't merged into a unit text
+    field before this point are ignored and sink for good.
     */
 
-    ret = g_string_new ("");
-    for (i = g_queue_get_length (unitq) - 1; i >= 0; i--)
+    /*
+    A top-level block ends after a closing block unit outside any container.
+    Containers open and close in pairs; if they don't balance, e.g., because
+    a transform consumed one end, the output isn't split into blocks.
+    */
+
+    scratch = g_string_new ("");
+    for (i = (gint) unitq->len - 1; i >= 0 && emitter.ok; i--)
     {
-        unit = (MtxCmmParserUnit *) g_queue_peek_nth (unitq, i);
+        unit = mtx_cmm_parser_unit_nth (self, i);
         if (unit->type & (MTX_CMM_PARSER_UNIT_ARG | MTX_CMM_PARSER_UNIT_JUNK))
         {
             continue;
         }
-        /* Grow result value. */
         if (unit->text && unit->text->len)
         {
-            g_string_append (ret, unit->text->str);
+            (void) mtx_cmm_emit_released (self, &emitter, unit->text, scratch);
+        }
+        if (block_ends != NULL && container_depth >= 0)
+        {
+            if (unit->type & MTX_CMM_PARSER_UNIT_CONTAINERS)
+            {
+                if (unit->flag & MTX_CMM_PARSER_UNIT_FLAG_OPEN)
+                {
+                    ++container_depth;
+                }
+                if (unit->flag & MTX_CMM_PARSER_UNIT_FLAG_CLOSE)
+                {
+                    --container_depth;
+                }
+            }
+            if (container_depth == 0
+                && unit->type & MTX_CMM_PARSER_UNIT_BLOCKS
+                && unit->flag & MTX_CMM_PARSER_UNIT_FLAG_CLOSE)
+            {
+                /* A held-back '\n' belongs to the block it ends. */
+                gsize end = emitter.emitted + (emitter.newline ? 1 : 0);
+                if (block_ends->len == 0
+                    || end > g_array_index (block_ends, gsize,
+                                            block_ends->len - 1))
+                {
+                    g_array_append_val (block_ends, end);
+                }
+            }
+        }
+    }
+    g_string_free (scratch, TRUE);
+
+    if (block_ends != NULL)
+    {
+        /* The held-back final '\n' is dropped, see below. */
+        while (block_ends->len > 0
+               && g_array_index (block_ends, gsize, block_ends->len - 1)
+               >= emitter.emitted)
+        {
+            g_array_set_size (block_ends, block_ends->len - 1);
+        }
+        if (container_depth != 0)
+        {
+            g_array_set_size (block_ends, 0);
+        }
+        else if (emitter.emitted > 0)
+        {
+            g_array_append_val (block_ends, emitter.emitted);
         }
     }
 
@@ -4093,36 +4690,6 @@ mtx_cmm_mtx (MtxCmm *self,
     /* Clean up. */
     mtx_cmm_parser_clear_queues (self);
 
-#if MTX_DEBUG > 2
-    phase = "\
-    **********************************************************************\n\
-    *                                FIN                                 *\n\
-    **********************************************************************";
-    g_printerr ("%s\n", phase);
-#endif
-
-#if MTX_DEBUG > 1
-    _print_priv_table (self->priv->code_table, _SOyel "%s: CODE TABLE:" _SE
-                       "\n", __FUNCTION__);
-    g_printerr ("@@@@@@@@@@ ret->str:\n%s\n@@@@@@@@@@\n", ret->str);
-#endif
-
-    /* Release (re)protected spans. */
-    while (mtx_cmm_string_release_protected (self, ret) > 0)
-        ;
-
-    /* Release UNIPUA singletons. */
-    mtx_cmm_string_release_unipua (self, ret);
-
-    if (ret->len > 0 && ret->str[ret->len - 1] == '\n')
-    {
-        g_string_truncate (ret, ret->len - 1);
-    }
-    temp = ret->str;
-    if (size != NULL)
-    {
-        *size = ret->len;
-    }
-    g_string_free (ret, FALSE);
-    return temp;
+    /* The held-back final '\n' is dropped. */
+    return emitter.ok;
 }
@@ -92,6 +92,12 @@ typedef enum _MtxCmmTagInfo
     MTX_TAG_INFO_LEN,
 } MtxCmmTagInfo;
 
+/* All MtxCmmTagInfo values of one "font" tag, -1 where absent. */
+typedef struct _MtxCmmTagAnnot
+{
+    gint info[MTX_TAG_INFO_LEN];
+} MtxCmmTagAnnot;
+
 typedef gchar *(MtxCmmLinkBuilder)(MtxCmm *, const gchar *text, const gchar *dest, const gchar *title, const gint link_dest_id);
 typedef gchar *(MtxCmmImageBuilder)(MtxCmm *, const gchar *text, const gchar *dest, const gchar *title, const gint link_dest_id);
 typedef gchar *(MtxCmmAImgFormatter)(MtxCmm *, const gchar *text, const gchar *dest, const gchar *title);
@@ -150,6 +156,18 @@ typedef struct _MtxCmmTags
     MtxCmmImageBuilder *image_builder;
 } MtxCmmTags;
 
+/**
+MtxCmmSinkFunc:
+Receive a chunk of converted output, see mtx_cmm_mtx_to_sink.
+@data: output bytes, not NUL-terminated.
+@len: length of @data in bytes, > 0.
+@user_data:
+
+Returns: FALSE to abort the conversion, e.g., on write error.
+*/
+typedef gboolean (*MtxCmmSinkFunc) (const gchar *data, gsize len,
+                                    gpointer user_data);
+
 /**
 mtx_cmm_new:
 
@@ -158,6 +176,8 @@ Returns: a new #MTX_CMM instance.
 MtxCmm * mtx_cmm_new (void);
 
 gchar *mtx_cmm_mtx (MtxCmm *, gchar **, gsize *, const gboolean);
+gchar *mtx_cmm_mtx_blocks (MtxCmm *, gchar **, gsize *, const gboolean, GArray *);
+gboolean mtx_cmm_mtx_to_sink (MtxCmm *, const gchar *, const gsize, MtxCmmSinkFunc, gpointer);
 gboolean mtx_cmm_get_render_indent (MtxCmm *);
 const MtxCmmTags *mtx_cmm_get_output_tags (MtxCmm *);
 MtxCmmOutput mtx_cmm_get_output (MtxCmm *);
@@ -169,7 +189,9 @@ gboolean mtx_cmm_set_tweaks (MtxCmm *, const MtxCmmTweaks);
 gboolean mtx_cmm_get_escape (MtxCmm *);
 gboolean mtx_cmm_set_escape (MtxCmm *, gboolean);
 const gchar *mtx_cmm_get_link_dest (MtxCmm *, const gint link_id);
-gint mtx_cmm_tag_get_info (MtxCmm *, const gchar *tag, const MtxCmmTagInfo subject);
+guint mtx_cmm_get_link_dest_count (MtxCmm *);
+void mtx_cmm_set_link_dest_seed (MtxCmm *, GPtrArray *);
+gboolean mtx_cmm_tag_annot_parse (const gchar *tag, MtxCmmTagAnnot *);
 /*
 Like CommonMark cmark, by default we replace raw HTML with the comment below.
 */
@@ -63,6 +63,13 @@ typedef enum _mtx_cmm_parser_unit_type
 
 } MtxCmmParserUnitType;
 
+/* Block units that can nest other blocks, and all block units. */
+#define MTX_CMM_PARSER_UNIT_CONTAINERS (MTX_CMM_PARSER_UNIT_BLOCK_QUOTE \
+                                        | MTX_CMM_PARSER_UNIT_BLOCK_OL \
+                                        | MTX_CMM_PARSER_UNIT_BLOCK_UL \
+                                        | MTX_CMM_PARSER_UNIT_BLOCK_TABLE)
+#define MTX_CMM_PARSER_UNIT_BLOCKS ((MTX_CMM_PARSER_UNIT_BLOCK_TD << 1) - 1)
+
 typedef enum _mtx_cmm_parser_unit_flag
 {
     MTX_CMM_PARSER_UNIT_FLAG_NULL        = 0,
@@ -79,23 +86,26 @@ typedef struct _mtx_cmm_parser_unit
     GArray                               *args; /* (gchar *) */
 } MtxCmmParserUnit;
 
-typedef enum _MtxCmmRegexType
+typedef struct _mtx_cmm_arena_block
 {
-    MTX_CMM_REGEX_CODE_REF              = 0, /* internal code_refs */
-    MTX_CMM_REGEX_DIRECTIVE,
-    MTX_CMM_REGEX_WORD_SPLIT,
-    MTX_CMM_REGEX_DUMB_QUOTE_PAIR,
-    MTX_CMM_REGEX_UNIPUA,
-    MTX_CMM_REGEX_TILDE_CODE_FENCE,
+    gchar                                *base;
+    gsize                                size;
+} MtxCmmArenaBlock;
 
-    /* keep last */
-    MTX_CMM_REGEX_LEN,                       /* regex_table length */
-} MtxCmmRegexType;
+typedef struct _mtx_cmm_arena
+{
+    GArray                               *blocks; /* (MtxCmmArenaBlock) */
+    guint                                current; /* block being filled */
+    gsize                                used;    /* bytes used in current */
+} MtxCmmArena;
 
 /*******************************************************************************
  ******************************************************************************/
 
 #define MTX_MAX_LI_LEVEL 32 /* maximum OL/UL nesting depth */
+#define MTX_CMM_PARSER_QUEUE_RESERVE 256 /* initial parser queue capacity */
+#define MTX_CMM_ARENA_BLOCK_SIZE (64 * 1024) /* parser arena growth step */
+#define MTX_CMM_POOLED_TEXT_MAX  (16 * 1024) /* larger unit texts aren't recycled */
 
 /*******************************************************************************
  * The parser temporarily replaces tokens with Unicode Private Use Area (PUA)  *
@@ -116,6 +126,14 @@ https://utf8-chartable.de/unicode-utf8-table.pl?number=128&start=62976
 #define iUNIPUA_CODE       0xF601
 #define sUNIPUA_CODE       "\357\230\201"
 #define rUNIPUA_CODE       "\\x{F601}"
+/*
+A code_ref is fixed-width: sUNIPUA_CODE, the code id in zero-padded decimal,
+sUNIPUA_CODE.  Decimal digits are safe from all text transforms.
+*/
+#define MTX_CMM_CODE_REF_DIGITS 7
+#define MTX_CMM_CODE_ID_MAX     9999999
+#define MTX_CMM_CODE_REF_LEN    (2 * (sizeof (sUNIPUA_CODE) - 1) + MTX_CMM_CODE_REF_DIGITS)
+#define MTX_CMM_CODE_REF_SIZE   (MTX_CMM_CODE_REF_LEN + 1)
 /* References for links and image spans. */
 #define iUNIPUA_LINK       0xF602
 #define sUNIPUA_LINK       "\357\230\202"
@@ -159,6 +177,16 @@ https://utf8-chartable.de/unicode-utf8-table.pl?number=128&start=62976
 /* reserved for public header */
 /* #define iUNIPUA_PANGO_EMPTY_SPAN       0xF610 */
 
+/*
+Singletons F600..F60F share the first two UTF-8 bytes; the third byte, minus
+cUNIPUA_FIRST2, indexes the release table.
+*/
+#define cUNIPUA_PREFIX0    '\357'
+#define cUNIPUA_PREFIX1    '\230'
+#define cUNIPUA_FIRST2     '\200'
+#define MTX_CMM_UNIPUA_TABLE_LEN 16
+#define MTX_CMM_UNIPUA_INDEX(i) ((i) - iUNIPUA_BR)
+
 /*******************************************************************************
  ******************************************************************************/
 
@@ -0,0 +1,265 @@
+/* vim:set ts=8 sw=4 et: */
+/*
+MDVIEW MTX
+
+Copyright (C) 2024 step, https://github.com/step-
+
+Licensed under the GNU General Public License Version 2
+
+This program is free software; you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation; either version 2 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program; if not, write to the Free Software
+Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA 02111-1307, USA.
+*/
+
+
+#include <string.h>
+#include <glib.h>
+
+#include "mtxmatch.h"
+
+/*
+An Aho-Corasick automaton finds all the search terms in one scan of the text,
+instead of one strcasestr scan per term.  The trie of the case-folded terms is
+completed into a DFA, so scanning costs one table lookup per byte; upper case
+letters share the transitions of lower case ones.  Each state records the set
+of terms that end there, including through its failure links.
+
+Folding is ASCII-only, like the trigram index, see mtxsearchindex.c.
+*/
+
+#define MTX_MATCH_NONE G_MAXUINT32
+
+struct _MtxMatch
+{
+    guint       n_terms;
+    guint       n_ignored;      /* terms past MTX_MATCH_MAX_TERMS */
+    gchar       **patterns;     /* terms without MTX_MATCH_REQUIRED_PREFIX */
+    guint64     required;       /* term bits */
+    guint64     optional;       /* term bits */
+    guint64     empty;          /* bits of the terms that match any text */
+    guint       n_states;
+    guint32     *delta;         /* [n_states][256] */
+    guint64     *out;           /* [n_states] term bits */
+};
+
+/**
+mtx_match_new:
+Build the matcher of @terms.  A term prefixed by MTX_MATCH_REQUIRED_PREFIX
+must be found in the text; of the other terms, at least one must be found.
+A single MTX_MATCH_REQUIRED_PREFIX character is an ordinary term.
+
+@terms: NULL-terminated array of terms, as parsed by g_shell_parse_argv.
+
+Returns: a new #MtxMatch to be freed with mtx_match_free.
+*/
+MtxMatch *
+mtx_match_new (gchar **terms)
+{
+    MtxMatch *m = g_new0 (MtxMatch, 1);
+    guint max_states = 1;
+    guint32 *fail, *queue;
+    guint head = 0, tail = 0;
+
+    m->n_terms = terms ? g_strv_length (terms) : 0;
+    if (m->n_terms > MTX_MATCH_MAX_TERMS)
+    {
+        m->n_ignored = m->n_terms - MTX_MATCH_MAX_TERMS;
+        m->n_terms = MTX_MATCH_MAX_TERMS;
+    }
+    m->patterns = g_new0 (gchar *, m->n_terms + 1);
+    for (guint t = 0; t < m->n_terms; t++)
+    {
+        const gchar *term = terms[t];
+        const guint64 bit = G_GUINT64_CONSTANT (1) << t;
+
+        if (term[0] == MTX_MATCH_REQUIRED_PREFIX && term[1] != '\0')
+        {
+            m->required |= bit;
+            ++term;
+        }
+        else
+        {
+            m->optional |= bit;
+        }
+        m->patterns[t] = g_ascii_strdown (term, -1);
+        if (*term == '\0')
+        {
+            m->empty |= bit;
+        }
+        max_states += strlen (term);
+    }
+
+    /* trie */
+    m->delta = g_new (guint32, (gsize) max_states * 256);
+    m->out = g_new0 (guint64, max_states);
+    memset (m->delta, 0xff, (gsize) max_states * 256 * sizeof (guint32));
+    m->n_states = 1;
+    for (guint t = 0; t < m->n_terms; t++)
+    {
+        guint32 s = 0;
+
+        for (const guchar *p = (guchar *) m->patterns[t]; *p; p++)
+        {
+            guint32 *next = &m->delta[(gsize) s * 256 + *p];
+            if (*next == MTX_MATCH_NONE)
+            {
+                *next = m->n_states++;
+            }
+            s = *next;
+        }
+        m->out[s] |= G_GUINT64_CONSTANT (1) << t;
+    }
+
+    /* failure links, breadth first */
+    fail = g_new0 (guint32, m->n_states);
+    queue = g_new (guint32, m->n_states);
+    for (guint c = 0; c < 256; c++)
+    {
+        guint32 *next = &m->delta[c];
+        if (*next == MTX_MATCH_NONE)
+        {
+            *next = 0;
+        }
+        else
+        {
+            queue[tail++] = *next;
+        }
+    }
+    while (head < tail)
+    {
+        const guint32 s = queue[head++];
+
+        /* fail[s] is shallower than s, so its output is complete. */
+        m->out[s] |= m->out[fail[s]];
+        for (guint c = 0; c < 256; c++)
+        {
+            guint32 *next = &m->delta[(gsize) s * 256 + c];
+            const guint32 f = m->delta[(gsize) fail[s] * 256 + c];
+            if (*next == MTX_MATCH_NONE)
+            {
+                *next = f;
+            }
+            else
+            {
+                fail[*next] = f;
+                queue[tail++] = *next;
+            }
+        }
+    }
+    g_free (queue);
+    g_free (fail);
+
+    /* case folding */
+    for (guint s = 0; s < m->n_states; s++)
+    {
+        guint32 *row = &m->delta[(gsize) s * 256];
+        for (guint c = 'A'; c <= 'Z'; c++)
+        {
+            row[c] = row[(guchar) g_ascii_tolower (c)];
+        }
+    }
+    return m;
+}
+
+/**
+mtx_match_free:
+*/
+void
+mtx_match_free (MtxMatch *m)
+{
+    if (m == NULL)
+    {
+        return;
+    }
+    g_strfreev (m->patterns);
+    g_free (m->delta);
+    g_free (m->out);
+    g_free (m);
+}
+
+/**
+mtx_match_get_patterns:
+Return: the terms without MTX_MATCH_REQUIRED_PREFIX, case-folded.  The matcher
+owns the array.
+*/
+gchar **
+mtx_match_get_patterns (const MtxMatch *m)
+{
+    g_return_val_if_fail (m != NULL, NULL);
+
+    return m->patterns;
+}
+
+/**
+mtx_match_get_n_ignored:
+Return: the number of terms that mtx_match_new ignored because they came after
+the first MTX_MATCH_MAX_TERMS.
+*/
+guint
+mtx_match_get_n_ignored (const MtxMatch *m)
+{
+    g_return_val_if_fail (m != NULL, 0);
+
+    return m->n_ignored;
+}
+
+static inline gboolean
+mtx_match_satisfied (const MtxMatch *m,
+                     const guint64 found)
+{
+    return (found & m->required) == m->required
+           && (m->optional == 0 || (found & m->optional) != 0);
+}
+
+/**
+mtx_match_contents:
+Scan @len bytes at @s once for all the terms.  The scan stops as soon as the
+terms found satisfy the matcher.
+
+Returns: TRUE if all the required terms, and at least one of the other terms
+if any, are found.  Without terms it returns FALSE.
+*/
+gboolean
+mtx_match_contents (const MtxMatch *m,
+                    const gchar *s,
+                    const gsize len)
+{
+    const guint32 *delta = m->delta;
+    const guint64 *out = m->out;
+    guint64 found = m->empty;
+    guint32 state = 0;
+
+    g_return_val_if_fail (m != NULL && s != NULL, FALSE);
+
+    if (m->n_terms == 0)
+    {
+        return FALSE;
+    }
+    if (mtx_match_satisfied (m, found))
+    {
+        return TRUE;
+    }
+    for (gsize i = 0; i < len; i++)
+    {
+        state = delta[(gsize) state * 256 + (guchar) s[i]];
+        if (out[state] != 0 && (found & out[state]) != out[state])
+        {
+            found |= out[state];
+            if (mtx_match_satisfied (m, found))
+            {
+                return TRUE;
+            }
+        }
+    }
+    return FALSE;
+}
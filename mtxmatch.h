@@ -0,0 +1,51 @@
+/* vim:set ts=8 sw=4 et: */
+/*
+MDVIEW MTX
+
+Copyright (C) 2024 step, https://github.com/step-
+
+Licensed under the GNU General Public License Version 2
+
+This program is free software; you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation; either version 2 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program; if not, write to the Free Software
+Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA 02111-1307, USA.
+*/
+
+#ifndef MTX_MATCH_H
+#define MTX_MATCH_H
+
+#include <glib.h>
+
+G_BEGIN_DECLS
+
+/* Single-pass, ASCII case-insensitive matcher of a set of search terms. */
+
+/* Terms after the first MTX_MATCH_MAX_TERMS are ignored, see
+mtx_match_get_n_ignored. */
+#define MTX_MATCH_MAX_TERMS 64
+
+/* A term that starts with this prefix is required (AND); other terms are
+alternatives (OR). */
+#define MTX_MATCH_REQUIRED_PREFIX '+'
+
+typedef struct _MtxMatch MtxMatch;
+
+MtxMatch *mtx_match_new (gchar **terms);
+void mtx_match_free (MtxMatch *);
+gchar **mtx_match_get_patterns (const MtxMatch *);
+guint mtx_match_get_n_ignored (const MtxMatch *);
+gboolean mtx_match_contents (const MtxMatch *, const gchar *s, const gsize len);
+
+G_END_DECLS
+
+#endif /* MTX_MATCH_H */
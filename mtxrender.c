@@ -63,6 +63,7 @@ additions for MDVIEW MTX.
 
 void mtx_cmm_parser_unit_new (MtxCmm *, const MtxCmmParserUnitType, const MtxCmmParserUnitFlag);
 int mtx_cmm_parser_find_unit_index (MtxCmm *, const MtxCmmParserUnitType, const MtxCmmParserUnitFlag, const int, MtxCmmParserUnit **);
+gboolean mtx_cmm_parser_unit_nth_matches (MtxCmm *, const MtxCmmParserUnitType, const MtxCmmParserUnitFlag, const int);
 gboolean mtx_cmm_parser_top_unit_ends_line (MtxCmm *);
 
 #define PARSER(r)         ((MtxCmm *)(r)->userdata)
@@ -91,10 +92,10 @@ gboolean mtx_cmm_parser_top_unit_ends_line (MtxCmm *);
 #define R2_GET_TOP_UNIT(r) mtx_cmm_parser_get_unit_head (PARSER(r))
 
 #define R2_IS_TOP_UNIT(r, type_mask, flag_mask) \
-    (mtx_cmm_parser_find_unit_index (PARSER(r), type_mask, flag_mask, 0, NULL) == 0)
+    mtx_cmm_parser_unit_nth_matches (PARSER(r), type_mask, flag_mask, 0)
 
 #define R2_IS_UNIT_BELOW(r, type_mask, flag_mask) \
-    (mtx_cmm_parser_find_unit_index (PARSER(r), type_mask, flag_mask, 1, NULL) == 1)
+    mtx_cmm_parser_unit_nth_matches (PARSER(r), type_mask, flag_mask, 1)
 
 #define R2_TOP_UNIT_ENDS_WITH_NEWLINE(r) \
     mtx_cmm_parser_top_unit_ends_line (PARSER(r))
@@ -0,0 +1,684 @@
+/* vim:set ts=8 sw=4 et: */
+/*
+MDVIEW MTX
+
+Copyright (C) 2024 step, https://github.com/step-
+
+Licensed under the GNU General Public License Version 2
+
+This program is free software; you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation; either version 2 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program; if not, write to the Free Software
+Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA 02111-1307, USA.
+*/
+
+#include <errno.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/stat.h>
+#include <glib.h>
+#include <glib/gstdio.h>
+
+#include "mtxsearchindex.h"
+#include "mtxversion.h"
+
+/*
+The viewer's directory search matches terms as case-insensitive substrings,
+see do_file_search.  A word index can't answer substring queries, so the index
+maps each case-folded byte trigram to the ascending ids of the files that
+contain it.  A file can contain a term only if it contains every trigram of the
+term, so the candidate files of a term are the intersection of the posting
+lists of its trigrams.  The caller reads only the candidates to confirm the
+match.  Terms shorter than a trigram can't be filtered.
+
+Folding is ASCII-only, like the matcher that confirms, see mtxmatch.c.
+
+Each file entry is stamped with mtime and size.  A stale file's id dies and the
+file is indexed again under a new id, so posting lists stay sorted by appending;
+dead ids are skipped by queries and dropped when the index is saved.
+
+On disk, MTX_SEARCH_INDEX_CACHE_DIR/search-SHA1.idx, where SHA1 is the checksum
+of the directory pathname, holds unsigned LEB128 varints:
+  magic
+  n_files { name_len name mtime_ns size kind }
+  n_trigrams { trigram n_ids { id_delta } }
+*/
+
+#define MTX_SEARCH_INDEX_MAGIC "MDVIDX01"
+
+typedef struct _mtx_search_index_file
+{
+    gchar               *name;          /* directory-relative */
+    guint64             mtime;          /* ns */
+    guint64             size;
+    MtxSearchIndexKind  kind;
+    guint               generation;     /* last seen */
+} MtxSearchIndexFile;
+
+struct _MtxSearchIndex
+{
+    gchar               *directory;
+    gchar               *path;          /* index file */
+    GPtrArray           *files;         /* (MtxSearchIndexFile *) by id,
+                                           NULL if dead */
+    GHashTable          *names;         /* name => id + 1 of live file */
+    GHashTable          *postings;      /* trigram => GArray (guint32) ids */
+    guint               generation;
+    gboolean            dirty;          /* differs from the index file */
+};
+
+static void
+mtx_search_index_file_free (MtxSearchIndexFile *f)
+{
+    if (f != NULL)
+    {
+        g_free (f->name);
+        g_free (f);
+    }
+}
+
+static inline guint64
+mtx_search_index_mtime (const struct stat *st)
+{
+    return (guint64) st->st_mtim.tv_sec * G_GUINT64_CONSTANT (1000000000)
+           + (guint64) st->st_mtim.tv_nsec;
+}
+
+static inline guint32
+mtx_search_index_trigram (const gchar *p)
+{
+    return (guint32) (guchar) g_ascii_tolower (p[0]) << 16
+           | (guint32) (guchar) g_ascii_tolower (p[1]) << 8
+           | (guint32) (guchar) g_ascii_tolower (p[2]);
+}
+
+static gint
+mtx_search_index_cmp_guint32 (gconstpointer a,
+                              gconstpointer b)
+{
+    const guint32 x = *(const guint32 *) a, y = *(const guint32 *) b;
+    return x < y ? -1 : x > y;
+}
+
+/**
+mtx_search_index_trigrams:
+Return: a new sorted array of the distinct trigrams of @len bytes at @s.
+This function doesn't touch any index, so it can run in a worker thread.
+*/
+GArray *
+mtx_search_index_trigrams (const gchar *s,
+                           const gsize len)
+{
+    GArray *a = g_array_sized_new (FALSE, FALSE, sizeof (guint32),
+                                   len > 2 ? len - 2 : 0);
+    guint n = 0;
+
+    for (gsize i = 0; i + 2 < len; i++)
+    {
+        guint32 t = mtx_search_index_trigram (s + i);
+        g_array_append_val (a, t);
+    }
+    g_array_sort (a, mtx_search_index_cmp_guint32);
+    for (guint i = 0; i < a->len; i++)
+    {
+        if (n == 0 || g_array_index (a, guint32, i)
+            != g_array_index (a, guint32, n - 1))
+        {
+            g_array_index (a, guint32, n++) = g_array_index (a, guint32, i);
+        }
+    }
+    g_array_set_size (a, n);
+    return a;
+}
+
+/**
+mtx_search_index_posting:
+Return: (transfer none) the posting list of @trigram, created if @create.
+*/
+static GArray *
+mtx_search_index_posting (MtxSearchIndex *idx,
+                          const guint32 trigram,
+                          const gboolean create)
+{
+    GArray *ids = g_hash_table_lookup (idx->postings,
+                                       GUINT_TO_POINTER (trigram));
+    if (ids == NULL && create)
+    {
+        ids = g_array_new (FALSE, FALSE, sizeof (guint32));
+        g_hash_table_insert (idx->postings, GUINT_TO_POINTER (trigram), ids);
+    }
+    return ids;
+}
+
+/**
+mtx_search_index_insert_file:
+Append @f to the index.
+Return: the file id.
+*/
+static guint32
+mtx_search_index_insert_file (MtxSearchIndex *idx,
+                              MtxSearchIndexFile *f)
+{
+    const guint32 id = idx->files->len;
+
+    g_ptr_array_add (idx->files, f);
+    g_hash_table_replace (idx->names, f->name, GUINT_TO_POINTER (id + 1));
+    return id;
+}
+
+/*********************************************************************
+*                             PERSISTENCE                            *
+*********************************************************************/
+
+typedef struct
+{
+    const guchar *p;
+    const guchar *end;
+    gboolean ok;
+} MtxSearchIndexReader;
+
+static guint64
+mtx_search_index_read_varint (MtxSearchIndexReader *r)
+{
+    guint64 v = 0;
+
+    for (guint shift = 0; r->ok && shift < 64; shift += 7)
+    {
+        if (r->p >= r->end)
+        {
+            break;
+        }
+        v |= (guint64) (*r->p & 0x7f) << shift;
+        if ((*r->p++ & 0x80) == 0)
+        {
+            return v;
+        }
+    }
+    r->ok = FALSE;
+    return 0;
+}
+
+static void
+mtx_search_index_write_varint (GByteArray *b,
+                               guint64 v)
+{
+    guint8 c;
+
+    do
+    {
+        c = v & 0x7f;
+        v >>= 7;
+        if (v != 0)
+        {
+            c |= 0x80;
+        }
+        g_byte_array_append (b, &c, 1);
+    }
+    while (v != 0);
+}
+
+/**
+mtx_search_index_load:
+Fill the empty index @idx from its index file.
+Return: FALSE if the index file is missing or corrupt; @idx is left empty.
+*/
+static gboolean
+mtx_search_index_load (MtxSearchIndex *idx)
+{
+    g_autofree gchar *contents = NULL;
+    gsize len;
+    MtxSearchIndexReader r;
+    guint64 n, m, id, name_len;
+
+    if (!g_file_get_contents (idx->path, &contents, &len, NULL)
+        || len < sizeof (MTX_SEARCH_INDEX_MAGIC) - 1
+        || memcmp (contents, MTX_SEARCH_INDEX_MAGIC,
+                   sizeof (MTX_SEARCH_INDEX_MAGIC) - 1) != 0)
+    {
+        return FALSE;
+    }
+    r.p = (const guchar *) contents + sizeof (MTX_SEARCH_INDEX_MAGIC) - 1;
+    r.end = (const guchar *) contents + len;
+    r.ok = TRUE;
+
+    n = mtx_search_index_read_varint (&r);
+    for (guint64 i = 0; r.ok && i < n; i++)
+    {
+        MtxSearchIndexFile *f;
+
+        name_len = mtx_search_index_read_varint (&r);
+        if (!r.ok || name_len == 0 || name_len > (guint64) (r.end - r.p))
+        {
+            r.ok = FALSE;
+            break;
+        }
+        f = g_new0 (MtxSearchIndexFile, 1);
+        f->name = g_strndup ((const gchar *) r.p, name_len);
+        r.p += name_len;
+        f->mtime = mtx_search_index_read_varint (&r);
+        f->size = mtx_search_index_read_varint (&r);
+        f->kind = mtx_search_index_read_varint (&r);
+        if (f->kind > MTX_SEARCH_INDEX_KIND_MARKDOWN)
+        {
+            r.ok = FALSE;
+        }
+        mtx_search_index_insert_file (idx, f);
+    }
+
+    n = mtx_search_index_read_varint (&r);
+    for (guint64 i = 0; r.ok && i < n; i++)
+    {
+        guint32 trigram = mtx_search_index_read_varint (&r);
+        GArray *ids;
+
+        m = mtx_search_index_read_varint (&r);
+        if (!r.ok || m > (guint64) (r.end - r.p))
+        {
+            r.ok = FALSE;
+            break;
+        }
+        ids = mtx_search_index_posting (idx, trigram, TRUE);
+        id = 0;
+        for (guint64 j = 0; r.ok && j < m; j++)
+        {
+            guint32 v;
+
+            id += mtx_search_index_read_varint (&r);
+            if (id >= idx->files->len)
+            {
+                r.ok = FALSE;
+                break;
+            }
+            v = id;
+            g_array_append_val (ids, v);
+        }
+    }
+
+    if (!r.ok)
+    {
+        g_hash_table_remove_all (idx->names);
+        g_hash_table_remove_all (idx->postings);
+        g_ptr_array_set_size (idx->files, 0);
+    }
+    return r.ok;
+}
+
+/**
+mtx_search_index_save:
+Write the index to its index file, dropping dead files, if the index changed
+since it was loaded or saved.
+
+Returns: FALSE on error.
+*/
+gboolean
+mtx_search_index_save (MtxSearchIndex *idx)
+{
+    GByteArray *b;
+    GHashTableIter iter;
+    gpointer key, value;
+    GError *err = NULL;
+    guint32 *remap, live = 0;
+    g_autofree gchar *dir = NULL;
+
+    g_return_val_if_fail (idx != NULL, FALSE);
+    if (!idx->dirty)
+    {
+        return TRUE;
+    }
+
+    /* Renumber live files consecutively. */
+    remap = g_new (guint32, idx->files->len + 1);
+    b = g_byte_array_new ();
+    g_byte_array_append (b, (const guint8 *) MTX_SEARCH_INDEX_MAGIC,
+                         sizeof (MTX_SEARCH_INDEX_MAGIC) - 1);
+    mtx_search_index_write_varint (b, g_hash_table_size (idx->names));
+    for (guint i = 0; i < idx->files->len; i++)
+    {
+        MtxSearchIndexFile *f = g_ptr_array_index (idx->files, i);
+        gsize len;
+
+        if (f == NULL)
+        {
+            remap[i] = G_MAXUINT32;
+            continue;
+        }
+        remap[i] = live++;
+        len = strlen (f->name);
+        mtx_search_index_write_varint (b, len);
+        g_byte_array_append (b, (const guint8 *) f->name, len);
+        mtx_search_index_write_varint (b, f->mtime);
+        mtx_search_index_write_varint (b, f->size);
+        mtx_search_index_write_varint (b, f->kind);
+    }
+
+    mtx_search_index_write_varint (b, g_hash_table_size (idx->postings));
+    g_hash_table_iter_init (&iter, idx->postings);
+    while (g_hash_table_iter_next (&iter, &key, &value))
+    {
+        GArray *ids = value;
+        guint n = 0;
+        guint32 prev = 0;
+
+        for (guint i = 0; i < ids->len; i++)
+        {
+            n += remap[g_array_index (ids, guint32, i)] != G_MAXUINT32;
+        }
+        mtx_search_index_write_varint (b, GPOINTER_TO_UINT (key));
+        mtx_search_index_write_varint (b, n);
+        n = 0;
+        for (guint i = 0; i < ids->len; i++)
+        {
+            guint32 id = remap[g_array_index (ids, guint32, i)];
+            if (id != G_MAXUINT32)
+            {
+                mtx_search_index_write_varint (b, id - prev);
+                prev = id;
+                g_array_index (ids, guint32, n++) = id;
+            }
+        }
+        g_array_set_size (ids, n);
+    }
+    g_free (remap);
+
+    /* Renumber the files in memory to match. */
+    for (guint i = 0, j = 0; i < idx->files->len; i++)
+    {
+        gpointer f = g_ptr_array_index (idx->files, i);
+        if (f != NULL)
+        {
+            g_ptr_array_index (idx->files, i) = NULL;
+            g_ptr_array_index (idx->files, j++) = f;
+        }
+    }
+    g_ptr_array_set_size (idx->files, live);
+    g_hash_table_remove_all (idx->names);
+    for (guint i = 0; i < idx->files->len; i++)
+    {
+        MtxSearchIndexFile *f = g_ptr_array_index (idx->files, i);
+        g_hash_table_replace (idx->names, f->name, GUINT_TO_POINTER (i + 1));
+    }
+
+    dir = g_path_get_dirname (idx->path);
+    if (g_mkdir_with_parents (dir, 0700) == 0)
+    {
+        g_file_set_contents (idx->path, (const gchar *) b->data, b->len, &err);
+    }
+    else
+    {
+        err = g_error_new (G_FILE_ERROR, g_file_error_from_errno (errno),
+                           "%s: %s", dir, g_strerror (errno));
+    }
+    g_byte_array_unref (b);
+    if (err != NULL)
+    {
+        g_printerr ("%s: %s\n", PROGNAME, err->message);
+        g_error_free (err);
+        return FALSE;
+    }
+    idx->dirty = FALSE;
+    return TRUE;
+}
+
+/*********************************************************************
+*                                 API                                *
+*********************************************************************/
+
+/**
+mtx_search_index_open:
+Open the index of @directory, loading its index file if any.
+
+@directory: absolute pathname.
+
+Returns: a new index.  Free with mtx_search_index_free.
+*/
+MtxSearchIndex *
+mtx_search_index_open (const gchar *directory)
+{
+    MtxSearchIndex *idx;
+    g_autofree gchar *sum = NULL, *name = NULL;
+
+    g_return_val_if_fail (directory != NULL, NULL);
+
+    idx = g_new0 (MtxSearchIndex, 1);
+    idx->directory = g_strdup (directory);
+    sum = g_compute_checksum_for_string (G_CHECKSUM_SHA1, directory, -1);
+    name = g_strdup_printf ("search-%s.idx", sum);
+    idx->path = g_build_filename (g_get_user_cache_dir (),
+                                  MTX_SEARCH_INDEX_CACHE_DIR, name, NULL);
+    idx->files = g_ptr_array_new_with_free_func ((GDestroyNotify)
+                                                 mtx_search_index_file_free);
+    idx->names = g_hash_table_new (g_str_hash, g_str_equal);
+    idx->postings = g_hash_table_new_full (g_direct_hash, g_direct_equal,
+                                           NULL,
+                                           (GDestroyNotify) g_array_unref);
+    (void) mtx_search_index_load (idx);
+    return idx;
+}
+
+/**
+mtx_search_index_free:
+*/
+void
+mtx_search_index_free (MtxSearchIndex *idx)
+{
+    if (idx == NULL)
+    {
+        return;
+    }
+    g_hash_table_destroy (idx->postings);
+    g_hash_table_destroy (idx->names);
+    g_ptr_array_unref (idx->files);
+    g_free (idx->path);
+    g_free (idx->directory);
+    g_free (idx);
+}
+
+/**
+mtx_search_index_get_directory:
+*/
+const gchar *
+mtx_search_index_get_directory (MtxSearchIndex *idx)
+{
+    g_return_val_if_fail (idx != NULL, NULL);
+    return idx->directory;
+}
+
+/**
+mtx_search_index_begin:
+Start a directory scan.  Files that the scan neither looks up nor adds are
+removed by mtx_search_index_prune.
+*/
+void
+mtx_search_index_begin (MtxSearchIndex *idx)
+{
+    g_return_if_fail (idx != NULL);
+    idx->generation++;
+}
+
+/**
+mtx_search_index_lookup:
+
+@name: directory-relative file name.
+@st: the file's current stat.
+
+Returns: the kind of @name if it is indexed and up-to-date, otherwise
+MTX_SEARCH_INDEX_KIND_UNKNOWN and @name should be added again.
+*/
+MtxSearchIndexKind
+mtx_search_index_lookup (MtxSearchIndex *idx,
+                         const gchar *name,
+                         const struct stat *st)
+{
+    gpointer id;
+    MtxSearchIndexFile *f;
+
+    g_return_val_if_fail (idx != NULL, MTX_SEARCH_INDEX_KIND_UNKNOWN);
+    if ((id = g_hash_table_lookup (idx->names, name)) == NULL)
+    {
+        return MTX_SEARCH_INDEX_KIND_UNKNOWN;
+    }
+    f = g_ptr_array_index (idx->files, GPOINTER_TO_UINT (id) - 1);
+    if (f->mtime != mtx_search_index_mtime (st)
+        || f->size != (guint64) st->st_size)
+    {
+        return MTX_SEARCH_INDEX_KIND_UNKNOWN;
+    }
+    f->generation = idx->generation;
+    return f->kind;
+}
+
+/**
+mtx_search_index_add:
+Index file @name, replacing any previous entry.
+
+@name: directory-relative file name.
+@st: the stat of the file that @trigrams were taken from.
+@trigrams: the result of mtx_search_index_trigrams, NULLABLE.  Only text kinds
+are indexed.
+*/
+void
+mtx_search_index_add (MtxSearchIndex *idx,
+                      const gchar *name,
+                      const struct stat *st,
+                      const MtxSearchIndexKind kind,
+                      GArray *trigrams)
+{
+    MtxSearchIndexFile *f;
+    gpointer old;
+    guint32 id;
+
+    g_return_if_fail (idx != NULL && name != NULL && st != NULL);
+
+    if ((old = g_hash_table_lookup (idx->names, name)) != NULL)
+    {
+        /* The old id dies; its postings are dropped on save. */
+        gpointer *slot = &g_ptr_array_index (idx->files,
+                                             GPOINTER_TO_UINT (old) - 1);
+        g_hash_table_remove (idx->names, name);
+        mtx_search_index_file_free (*slot);
+        *slot = NULL;
+    }
+    f = g_new0 (MtxSearchIndexFile, 1);
+    f->name = g_strdup (name);
+    f->mtime = mtx_search_index_mtime (st);
+    f->size = st->st_size;
+    f->kind = kind;
+    f->generation = idx->generation;
+    id = mtx_search_index_insert_file (idx, f);
+    idx->dirty = TRUE;
+
+    if (trigrams != NULL && (kind == MTX_SEARCH_INDEX_KIND_TEXT
+                             || kind == MTX_SEARCH_INDEX_KIND_MARKDOWN))
+    {
+        for (guint i = 0; i < trigrams->len; i++)
+        {
+            g_array_append_val (mtx_search_index_posting
+                                (idx, g_array_index (trigrams, guint32, i),
+                                 TRUE), id);
+        }
+    }
+}
+
+/**
+mtx_search_index_prune:
+Remove the files that weren't seen since mtx_search_index_begin.
+*/
+void
+mtx_search_index_prune (MtxSearchIndex *idx)
+{
+    g_return_if_fail (idx != NULL);
+
+    for (guint i = 0; i < idx->files->len; i++)
+    {
+        MtxSearchIndexFile *f = g_ptr_array_index (idx->files, i);
+
+        if (f != NULL && f->generation != idx->generation)
+        {
+            g_hash_table_remove (idx->names, f->name);
+            g_ptr_array_index (idx->files, i) = NULL;
+            mtx_search_index_file_free (f);
+            idx->dirty = TRUE;
+        }
+    }
+}
+
+/**
+mtx_search_index_query:
+Find the files that may contain any of @terms.
+
+Returns: a new set of copies of directory-relative file names, so the set
+stays valid while @idx changes, or NULL if some term is too short to narrow
+the search down, so all text files are candidates.
+*/
+GHashTable *
+mtx_search_index_query (MtxSearchIndex *idx,
+                        gchar **terms)
+{
+    GHashTable *found;
+
+    g_return_val_if_fail (idx != NULL && terms != NULL, NULL);
+
+    for (guint t = 0; terms[t]; t++)
+    {
+        if (strlen (terms[t]) < 3)
+        {
+            return NULL;
+        }
+    }
+    found = g_hash_table_new_full (g_str_hash, g_str_equal, g_free, NULL);
+    for (guint t = 0; terms[t]; t++)
+    {
+        GArray *trigrams = mtx_search_index_trigrams (terms[t],
+                                                      strlen (terms[t]));
+        GArray **lists = g_new (GArray *, trigrams->len);
+        guint n = 0;
+
+        /* Intersect the posting lists, shortest first. */
+        for (guint i = 0; i < trigrams->len; i++)
+        {
+            if ((lists[n] = mtx_search_index_posting
+                 (idx, g_array_index (trigrams, guint32, i), FALSE)) == NULL)
+            {
+                n = 0;
+                break;
+            }
+            if (lists[n]->len < lists[0]->len)
+            {
+                GArray *tmp = lists[0];
+                lists[0] = lists[n];
+                lists[n] = tmp;
+            }
+            n++;
+        }
+        for (guint i = 0; n > 0 && i < lists[0]->len; i++)
+        {
+            const guint32 id = g_array_index (lists[0], guint32, i);
+            MtxSearchIndexFile *f = g_ptr_array_index (idx->files, id);
+            gboolean all = f != NULL;
+
+            for (guint k = 1; all && k < n; k++)
+            {
+                all = bsearch (&id, lists[k]->data, lists[k]->len,
+                               sizeof (guint32),
+                               mtx_search_index_cmp_guint32) != NULL;
+            }
+            if (all)
+            {
+                g_hash_table_add (found, g_strdup (f->name));
+            }
+        }
+        g_free (lists);
+        g_array_unref (trigrams);
+    }
+    return found;
+}
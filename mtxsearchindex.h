@@ -0,0 +1,60 @@
+/* vim:set ts=8 sw=4 et: */
+/*
+MDVIEW MTX
+
+Copyright (C) 2024 step, https://github.com/step-
+
+Licensed under the GNU General Public License Version 2
+
+This program is free software; you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation; either version 2 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program; if not, write to the Free Software
+Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA 02111-1307, USA.
+ */
+
+#ifndef MTX_SEARCH_INDEX_H
+#define MTX_SEARCH_INDEX_H
+
+#include <sys/stat.h>
+#include <glib.h>
+
+G_BEGIN_DECLS
+
+/* Persistent trigram index of the text files of a directory. */
+
+/* Index files live in $XDG_CACHE_HOME/MTX_SEARCH_INDEX_CACHE_DIR. */
+#define MTX_SEARCH_INDEX_CACHE_DIR "mdview"
+
+typedef enum _MtxSearchIndexKind
+{
+    MTX_SEARCH_INDEX_KIND_UNKNOWN = 0,  /* not indexed, or stale */
+    MTX_SEARCH_INDEX_KIND_OTHER,        /* not a text file */
+    MTX_SEARCH_INDEX_KIND_TEXT,
+    MTX_SEARCH_INDEX_KIND_MARKDOWN,
+} MtxSearchIndexKind;
+
+typedef struct _MtxSearchIndex MtxSearchIndex;
+
+MtxSearchIndex *mtx_search_index_open (const gchar *directory);
+void mtx_search_index_free (MtxSearchIndex *);
+const gchar *mtx_search_index_get_directory (MtxSearchIndex *);
+void mtx_search_index_begin (MtxSearchIndex *);
+MtxSearchIndexKind mtx_search_index_lookup (MtxSearchIndex *, const gchar *name, const struct stat *);
+void mtx_search_index_add (MtxSearchIndex *, const gchar *name, const struct stat *, const MtxSearchIndexKind, GArray *trigrams);
+GArray *mtx_search_index_trigrams (const gchar *s, const gsize len);
+void mtx_search_index_prune (MtxSearchIndex *);
+GHashTable *mtx_search_index_query (MtxSearchIndex *, gchar **terms);
+gboolean mtx_search_index_save (MtxSearchIndex *);
+
+G_END_DECLS
+
+#endif /* MTX_SEARCH_INDEX_H */
@@ -52,6 +52,7 @@ and feature additions for MTX.
  * Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA 02111-1307, USA.
  */
 #include <stdlib.h>
+#include <errno.h>
 #include <sys/types.h>
 #include <sys/stat.h>
 #include <fcntl.h>
@@ -59,6 +60,7 @@ and feature additions for MTX.
 #include <gdk/gdkkeysyms.h>
 #include <string.h>
 
+#include "mtx.h"
 #include "mtxtextview.h"
 #include "mtxdbg.h"
 
@@ -66,6 +68,8 @@ and feature additions for MTX.
 #define MTX_TEXT_VIEW_RIGHT_MARGIN          10
 #define MTX_TEXT_VIEW_PIXEL_ABOVE_LINE       3
 #define MTX_TEXT_VIEW_PIXEL_BELOW_LINE       3
+/* Anonymous tags an incremental update may leave behind before a rebuild. */
+#define MTX_TEXT_VIEW_SPLICE_TAG_SLACK     512
 
 static GdkCursor *hand_cursor = NULL;
 static GdkScreen *screen = NULL;
@@ -135,8 +139,136 @@ static void mtx_text_view_class_init (MtxTextViewClass * klass)
                   G_TYPE_STRING);
 }
 
+static GQuark
+_tag_annot_quark (void)
+{
+    static GQuark q = 0;
+    if (G_UNLIKELY (q == 0))
+    {
+        q = g_quark_from_static_string ("mtx-text-view-tag-annot");
+    }
+    return q;
+}
+
+/**
+_tag_set_annot:
+Decode the converter's metadata from @desc once, when the tag is created, and
+keep it on @tag as a typed MtxCmmTagAnnot.
+*/
+static void
+_tag_set_annot (GtkTextTag *tag,
+                const PangoFontDescription *desc)
+{
+    MtxCmmTagAnnot annot;
+    gchar *font = pango_font_description_to_string (desc);
+
+    if (mtx_cmm_tag_annot_parse (font, &annot))
+    {
+        g_object_set_qdata_full (G_OBJECT (tag), _tag_annot_quark (),
+                                 g_memdup2 (&annot, sizeof (annot)), g_free);
+    }
+    g_free (font);
+}
+
+/**
+_tag_get_annot:
+Return: (transfer none) the MtxCmmTagAnnot of @tag, or NULL if the tag
+carries no converter metadata.
+*/
+static inline const MtxCmmTagAnnot *
+_tag_get_annot (GtkTextTag *tag)
+{
+    return g_object_get_qdata (G_OBJECT (tag), _tag_annot_quark ());
+}
+
+/**
+_pango_attr_signature:
+Append to @sig a string that identifies the text tag properties that
+_text_tag_intern sets for the attributes at @paiter.
+
+Return: FALSE if the run is a link or an image, whose tag must not be shared.
+Link destinations and image paths are deduplicated by the converter, so two
+adjacent links to the same destination have the same signature; but
+load_images_and_mark_links walks tag toggles, and a shared tag would merge the
+two runs into one link or image.
+*/
+static gboolean
+_pango_attr_signature (PangoAttrIterator *paiter,
+                       GString *sig)
+{
+    gboolean shareable = TRUE;
+    static const PangoAttrType int_types[] =
+    {
+        PANGO_ATTR_STYLE, PANGO_ATTR_WEIGHT, PANGO_ATTR_VARIANT,
+        PANGO_ATTR_STRETCH, PANGO_ATTR_SIZE, PANGO_ATTR_UNDERLINE,
+        PANGO_ATTR_STRIKETHROUGH, PANGO_ATTR_RISE
+    };
+    static const PangoAttrType color_types[] =
+    {
+        PANGO_ATTR_FOREGROUND, PANGO_ATTR_BACKGROUND
+    };
+    PangoAttribute *attr;
+
+    if ((attr = pango_attr_iterator_get (paiter, PANGO_ATTR_LANGUAGE)))
+    {
+        const gchar *s =
+        pango_language_to_string (((PangoAttrLanguage *) attr)->value);
+        g_string_append_printf (sig, "l%zu:%s", strlen (s), s);
+    }
+    if ((attr = pango_attr_iterator_get (paiter, PANGO_ATTR_FAMILY)))
+    {
+        const gchar *s = ((PangoAttrString *) attr)->value;
+        g_string_append_printf (sig, "f%zu:%s", strlen (s), s);
+    }
+    for (guint i = 0; i < G_N_ELEMENTS (int_types); i++)
+    {
+        if ((attr = pango_attr_iterator_get (paiter, int_types[i])))
+        {
+            g_string_append_printf (sig, "i%d=%d;", int_types[i],
+                                    ((PangoAttrInt *) attr)->value);
+        }
+    }
+    /* The font string carries the link, image and list metadata. */
+    if ((attr = pango_attr_iterator_get (paiter, PANGO_ATTR_FONT_DESC)))
+    {
+        MtxCmmTagAnnot annot;
+        gchar *s =
+        pango_font_description_to_string (((PangoAttrFontDesc *) attr)->desc);
+        g_string_append_printf (sig, "d%zu:%s", strlen (s), s);
+        if (mtx_cmm_tag_annot_parse (s, &annot)
+            && (annot.info[MTX_TAG_DEST_LINK_URI_ID] >= 0
+                || annot.info[MTX_TAG_DEST_IMAGE_PATH_ID] >= 0))
+        {
+            shareable = FALSE;
+        }
+        g_free (s);
+    }
+    for (guint i = 0; i < G_N_ELEMENTS (color_types); i++)
+    {
+        if ((attr = pango_attr_iterator_get (paiter, color_types[i])))
+        {
+            PangoColor *c = &((PangoAttrColor *) attr)->color;
+            g_string_append_printf (sig, "c%d=%04x%04x%04x;", color_types[i],
+                                    c->red, c->green, c->blue);
+        }
+    }
+    if ((attr = pango_attr_iterator_get (paiter, PANGO_ATTR_SCALE)))
+    {
+        g_string_append_printf (sig, "s%a;", ((PangoAttrFloat *) attr)->value);
+    }
+    return shareable;
+}
+
 /**
-_text_buffer_insert_markup:
+_text_tag_intern:
+Tags are interned by attribute signature, see _pango_attr_signature: runs with
+equal attributes share one anonymous tag, so the tag table grows with the
+number of distinct styles rather than the number of runs.
+
+@sig: the signature of the attributes at @paiter, or NULL for a new tag that
+isn't interned.
+
+Return: (transfer none) the tag for the attributes at @paiter.
 */
 /*
 2024-08-08 step:
@@ -159,174 +291,307 @@ This works for GTK2 and GTK3. However, their code is hefty and outside the API.
 So it becomes essential for our renderer not to embed Pango style tags in
 in an outer <span font="..."> otherwise the viewer won't render the styles.
 */
-static void
-_text_buffer_insert_markup (GtkTextBuffer *buffer,
-                            GtkTextIter *iter,
-                            const gchar *markup)
+static GtkTextTag *
+_text_tag_intern (MtxTextView *self,
+                  PangoAttrIterator *paiter,
+                  const gchar *sig)
 {
-    PangoAttrIterator *paiter;
-    PangoAttrList *attrlist;
-    GtkTextTagTable *tags;
-    GtkTextMark *mark;
-    GError *error = NULL;
-    gchar *text;
+    GtkTextTag *tag = sig ? g_hash_table_lookup (self->tag_intern, sig) : NULL;
+    PangoAttribute *attr;
+    gint ival;
 
-    g_return_if_fail (GTK_IS_TEXT_BUFFER (buffer));
-    g_return_if_fail (markup != NULL);
-    if (markup[0] == '\0')
+    if (tag != NULL)
     {
-        return;
+        return tag;
     }
-    if (!pango_parse_markup (markup, -1, 0, &attrlist, &text, NULL, &error))
+    tag = gtk_text_tag_new (NULL);
+    /* https://docs.gtk.org/Pango/enum.AttrType.html */
+#if MTX_TEXT_VIEW_DEBUG > 0
+    fprintf (stderr, "%s", __FUNCTION__);
+#endif
+
+    if ((attr = pango_attr_iterator_get (paiter, PANGO_ATTR_LANGUAGE)))
     {
-        g_warning ("Invalid markup string: %s", error->message);
-        g_error_free (error);
-        return;
+        g_object_set (tag, "language",
+                      pango_language_to_string (((PangoAttrLanguage *)
+                                                 attr)->value), NULL);
     }
-    /* text without markup */
-    if (attrlist == NULL)
+    if ((attr = pango_attr_iterator_get (paiter, PANGO_ATTR_FAMILY)))
     {
-        gtk_text_buffer_insert (buffer, iter, text, -1);
-        g_free (text);
-        return;
+        g_object_set (tag, "family", ((PangoAttrString *) attr)->value,
+                      NULL);
     }
-
-    mark = gtk_text_buffer_create_mark (buffer, NULL, iter, FALSE);
-    paiter = pango_attr_list_get_iterator (attrlist);
-    tags = gtk_text_buffer_get_tag_table (buffer);
-    do
+    if ((attr = pango_attr_iterator_get (paiter, PANGO_ATTR_STYLE)))
     {
-        gint start, end, ival;
-        PangoAttribute *attr;
-        GtkTextTag *tag = gtk_text_tag_new (NULL);
-
-        pango_attr_iterator_range (paiter, &start, &end);
-        if (end == G_MAXINT)
-        {
-            end = start - 1; /* chunk size > max signed int */
-        }
-        /* https://docs.gtk.org/Pango/enum.AttrType.html */
-
+        ival = ((PangoAttrInt *) attr)->value;
+        g_object_set (tag, "style", ival, NULL);
 #if MTX_TEXT_VIEW_DEBUG > 0
-        fprintf (stderr, "%s (", __FUNCTION__);
-        for (gint i = start; i < end; i++)
-        {
-            fputc (text[i], stderr);
-        }
-        fputc (')', stderr);
+        fprintf (stderr, " style %d", ival);
 #endif
-        if ((attr = pango_attr_iterator_get (paiter, PANGO_ATTR_LANGUAGE)))
-        {
-            g_object_set (tag, "language",
-                          pango_language_to_string (((PangoAttrLanguage *)
-                                                     attr)->value), NULL);
-        }
-        if ((attr = pango_attr_iterator_get (paiter, PANGO_ATTR_FAMILY)))
-        {
-            g_object_set (tag, "family", ((PangoAttrString *) attr)->value,
-                          NULL);
-        }
-        if ((attr = pango_attr_iterator_get (paiter, PANGO_ATTR_STYLE)))
-        {
-            ival = ((PangoAttrInt *) attr)->value;
-            g_object_set (tag, "style", ival, NULL);
+    }
+    if ((attr = pango_attr_iterator_get (paiter, PANGO_ATTR_WEIGHT)))
+    {
+        ival = ((PangoAttrInt *) attr)->value;
+        g_object_set (tag, "weight", ival, NULL);
 #if MTX_TEXT_VIEW_DEBUG > 0
-            fprintf (stderr, " style %d", ival);
+        fprintf (stderr, " weight %d", ival);
 #endif
-        }
-        if ((attr = pango_attr_iterator_get (paiter, PANGO_ATTR_WEIGHT)))
-        {
-            ival = ((PangoAttrInt *) attr)->value;
-            g_object_set (tag, "weight", ival, NULL);
+    }
+    if ((attr = pango_attr_iterator_get (paiter, PANGO_ATTR_VARIANT)))
+    {
+        g_object_set (tag, "variant", ((PangoAttrInt *) attr)->value, NULL);
+    }
+    if ((attr = pango_attr_iterator_get (paiter, PANGO_ATTR_STRETCH)))
+    {
+        g_object_set (tag, "stretch", ((PangoAttrInt *) attr)->value, NULL);
+    }
+    if ((attr = pango_attr_iterator_get (paiter, PANGO_ATTR_SIZE)))
+    {
+        ival = ((PangoAttrInt *) attr)->value;
+        g_object_set (tag, "size", ival, NULL);
 #if MTX_TEXT_VIEW_DEBUG > 0
-            fprintf (stderr, " weight %d", ival);
+        fprintf (stderr, " size %d", ival);
 #endif
-        }
-        if ((attr = pango_attr_iterator_get (paiter, PANGO_ATTR_VARIANT)))
-        {
-            g_object_set (tag, "variant", ((PangoAttrInt *) attr)->value, NULL);
-        }
-        if ((attr = pango_attr_iterator_get (paiter, PANGO_ATTR_STRETCH)))
-        {
-            g_object_set (tag, "stretch", ((PangoAttrInt *) attr)->value, NULL);
-        }
-        if ((attr = pango_attr_iterator_get (paiter, PANGO_ATTR_SIZE)))
-        {
-            ival = ((PangoAttrInt *) attr)->value;
-            g_object_set (tag, "size", ival, NULL);
+    }
+    if ((attr = pango_attr_iterator_get (paiter, PANGO_ATTR_FONT_DESC)))
+    {
+        g_object_set (tag, "font-desc",
+                      ((PangoAttrFontDesc *) attr)->desc, NULL);
+        _tag_set_annot (tag, ((PangoAttrFontDesc *) attr)->desc);
+    }
+    if ((attr = pango_attr_iterator_get (paiter, PANGO_ATTR_FOREGROUND)))
+    {
+        GdkColor col = { 0,
+            ((PangoAttrColor *) attr)->color.red,
+            ((PangoAttrColor *) attr)->color.green,
+            ((PangoAttrColor *) attr)->color.blue
+        };
+        g_object_set (tag, "foreground-gdk", &col, NULL);
+    }
+    if ((attr = pango_attr_iterator_get (paiter, PANGO_ATTR_BACKGROUND)))
+    {
+        GdkColor col = { 0,
+            ((PangoAttrColor *) attr)->color.red,
+            ((PangoAttrColor *) attr)->color.green,
+            ((PangoAttrColor *) attr)->color.blue
+        };
+        g_object_set (tag, "background-gdk", &col, NULL);
+    }
+    if ((attr = pango_attr_iterator_get (paiter, PANGO_ATTR_UNDERLINE)))
+    {
+        ival = ((PangoAttrInt *) attr)->value;
+        g_object_set (tag, "underline", ival, NULL);
 #if MTX_TEXT_VIEW_DEBUG > 0
-            fprintf (stderr, " size %d", ival);
+        fprintf (stderr, " underline %d", ival);
 #endif
-        }
-        if ((attr = pango_attr_iterator_get (paiter, PANGO_ATTR_FONT_DESC)))
-        {
-            g_object_set (tag, "font-desc",
-                          ((PangoAttrFontDesc *) attr)->desc, NULL);
-        }
-        if ((attr = pango_attr_iterator_get (paiter, PANGO_ATTR_FOREGROUND)))
-        {
-            GdkColor col = { 0,
-                ((PangoAttrColor *) attr)->color.red,
-                ((PangoAttrColor *) attr)->color.green,
-                ((PangoAttrColor *) attr)->color.blue
-            };
-            g_object_set (tag, "foreground-gdk", &col, NULL);
-        }
-        if ((attr = pango_attr_iterator_get (paiter, PANGO_ATTR_BACKGROUND)))
-        {
-            GdkColor col = { 0,
-                ((PangoAttrColor *) attr)->color.red,
-                ((PangoAttrColor *) attr)->color.green,
-                ((PangoAttrColor *) attr)->color.blue
-            };
-            g_object_set (tag, "background-gdk", &col, NULL);
-        }
-        if ((attr = pango_attr_iterator_get (paiter, PANGO_ATTR_UNDERLINE)))
-        {
-            ival = ((PangoAttrInt *) attr)->value;
-            g_object_set (tag, "underline", ival, NULL);
+    }
+    if ((attr = pango_attr_iterator_get (paiter, PANGO_ATTR_STRIKETHROUGH)))
+    {
+        g_object_set (tag, "strikethrough",
+                      (gboolean) (((PangoAttrInt *) attr)->value != 0),
+                      NULL);
+    }
+    if ((attr = pango_attr_iterator_get (paiter, PANGO_ATTR_RISE)))
+    {
+        g_object_set (tag, "rise", ((PangoAttrInt *) attr)->value, NULL);
+    }
+    if ((attr = pango_attr_iterator_get (paiter, PANGO_ATTR_SCALE)))
+    {
+        g_object_set (tag, "scale", ((PangoAttrFloat *) attr)->value, NULL);
+    }
+    /* TODO: add attributes underline-gdk (?-rgba), strikethrough-gdk (?-rgba)
+       fallback (int), letter-spacing (int), font-features (string) */
 #if MTX_TEXT_VIEW_DEBUG > 0
-            fprintf (stderr, " underline %d", ival);
+    {
+        gchar *font = NULL;
+        g_object_get (G_OBJECT (tag), "font", &font, NULL);
+        fprintf (stderr, " font %s", font);
+        g_free (font);
+    }
+    fputc ('\n', stderr);
 #endif
-        }
-        if ((attr = pango_attr_iterator_get (paiter, PANGO_ATTR_STRIKETHROUGH)))
+    gtk_text_tag_table_add (gtk_text_buffer_get_tag_table (self->buffer),
+                            tag);
+    if (sig != NULL)
+    {
+        g_hash_table_insert (self->tag_intern, g_strdup (sig), tag);
+    }
+    g_object_unref (tag);
+    return tag;
+}
+
+/**
+_runs_new:
+Parse @markup into plain text and attribute runs, and record where the
+structural empty spans are, see _text_buffer_delete_empty_spans.  Safe to call
+from a worker thread, so that pango markup parsing stays off the main loop.
+
+@len: length of @markup in bytes, or -1 if it is NUL-terminated.
+
+Return: the new runs, or NULL and set @error if @markup is invalid.
+*/
+static MtxTextViewPrivateRuns *
+_runs_new (const gchar *markup,
+           const gssize len,
+           GError **error)
+{
+    MtxTextViewPrivateRuns *r;
+    PangoAttrList *attrs = NULL;
+    gchar *text = NULL;
+
+    if (!pango_parse_markup (markup, len, 0, &attrs, &text, NULL, error))
+    {
+        return NULL;
+    }
+    r = g_new (MtxTextViewPrivateRuns, 1);
+    r->text = text;
+    r->len = strlen (text);
+    r->attrs = attrs;
+    r->count = 0;
+    r->empty_spans = NULL;
+    {
+        const gsize n = sizeof (sUNIPUA_PANGO_EMPTY_SPAN) - 1;
+        const gchar *p = text, *q;
+        gint offset = 0;
+
+        while ((q = strstr (p, sUNIPUA_PANGO_EMPTY_SPAN)) != NULL)
         {
-            g_object_set (tag, "strikethrough",
-                          (gboolean) (((PangoAttrInt *) attr)->value != 0),
-                          NULL);
+            if (r->empty_spans == NULL)
+            {
+                r->empty_spans = g_array_new (FALSE, FALSE, sizeof (gint));
+            }
+            offset += g_utf8_strlen (p, q - p);
+            g_array_append_val (r->empty_spans, offset);
+            offset++;
+            p = q + n;
         }
-        if ((attr = pango_attr_iterator_get (paiter, PANGO_ATTR_RISE)))
+    }
+    if (attrs != NULL)
+    {
+        PangoAttrIterator *paiter = pango_attr_list_get_iterator (attrs);
+        do
         {
-            g_object_set (tag, "rise", ((PangoAttrInt *) attr)->value, NULL);
+            r->count++;
         }
-        if ((attr = pango_attr_iterator_get (paiter, PANGO_ATTR_SCALE)))
+        while (pango_attr_iterator_next (paiter));
+        pango_attr_iterator_destroy (paiter);
+    }
+    return r;
+}
+
+static void
+_runs_free (MtxTextViewPrivateRuns *r)
+{
+    g_free (r->text);
+    if (r->attrs != NULL)
+    {
+        pango_attr_list_unref (r->attrs);
+    }
+    if (r->empty_spans != NULL)
+    {
+        g_array_free (r->empty_spans, TRUE);
+    }
+    g_free (r);
+}
+
+/**
+_text_buffer_insert_runs:
+Insert the text of @runs at @iter all at once, then apply the interned tag of
+each attribute range.  @iter moves to the end of the inserted text.
+*/
+static void
+_text_buffer_insert_runs (MtxTextView *self,
+                          GtkTextIter *iter,
+                          const MtxTextViewPrivateRuns *runs)
+{
+    GtkTextBuffer *buffer = self->buffer;
+    PangoAttrIterator *paiter;
+    GtkTextMark *mark;
+    GString *sig;
+    gint offset;        /* of the inserted text in the buffer, chars */
+    glong chars = 0;    /* from the inserted text start to byte pos */
+    gint pos = 0;
+
+    if (runs->len == 0)
+    {
+        return;
+    }
+    offset = gtk_text_iter_get_offset (iter);
+    gtk_text_buffer_insert (buffer, iter, runs->text, runs->len);
+    for (guint i = 0; runs->empty_spans && i < runs->empty_spans->len; i++)
+    {
+        GtkTextIter at;
+
+        /* right gravity keeps the mark before the character when indentation
+           inserts text in front of it */
+        gtk_text_buffer_get_iter_at_offset
+        (buffer, &at, offset + g_array_index (runs->empty_spans, gint, i));
+        g_ptr_array_add (self->empty_span_marks,
+                         gtk_text_buffer_create_mark (buffer, NULL, &at,
+                                                      FALSE));
+    }
+    if (runs->attrs == NULL)
+    {
+        return;
+    }
+
+    /* applying tags invalidates iterators */
+    mark = gtk_text_buffer_create_mark (buffer, NULL, iter, FALSE);
+    paiter = pango_attr_list_get_iterator (runs->attrs);
+    sig = g_string_sized_new (128);
+    do
+    {
+        gint start, end;
+        GtkTextIter s, e;
+        gboolean shareable;
+
+        pango_attr_iterator_range (paiter, &start, &end);
+        if (end > (gint) runs->len)
         {
-            g_object_set (tag, "scale", ((PangoAttrFloat *) attr)->value, NULL);
+            end = runs->len; /* G_MAXINT */
         }
-        /* TODO: add attributes underline-gdk (?-rgba), strikethrough-gdk (?-rgba)
-           fallback (int), letter-spacing (int), font-features (string) */
-#if MTX_TEXT_VIEW_DEBUG > 0
+        g_string_truncate (sig, 0);
+        shareable = _pango_attr_signature (paiter, sig);
+        if (start >= end || sig->len == 0)
         {
-            gchar *font = NULL;
-            g_object_get (G_OBJECT (tag), "font", &font, NULL);
-            fprintf (stderr, " font %s", font);
-            g_free (font);
+            continue;
         }
-        fputc ('\n', stderr);
+#if MTX_TEXT_VIEW_DEBUG > 0
+        fprintf (stderr, "%s (%.*s)\n", __FUNCTION__, end - start,
+                 runs->text + start);
 #endif
-        gtk_text_tag_table_add (tags, tag);
-        gtk_text_buffer_insert_with_tags (buffer, iter, text + start,
-                                          end - start, tag, NULL);
-        g_object_unref (tag);
-        /* mark moves right after appended text */
-        gtk_text_buffer_get_iter_at_mark (buffer, iter, mark);
+        chars += g_utf8_strlen (runs->text + pos, start - pos);
+        gtk_text_buffer_get_iter_at_offset (buffer, &s, offset + chars);
+        chars += g_utf8_strlen (runs->text + start, end - start);
+        gtk_text_buffer_get_iter_at_offset (buffer, &e, offset + chars);
+        pos = end;
+        gtk_text_buffer_apply_tag (buffer,
+                                   _text_tag_intern (self, paiter,
+                                                     shareable ? sig->str
+                                                     : NULL),
+                                   &s, &e);
     }
     while (pango_attr_iterator_next (paiter));
 
-    gtk_text_buffer_delete_mark (buffer, mark);
+    g_string_free (sig, TRUE);
     pango_attr_iterator_destroy (paiter);
-    pango_attr_list_unref (attrlist);
-    g_free (text);
+    gtk_text_buffer_get_iter_at_mark (buffer, iter, mark);
+    gtk_text_buffer_delete_mark (buffer, mark);
+}
+
+/**
+_page_link_dest:
+Return: the link destination of link_dest @id in the page, or NULL.
+*/
+static const gchar *
+_page_link_dest (MtxTextView *self,
+                 const gint id)
+{
+    if (id < 0 || (guint) id >= self->page_link_dests->len)
+    {
+        return NULL;
+    }
+    return g_ptr_array_index (self->page_link_dests, id);
 }
 
 /**
@@ -355,29 +620,22 @@ mtx_text_view_get_link_at_iter (MtxTextView *self,
     tags = gtk_text_iter_get_tags (iter);
     for (tagp = tags; tagp != NULL; tagp = tagp->next)
     {
-        GtkTextTag *tag = tagp->data;
-        gchar *font = NULL;
-        g_object_get (G_OBJECT (tag), "font", &font, NULL);
-        /* prereq for (concat of) MTX_TAG_DEST_* */
-        if (strstr (font, "@dest=") == NULL)
+        const MtxCmmTagAnnot *annot = _tag_get_annot (tagp->data);
+        if (annot == NULL)
         {
-            g_free (font);
             continue;
         }
-        id = mtx_cmm_tag_get_info (self->markdown, font,
-                                   MTX_TAG_DEST_LINK_URI_ID);
+        id = annot->info[MTX_TAG_DEST_LINK_URI_ID];
         if (id >= 0)
         {
             if (length)
             {
-                *length = mtx_cmm_tag_get_info (self->markdown, font,
-                                                MTX_TAG_DEST_LINK_TXT_LEN);
+                *length = annot->info[MTX_TAG_DEST_LINK_TXT_LEN];
             }
             if (link_dest)
             {
-                *link_dest = mtx_cmm_get_link_dest (self->markdown, id);
+                *link_dest = _page_link_dest (self, id);
             }
-            g_free (font);
             break;
         }
     }
@@ -580,6 +838,46 @@ _text_tag_table_remove_foreach (GtkTextTag *tag,
     g_free (name);
 }
 
+/**
+_page_index_clear:
+Forget the page index, so the next mtx_text_view_set_text rebuilds the whole
+text buffer.
+*/
+static void
+_page_index_clear (MtxTextView *self)
+{
+    for (guint i = 0; i < self->page_blocks->len; i++)
+    {
+        MtxTextViewPrivateBlock *b =
+        &g_array_index (self->page_blocks, MtxTextViewPrivateBlock, i);
+        gtk_text_buffer_delete_mark (self->buffer, b->mark);
+    }
+    g_array_set_size (self->page_blocks, 0);
+    if (self->page_end != NULL)
+    {
+        gtk_text_buffer_delete_mark (self->buffer, self->page_end);
+        self->page_end = NULL;
+    }
+    g_clear_pointer (&self->page_markup, g_free);
+    g_clear_pointer (&self->page_referrer, g_free);
+    if (self->page_link_dests->len > 0)
+    {
+        g_ptr_array_unref (self->page_link_dests);
+        self->page_link_dests = g_ptr_array_new_with_free_func (g_free);
+    }
+    for (guint i = 0; i < self->empty_span_marks->len; i++)
+    {
+        gtk_text_buffer_delete_mark (self->buffer,
+                                     g_ptr_array_index (self->empty_span_marks,
+                                                        i));
+    }
+    g_ptr_array_set_size (self->empty_span_marks, 0);
+    g_hash_table_remove_all (self->page_images);
+    g_cancellable_cancel (self->image_cancellable);
+    g_object_unref (self->image_cancellable);
+    self->image_cancellable = g_cancellable_new ();
+}
+
 /**
 mtx_text_view_reset:
 Reset the text buffer, and remove all anonymous tags for which the application
@@ -590,98 +888,448 @@ mtx_text_view_reset (MtxTextView *self)
 {
     g_return_if_fail (IS_MTX_TEXT_VIEW (self));
 
+    _page_index_clear (self);
+
     GtkTextTagTable *table = gtk_text_buffer_get_tag_table (self->buffer);
     gtk_text_tag_table_foreach (table,
                                 (GtkTextTagTableForeach)
                                 _text_tag_table_remove_foreach, table);
+    g_hash_table_remove_all (self->tag_intern);
     gtk_text_buffer_set_text (self->buffer, "\n", 1);
 }
 
+/*****************
+*  IMAGE CACHE  *
+*****************/
+
+/* Decoded images are shared by all text views of the process, so images that
+appear on many pages, e.g., logos and diagrams, are decoded once.  Images are
+keyed by pathname, file stamp and decoding size.  The least recently used
+images are dropped to stay within the memory budget.  Main thread only. */
+
+typedef struct _mtx_text_view_cached_image
+{
+    gchar *key;
+    GdkPixbuf *pixbuf;
+    gsize cost;             /* bytes */
+    GList *lru;             /* link in image_cache.lru */
+} MtxTextViewCachedImage;
+
+static struct
+{
+    GHashTable *table;      /* key => MtxTextViewCachedImage */
+    GQueue lru;             /* most recently used first */
+    gsize size;             /* bytes */
+    gsize budget;           /* bytes */
+    guint hits;
+    guint misses;
+} image_cache = { NULL, G_QUEUE_INIT, 0, MTX_TEXT_VIEW_IMAGE_CACHE_BUDGET, 0,
+                  0 };
+
+static void
+_cached_image_free (MtxTextViewCachedImage *ci)
+{
+    g_free (ci->key);
+    g_object_unref (ci->pixbuf);
+    g_free (ci);
+}
+
 /**
-get_pixbuf_from_id:
-Get an image pixbuf for a link_dest id.
+_image_cache_trim:
+Drop least recently used images until the cache size is within @budget.
+*/
+static void
+_image_cache_trim (const gsize budget)
+{
+    while (image_cache.size > budget)
+    {
+        MtxTextViewCachedImage *ci = g_queue_pop_tail (&image_cache.lru);
 
-@referrer: absolute pathname (not necessarily directory) to fall back to when
-resolving the image path. NULLABLE.
+        image_cache.size -= ci->cost;
+        g_hash_table_remove (image_cache.table, ci->key);
+    }
+}
 
-Return: pointer to #GdkPixbuf or NULL if no image can be found.
+/**
+_image_cache_lookup:
+Return: a new reference to the cached pixbuf for @key, or NULL.
 */
 static GdkPixbuf *
-get_pixbuf_from_id (MtxTextView *self,
-                    const gint id,
-                    const gchar *referrer)
+_image_cache_lookup (const gchar *key)
 {
-    GdkPixbuf *pixbuf = NULL;
-    const gchar *link_dest;
-    gchar *path, *pi = NULL;
+    MtxTextViewCachedImage *ci =
+    image_cache.table ? g_hash_table_lookup (image_cache.table, key) : NULL;
 
-    if (id < 0)
+    if (ci == NULL)
     {
+        image_cache.misses++;
         return NULL;
     }
-    link_dest = mtx_cmm_get_link_dest (self->markdown, id);
-    /* link_dest format: <uri-encoded>\n<verbatim> */
-    /* get <verbatim> in directory context */
-    path = g_build_filename (self->image_directory,
-                             strchr (link_dest, '\n') + 1, NULL);
-    if (self->auto_languages != NULL)
-    {
-        pi = mtx_text_view_auto_lang_find (self, path);
-    }
-    pixbuf = gdk_pixbuf_new_from_file (pi ? pi : path, NULL);
-    if (pixbuf == NULL && referrer != NULL)
-    {
-        /* retry relative to referrer's directory */
-        gchar *dir = g_path_get_dirname (referrer);
-        g_free (path);
-        path = g_build_filename (dir, strchr (link_dest, '\n') + 1, NULL);
-        g_free (pi);
-        pi = NULL;
-        if (self->auto_languages != NULL)
-        {
-            pi = mtx_text_view_auto_lang_find (self, path);
-        }
-        g_free (dir);
-        pixbuf = gdk_pixbuf_new_from_file (path, NULL);
-    }
-    g_free (pi);
-    g_free (path);
-    return pixbuf;
+    image_cache.hits++;
+    g_queue_unlink (&image_cache.lru, ci->lru);
+    g_queue_push_head_link (&image_cache.lru, ci->lru);
+    return g_object_ref (ci->pixbuf);
 }
 
 /**
+_image_cache_insert:
+Add @pixbuf, which is referenced not copied, to the cache.
 */
 static void
-_clear_link_marks_el (gpointer el, gpointer user_data)
+_image_cache_insert (const gchar *key,
+                     GdkPixbuf *pixbuf)
 {
-    GtkTextBuffer *buffer = GTK_TEXT_BUFFER (user_data);
-    GtkTextMark *mark = ((MtxTextViewLinkInfo *) el)->mark;
-    gtk_text_buffer_delete_mark (buffer, mark);
-    g_free (el);
+    MtxTextViewCachedImage *ci;
+    gsize cost = (gsize) gdk_pixbuf_get_rowstride (pixbuf)
+                 * gdk_pixbuf_get_height (pixbuf) + strlen (key) + 1
+                 + sizeof (MtxTextViewCachedImage);
+
+    if (cost > image_cache.budget)
+    {
+        return;
+    }
+    if (image_cache.table == NULL)
+    {
+        image_cache.table =
+        g_hash_table_new_full (g_str_hash, g_str_equal, NULL,
+                               (GDestroyNotify) _cached_image_free);
+    }
+    ci = g_hash_table_lookup (image_cache.table, key);
+    if (ci != NULL)
+    {
+        g_queue_delete_link (&image_cache.lru, ci->lru);
+        image_cache.size -= ci->cost;
+        g_hash_table_remove (image_cache.table, key);
+    }
+    _image_cache_trim (image_cache.budget - cost);
+    ci = g_new (MtxTextViewCachedImage, 1);
+    ci->key = g_strdup (key);
+    ci->pixbuf = g_object_ref (pixbuf);
+    ci->cost = cost;
+    g_queue_push_head (&image_cache.lru, ci);
+    ci->lru = image_cache.lru.head;
+    image_cache.size += cost;
+    g_hash_table_insert (image_cache.table, ci->key, ci);
 }
 
 /**
-mtx_text_view_link_count:
+mtx_text_view_set_image_cache_budget:
+Set the memory budget of the process-wide image cache.  Zero disables the
+cache.
 
-Returns: the number of markdown links in the page.
+@budget: bytes. Default %MTX_TEXT_VIEW_IMAGE_CACHE_BUDGET.
 */
-guint
-mtx_text_view_link_count (MtxTextView *self)
+void
+mtx_text_view_set_image_cache_budget (const gsize budget)
 {
-    return self->link_marks->len;
+    image_cache.budget = budget;
+    _image_cache_trim (budget);
 }
 
 /**
-mtx_text_view_link_info_get:
+mtx_text_view_get_image_cache_stats:
+Get the counters of the process-wide image cache.
 
-Returns: a pointer to the #MtxTextView structure at the given index or NULL
-for an out-of-range index.  The instance owns the returned memory.
+@hits: number of images found in the cache. NULLABLE.
+@misses: number of images that had to be decoded. NULLABLE.
+@size: current cache size, bytes. NULLABLE.
 */
-const MtxTextViewLinkInfo *
-mtx_text_view_link_info_get (MtxTextView *self,
-                             const guint index_)
+void
+mtx_text_view_get_image_cache_stats (guint *hits,
+                                     guint *misses,
+                                     gsize *size)
 {
-    return g_ptr_array_index (self->link_marks, index_);
+    if (hits)
+    {
+        *hits = image_cache.hits;
+    }
+    if (misses)
+    {
+        *misses = image_cache.misses;
+    }
+    if (size)
+    {
+        *size = image_cache.size;
+    }
+}
+
+/* Images are decoded in worker threads.  load_images_and_mark_links first
+inserts a placeholder of the final image size, an empty child widget, which is
+swapped for the image once decoded; the layout doesn't move meanwhile.
+Images wider than the text view are decoded straight to the view width. */
+
+typedef struct _mtx_text_view_image
+{
+    gchar *path;
+    gint width;                  /* decoding size, pixel */
+    gint height;
+    gchar *key;                  /* image cache key */
+    GtkTextChildAnchor *anchor;  /* placeholder */
+    gchar *alt;                  /* shown if decoding fails. NULLABLE */
+} MtxTextViewImage;
+
+static void
+_image_free (MtxTextViewImage *im)
+{
+    g_free (im->path);
+    g_free (im->key);
+    g_clear_object (&im->anchor);
+    g_free (im->alt);
+    g_free (im);
+}
+
+/**
+_image_new:
+Resolve the image file of link_dest @id, and its decoding size.
+
+@referrer: absolute pathname (not necessarily directory) to fall back to when
+resolving the image path. NULLABLE.
+
+Return: a new image or NULL if no image can be found.
+*/
+static MtxTextViewImage *
+_image_new (MtxTextView *self,
+            const gint id,
+            const gchar *referrer)
+{
+    const gchar *link_dest = _page_link_dest (self, id);
+    const gchar *verbatim;
+    gchar *found = NULL;
+    gint width, height, max_width;
+    GtkAllocation allocation;
+    MtxTextViewImage *im;
+    struct stat st;
+
+    if (link_dest == NULL)
+    {
+        return NULL;
+    }
+    /* link_dest format: <uri-encoded>\n<verbatim> */
+    /* get <verbatim> in directory context, then relative to referrer's
+       directory */
+    verbatim = strchr (link_dest, '\n') + 1;
+    for (guint i = 0; i < 2 && found == NULL; i++)
+    {
+        g_autofree gchar *dir = NULL;
+        gchar *path;
+
+        if (i == 0)
+        {
+            path = g_build_filename (self->image_directory, verbatim, NULL);
+        }
+        else if (referrer != NULL)
+        {
+            dir = g_path_get_dirname (referrer);
+            path = g_build_filename (dir, verbatim, NULL);
+        }
+        else
+        {
+            break;
+        }
+        if (self->auto_languages != NULL)
+        {
+            found = mtx_text_view_auto_lang_find (self, path);
+        }
+        if (found == NULL && g_file_test (path, G_FILE_TEST_IS_REGULAR))
+        {
+            found = g_steal_pointer (&path);
+        }
+        g_free (path);
+    }
+    /* Reading the image header is cheap compared to decoding the image. */
+    if (found == NULL || stat (found, &st) != 0
+        || gdk_pixbuf_get_file_info (found, &width, &height) == NULL)
+    {
+        g_free (found);
+        return NULL;
+    }
+    g_hash_table_add (self->page_images, g_strdup (found));
+
+    gtk_widget_get_allocation (GTK_WIDGET (self), &allocation);
+    max_width = allocation.width - MTX_TEXT_VIEW_LEFT_MARGIN
+                - MTX_TEXT_VIEW_RIGHT_MARGIN;
+    if (allocation.width > 1 && max_width > 0 && width > max_width)
+    {
+        height = MAX (1, (gint) ((gint64) height * max_width / width));
+        width = max_width;
+    }
+
+    im = g_new0 (MtxTextViewImage, 1);
+    im->path = found;
+    im->width = width;
+    im->height = height;
+    im->key = g_strdup_printf ("%s\n%llu:%llu:%lld.%09ld:%lld:%dx%d", found,
+                               (unsigned long long) st.st_dev,
+                               (unsigned long long) st.st_ino,
+                               (long long) st.st_mtim.tv_sec,
+                               (long) st.st_mtim.tv_nsec,
+                               (long long) st.st_size, width, height);
+    return im;
+}
+
+/**
+_image_thread:
+GTaskThreadFunc: decode an image at its decoding size.
+*/
+static void
+_image_thread (GTask *task,
+               gpointer source_object __attribute__((unused)),
+               gpointer task_data,
+               GCancellable *cancellable __attribute__((unused)))
+{
+    MtxTextViewImage *im = task_data;
+    GError *error = NULL;
+    GdkPixbuf *pixbuf;
+
+    if (g_task_return_error_if_cancelled (task))
+    {
+        return;
+    }
+    pixbuf = gdk_pixbuf_new_from_file_at_scale (im->path, im->width,
+                                                im->height, FALSE, &error);
+    if (pixbuf != NULL)
+    {
+        g_task_return_pointer (task, pixbuf, g_object_unref);
+    }
+    else
+    {
+        g_task_return_error (task, error);
+    }
+}
+
+/**
+_image_ready:
+GAsyncReadyCallback: swap the placeholder for the decoded image, or show the
+image alt text in the placeholder if the image can't be decoded.  Either way
+the anchor character is replaced by exactly one character, so the text marks,
+link lengths and cursor offsets computed when the page was set stay valid.
+*/
+static void
+_image_ready (GObject *source,
+              GAsyncResult *result,
+              gpointer data __attribute__((unused)))
+{
+    MtxTextView *self = MTX_TEXT_VIEW (source);
+    MtxTextViewImage *im = g_task_get_task_data (G_TASK (result));
+    GError *error = NULL;
+    GdkPixbuf *pixbuf = g_task_propagate_pointer (G_TASK (result), &error);
+    GtkTextIter iter, end;
+    GtkTextMark *mark;
+    GSList *tags;
+
+    /* The placeholder went away with its page. */
+    if (gtk_text_child_anchor_get_deleted (im->anchor)
+        || g_error_matches (error, G_IO_ERROR, G_IO_ERROR_CANCELLED)
+        || (pixbuf == NULL && im->alt == NULL))
+    {
+        g_clear_object (&pixbuf);
+        g_clear_error (&error);
+        return;
+    }
+    g_clear_error (&error);
+    if (pixbuf == NULL)
+    {
+        GList *widgets = gtk_text_child_anchor_get_widgets (im->anchor);
+        GtkWidget *label = gtk_label_new (im->alt);
+
+        for (GList *w = widgets; w != NULL; w = w->next)
+        {
+            gtk_widget_destroy (w->data);
+        }
+        g_list_free (widgets);
+        gtk_text_view_add_child_at_anchor (GTK_TEXT_VIEW (self), label,
+                                           im->anchor);
+        gtk_widget_show (label);
+        return;
+    }
+    gtk_text_buffer_get_iter_at_child_anchor (self->buffer, &iter, im->anchor);
+    tags = gtk_text_iter_get_tags (&iter);
+    mark = gtk_text_buffer_create_mark (self->buffer, NULL, &iter, TRUE);
+    end = iter;
+    gtk_text_iter_forward_char (&end);
+    gtk_text_buffer_delete (self->buffer, &iter, &end);
+    _image_cache_insert (im->key, pixbuf);
+    gtk_text_buffer_insert_pixbuf (self->buffer, &iter, pixbuf);
+    g_object_unref (pixbuf);
+    gtk_text_buffer_get_iter_at_mark (self->buffer, &end, mark);
+    for (GSList *tagp = tags; tagp != NULL; tagp = tagp->next)
+    {
+        gtk_text_buffer_apply_tag (self->buffer, tagp->data, &end, &iter);
+    }
+    g_slist_free (tags);
+    gtk_text_buffer_delete_mark (self->buffer, mark);
+}
+
+/**
+_image_insert:
+Insert @im at @iter from the image cache or else insert a placeholder, and
+start decoding the image.  Take ownership of @im.  @iter is revalidated to
+point after the insertion.
+*/
+static void
+_image_insert (MtxTextView *self,
+               GtkTextIter *iter,
+               MtxTextViewImage *im)
+{
+    GdkPixbuf *pixbuf = _image_cache_lookup (im->key);
+    GtkWidget *placeholder;
+    GTask *task;
+
+    if (pixbuf != NULL)
+    {
+        gtk_text_buffer_insert_pixbuf (self->buffer, iter, pixbuf);
+        g_object_unref (pixbuf);
+        _image_free (im);
+        return;
+    }
+    placeholder = gtk_drawing_area_new ();
+
+    im->anchor =
+    g_object_ref (gtk_text_buffer_create_child_anchor (self->buffer, iter));
+    gtk_widget_set_size_request (placeholder, im->width, im->height);
+    gtk_text_view_add_child_at_anchor (GTK_TEXT_VIEW (self), placeholder,
+                                       im->anchor);
+    gtk_widget_show (placeholder);
+
+    task = g_task_new (self, self->image_cancellable, _image_ready, NULL);
+    g_task_set_task_data (task, im, (GDestroyNotify) _image_free);
+    g_task_run_in_thread (task, _image_thread);
+    g_object_unref (task);
+}
+
+/**
+*/
+static void
+_clear_link_marks_el (gpointer el, gpointer user_data)
+{
+    GtkTextBuffer *buffer = GTK_TEXT_BUFFER (user_data);
+    GtkTextMark *mark = ((MtxTextViewLinkInfo *) el)->mark;
+    gtk_text_buffer_delete_mark (buffer, mark);
+    g_free (el);
+}
+
+/**
+mtx_text_view_link_count:
+
+Returns: the number of markdown links in the page.
+*/
+guint
+mtx_text_view_link_count (MtxTextView *self)
+{
+    return self->link_marks->len;
+}
+
+/**
+mtx_text_view_link_info_get:
+
+Returns: a pointer to the #MtxTextView structure at the given index or NULL
+for an out-of-range index.  The instance owns the returned memory.
+*/
+const MtxTextViewLinkInfo *
+mtx_text_view_link_info_get (MtxTextView *self,
+                             const guint index_)
+{
+    return g_ptr_array_index (self->link_marks, index_);
 }
 
 /**
@@ -753,18 +1401,95 @@ mtx_text_view_link_info_get_near_offset (MtxTextView *self,
     return p;
 }
 
+/**
+_text_iter_before_mark:
+Return: TRUE if @iter comes before @mark.
+*/
+static inline gboolean
+_text_iter_before_mark (MtxTextView *self,
+                        const GtkTextIter *iter,
+                        GtkTextMark *mark)
+{
+    GtkTextIter at;
+    gtk_text_buffer_get_iter_at_mark (self->buffer, &at, mark);
+    return gtk_text_iter_compare (iter, &at) < 0;
+}
+
+/**
+_clear_link_marks_in_range:
+Forget the markdown links between @start (included) and @end (excluded).
+*/
+static void
+_clear_link_marks_in_range (MtxTextView *self,
+                            const GtkTextIter *start,
+                            const GtkTextIter *end)
+{
+    guint i, first = 0, last = 0;
+
+    for (i = 0; i < self->link_marks->len; i++)
+    {
+        MtxTextViewLinkInfo *link_info =
+        g_ptr_array_index (self->link_marks, i);
+        GtkTextIter at;
+
+        gtk_text_buffer_get_iter_at_mark (self->buffer, &at, link_info->mark);
+        if (gtk_text_iter_compare (&at, start) < 0)
+        {
+            first = i + 1;
+        }
+        else if (gtk_text_iter_compare (&at, end) >= 0)
+        {
+            break;
+        }
+    }
+    last = i;
+    for (i = first; i < last; i++)
+    {
+        _clear_link_marks_el (g_ptr_array_index (self->link_marks, i),
+                              self->buffer);
+    }
+    if (last > first)
+    {
+        g_ptr_array_remove_range (self->link_marks, first, last - first);
+    }
+}
+
+/**
+_cmp_link_marks_el:
+Order link_marks by buffer position.
+*/
+static gint
+_cmp_link_marks_el (gconstpointer a,
+                    gconstpointer b,
+                    gpointer user_data)
+{
+    GtkTextBuffer *buffer = GTK_TEXT_BUFFER (user_data);
+    GtkTextIter ia, ib;
+
+    gtk_text_buffer_get_iter_at_mark
+    (buffer, &ia, (*(MtxTextViewLinkInfo **) a)->mark);
+    gtk_text_buffer_get_iter_at_mark
+    (buffer, &ib, (*(MtxTextViewLinkInfo **) b)->mark);
+    return gtk_text_iter_compare (&ia, &ib);
+}
+
 /**
 load_images_and_mark_links:
-Resolve all image text tags in the text view.
-Also save the position of markdown link text tags.
+Resolve the image text tags between @start and @end in the text view; the
+images are decoded in the background, see _image_insert.
+Also save the position of markdown link text tags, appending to link_marks.
 
 @self:
 @referrer: absolute pathname (not necessarily directory) to fall back to when
 resolving image paths. NULLABLE.
+@start: left-gravity mark at the start of the range.
+@end: right-gravity mark at the end of the range.
 */
 static void
 load_images_and_mark_links (MtxTextView *self,
-                            const gchar *referrer)
+                            const gchar *referrer,
+                            GtkTextMark *start,
+                            GtkTextMark *end)
 {
     if (referrer != NULL)
     {
@@ -773,13 +1498,7 @@ load_images_and_mark_links (MtxTextView *self,
     GtkTextIter iter;
     GSList *tags, *tagp;
 
-    if (self->link_marks->len > 0)
-    {
-        g_ptr_array_foreach (self->link_marks, _clear_link_marks_el,
-                             self->buffer);
-        g_ptr_array_set_size (self->link_marks, 0);
-    }
-    gtk_text_buffer_get_start_iter (self->buffer, &iter);
+    gtk_text_buffer_get_iter_at_mark (self->buffer, &iter, start);
     do
     {
         gboolean done = FALSE;
@@ -789,10 +1508,15 @@ load_images_and_mark_links (MtxTextView *self,
         for (tagp = tags; tagp != NULL && !done; tagp = tagp->next)
         {
             GtkTextTag *tag = tagp->data;
-            gchar *font = NULL;
+            const MtxCmmTagAnnot *annot = _tag_get_annot (tag);
             MtxTextViewLinkInfo *link_info = NULL;
             gint id;
 
+            if (annot == NULL)
+            {
+                continue;
+            }
+
             /*
             Markdown links and images piggyback the font tag.
 
@@ -811,10 +1535,7 @@ load_images_and_mark_links (MtxTextView *self,
             we need to process links and images independently of each other;
             and we need to process link tags before image tags.
             */
-            g_object_get (G_OBJECT (tag), "font", &font, NULL);
-
-            id = mtx_cmm_tag_get_info (self->markdown, font,
-                                            MTX_TAG_DEST_LINK_URI_ID);
+            id = annot->info[MTX_TAG_DEST_LINK_URI_ID];
             if (id >= 0)            /* Markdown link text.            */
             {
                 /* Save a text mark for link navigation. */
@@ -822,9 +1543,7 @@ load_images_and_mark_links (MtxTextView *self,
                 link_info->mark =
                 gtk_text_buffer_create_mark (self->buffer, NULL, &iter, TRUE);
                 link_info->link_dest_id = id;
-                link_info->llen =
-                mtx_cmm_tag_get_info (self->markdown, font,
-                                      MTX_TAG_DEST_LINK_TXT_LEN);
+                link_info->llen = annot->info[MTX_TAG_DEST_LINK_TXT_LEN];
                 g_ptr_array_add (self->link_marks, link_info);
 
                 /* Skip over contained tags, which would beget
@@ -834,11 +1553,10 @@ load_images_and_mark_links (MtxTextView *self,
                 done = TRUE;
             }
 
-            id = mtx_cmm_tag_get_info (self->markdown, font,
-                                       MTX_TAG_DEST_IMAGE_PATH_ID);
-            GdkPixbuf *pixbuf = get_pixbuf_from_id (self, id, referrer);
-            if (pixbuf != NULL)         /* Markdown image.           */
-            {                           /* Replace text with pixbuf. */
+            id = annot->info[MTX_TAG_DEST_IMAGE_PATH_ID];
+            MtxTextViewImage *im = _image_new (self, id, referrer);
+            if (im != NULL)             /* Markdown image.           */
+            {                           /* Replace text with image.  */
                 GtkTextMark *mark;
                 GtkTextIter start;
 
@@ -850,8 +1568,10 @@ load_images_and_mark_links (MtxTextView *self,
                     start = iter;
                     /* Image isn't embedded in markdown link text. */
                     gtk_text_iter_forward_to_tag_toggle (&iter, tag);
+                    im->alt = gtk_text_buffer_get_text (self->buffer, &start,
+                                                        &iter, FALSE);
                     gtk_text_buffer_delete (self->buffer, &start, &iter);
-                    gtk_text_buffer_insert_pixbuf (self->buffer, &iter, pixbuf);
+                    _image_insert (self, &iter, im);
                 }
                 else
                 {
@@ -867,8 +1587,10 @@ load_images_and_mark_links (MtxTextView *self,
                     gtk_text_buffer_get_iter_at_mark (self->buffer, &start,
                                                       mark);
                     gtk_text_iter_forward_chars (&start, 1);
+                    im->alt = gtk_text_buffer_get_text (self->buffer, &start,
+                                                        &iter, FALSE);
                     gtk_text_buffer_delete (self->buffer, &start, &iter);
-                    gtk_text_buffer_insert_pixbuf (self->buffer, &iter, pixbuf);
+                    _image_insert (self, &iter, im);
                     gtk_text_buffer_insert (self->buffer, &iter, " ", 1);
                     gtk_text_buffer_get_iter_at_mark (self->buffer, &start,
                                                       mark);
@@ -876,12 +1598,10 @@ load_images_and_mark_links (MtxTextView *self,
                                                &iter);
                     link_info->llen = forward_chars = 3;
                 }
-                g_object_unref (pixbuf);
                 gtk_text_buffer_delete_mark (self->buffer, mark);
 
                 done = TRUE;
             }
-            g_free (font);
         }
         if (forward_chars > 0)
         {
@@ -892,7 +1612,8 @@ load_images_and_mark_links (MtxTextView *self,
             g_slist_free (tags);
         }
     }
-    while (gtk_text_iter_forward_to_tag_toggle (&iter, NULL));
+    while (gtk_text_iter_forward_to_tag_toggle (&iter, NULL)
+           && _text_iter_before_mark (self, &iter, end));
 }
 
 #if MTX_TEXT_VIEW_DEBUG > 2
@@ -1043,10 +1764,13 @@ _free_rendered (MtxTextViewPrivateRendered *ptr)
 }
 
 /**
+_text_buffer_set_invisible_to_eol:
+@limit: don't delete past this position. NULLABLE.
 */
 static void
 _text_buffer_set_invisible_to_eol (GtkTextBuffer *buffer,
-                                   GtkTextIter *iter)
+                                   GtkTextIter *iter,
+                                   const GtkTextIter *limit)
 {
 
     /*
@@ -1062,25 +1786,35 @@ _text_buffer_set_invisible_to_eol (GtkTextBuffer *buffer,
     /* chomp also the line ending that trails each block quote level: I like a
     more compact view */
     gtk_text_iter_forward_line (&end);
+    if (limit != NULL && gtk_text_iter_compare (&end, limit) > 0)
+    {
+        end = *limit;
+    }
     gtk_text_buffer_delete (buffer, iter, &end);
 }
 
 /**
 _indent_blockquote:
-Indent blockquote blocks. This should be the final indenting step.
+Indent blockquote blocks between @start and @end. This should be the final
+indenting step.
+
+@start: left-gravity mark at the start of the range.
+@end: right-gravity mark at the end of the range.
 */
 static void
-_indent_blockquote (MtxTextView *self)
+_indent_blockquote (MtxTextView *self,
+                    GtkTextMark *start,
+                    GtkTextMark *end)
 {
     MtxTextViewPrivateRendered *gap = NULL; /* between tab stops */
-    GtkTextIter iter, prev_iter, gap_end;
+    GtkTextIter iter, prev_iter, gap_end, limit;
     GtkTextTag *tag;
     GSList *tags, *tagp;
     gint lvl = -1, prev_lvl = 0;
     gboolean open = FALSE, prev_open = FALSE;
     guint block_cnt = 0;
 
-    gtk_text_buffer_get_start_iter (self->buffer, &iter);
+    gtk_text_buffer_get_iter_at_mark (self->buffer, &iter, start);
     prev_iter = iter;
 
     /* iter loop */
@@ -1089,18 +1823,16 @@ _indent_blockquote (MtxTextView *self)
         tags = gtk_text_iter_get_tags (&iter);
         for (tagp = tags; tagp != NULL; tagp = tagp->next)
         {
-            gchar *font = NULL;
+            const MtxCmmTagAnnot *annot;
 
             tag = tagp->data;
-            g_object_get (G_OBJECT (tag), "font", &font, NULL);
+            annot = _tag_get_annot (tag);
 
-            lvl = mtx_cmm_tag_get_info (self->markdown, font,
-                                        MTX_TAG_BLOCKQUOTE_LEVEL);
+            lvl = annot ? annot->info[MTX_TAG_BLOCKQUOTE_LEVEL] : -1;
             g_assert (lvl != 0);  /* lvl can be -1 or strictly > 0 */
             if (lvl > 0)
             {
-                open = mtx_cmm_tag_get_info (self->markdown, font,
-                                             MTX_TAG_BLOCKQUOTE_OPEN);
+                open = annot->info[MTX_TAG_BLOCKQUOTE_OPEN];
 
                 /* Once: cache the formatted gap between blockquote_start&end */
                 if (self->blockquote_start == NULL && open)
@@ -1162,8 +1894,10 @@ _indent_blockquote (MtxTextView *self)
                     if (!prev_open)
                     {
                         /* Hide closing symbols to avoid visual noise.  */
+                        gtk_text_buffer_get_iter_at_mark (self->buffer, &limit,
+                                                          end);
                         _text_buffer_set_invisible_to_eol (self->buffer,
-                                                           &prev_iter);
+                                                           &prev_iter, &limit);
                     }
                     gtk_text_buffer_get_iter_at_mark (self->buffer, &prev_iter,
                                                       prev_mark);
@@ -1178,7 +1912,6 @@ _indent_blockquote (MtxTextView *self)
                 prev_iter = iter;
                 block_cnt++;
             }
-            g_free (font);
             break;
         }
         if (tags)
@@ -1186,23 +1919,29 @@ _indent_blockquote (MtxTextView *self)
             g_slist_free (tags);
         }
     }
-    while (gtk_text_iter_forward_to_tag_toggle (&iter, NULL));
+    while (gtk_text_iter_forward_to_tag_toggle (&iter, NULL)
+           && _text_iter_before_mark (self, &iter, end));
 
     if (block_cnt)
     {
-        gtk_text_buffer_get_end_iter (self->buffer, &iter);
+        gtk_text_buffer_get_iter_at_mark (self->buffer, &iter, end);
         _indent_slice_lines (self, &prev_iter, &iter, 0);
         /* Hide closing symbol to avoid visual noise. */
-        _text_buffer_set_invisible_to_eol (self->buffer, &prev_iter);
+        _text_buffer_set_invisible_to_eol (self->buffer, &prev_iter, &iter);
     }
 }
 
 /**
 _indent_li:
-Indent list elements.
+Indent list elements between @start and @end.
+
+@start: left-gravity mark at the start of the range.
+@stop: right-gravity mark at the end of the range.
 */
 static void
-_indent_li (MtxTextView * self)
+_indent_li (MtxTextView * self,
+            GtkTextMark *start,
+            GtkTextMark *stop)
 {
     GtkTextIter iter;
     GtkTextTag *tag;
@@ -1213,7 +1952,7 @@ _indent_li (MtxTextView * self)
     gboolean cont;
     GString *fill = g_string_new ("                ");  /* 16 spaces */
 
-    gtk_text_buffer_get_start_iter (self->buffer, &iter);
+    gtk_text_buffer_get_iter_at_mark (self->buffer, &iter, start);
 
     /* iter loop */
     do
@@ -1221,22 +1960,22 @@ _indent_li (MtxTextView * self)
         tags = gtk_text_iter_get_tags (&iter);
         for (tagp = tags; tagp != NULL; tagp = tagp->next)
         {
-            g_autofree gchar *font = NULL;
-            g_free (font);
+            const MtxCmmTagAnnot *annot;
 
             tag = tagp->data;
-            g_object_get (G_OBJECT (tag), "font", &font, NULL);
+            annot = _tag_get_annot (tag);
 #ifdef MTX_DEBUG
             {
                 gint s, w;
+                g_autofree gchar *font = NULL;
                 g_object_get (G_OBJECT (tag), "style", &s, NULL);
                 g_object_get (G_OBJECT (tag), "weight", &w, NULL);
+                g_object_get (G_OBJECT (tag), "font", &font, NULL);
                 mtx_dbg_errout (-1, "style %d weight %d font %s\n", s, w, font);
             }
 #endif
 
-            li_lvl =
-            mtx_cmm_tag_get_info (self->markdown, font, MTX_TAG_LI_LEVEL);
+            li_lvl = annot ? annot->info[MTX_TAG_LI_LEVEL] : -1;
             g_assert (li_lvl); /* -1 || > 0 for a valid LI element */
             if (li_lvl > 0)
             {
@@ -1261,11 +2000,9 @@ _indent_li (MtxTextView * self)
                 }
 
 #if 0
-                gint ordinal =
-                mtx_cmm_tag_get_info (self->markdown, font, MTX_TAG_LI_ORDINAL);
+                gint ordinal = annot->info[MTX_TAG_LI_ORDINAL];
 #endif
-                bullet_len = mtx_cmm_tag_get_info (self->markdown, font,
-                                                   MTX_TAG_LI_BULLET_LEN);
+                bullet_len = annot->info[MTX_TAG_LI_BULLET_LEN];
 
                 /* width = 60 + 20 * li_lvl; */
                 gtk_text_iter_forward_chars (&end, bullet_len);
@@ -1313,181 +2050,1120 @@ _indent_li (MtxTextView * self)
                 }
 
 
-                /*
-                Find this LI's start segment. Forward from LI's start to either
-                LI's end or the next LI or an open/close OL/UL, whichever
-                comes first.  This LI's body is preceded by (assuming _ID==N)
-                <span font="...liId=N"></span> and followed by
-                <span font="...liId=N">sUNIPUA_PANGO_EMPTY_SPAN</span>.
-                */
-                this_li_id =
-                mtx_cmm_tag_get_info (self->markdown, font, MTX_TAG_LI_ID);
-                cont = TRUE;
-                do
-                {
-                    GSList *ts, *tp;
-                    GtkTextTag *ta;
-                    gchar *prop = NULL;
-                    ol_ul_lvl = -1;
+                /*
+                Find this LI's start segment. Forward from LI's start to either
+                LI's end or the next LI or an open/close OL/UL, whichever
+                comes first.  This LI's body is preceded by (assuming _ID==N)
+                <span font="...liId=N"></span> and followed by
+                <span font="...liId=N">sUNIPUA_PANGO_EMPTY_SPAN</span>.
+                */
+                this_li_id = annot->info[MTX_TAG_LI_ID];
+                cont = TRUE;
+                do
+                {
+                    GSList *ts, *tp;
+                    const MtxCmmTagAnnot *ta;
+                    ol_ul_lvl = -1;
+
+                    gtk_text_iter_forward_to_tag_toggle (&end, NULL);
+                    ts = gtk_text_iter_get_tags (&end);
+                    for (tp = ts; tp != NULL && cont; tp = tp->next)
+                    {
+                        ta = _tag_get_annot (tp->data);
+                        if (ta != NULL)
+                        {
+                            maybe_li_id = ta->info[MTX_TAG_LI_ID];
+                            mtx_dbg_errout (-1, "this(%d) maybe(%d)\n",
+                                            this_li_id, maybe_li_id);
+                            if (maybe_li_id == this_li_id || maybe_li_id > 0 ||
+                                (ol_ul_lvl = ta->info[MTX_TAG_OL_UL_LEVEL]) > 0)
+                            {
+                                cont = FALSE;
+                            }
+                        }
+                    }
+                    if (ts)
+                    {
+                        g_slist_free (ts);
+                    }
+                }
+                while (cont && ol_ul_lvl != 0);
+                mtx_dbg_errout (-1, "this(%d) ==? maybe(%d)\n", this_li_id,
+                                maybe_li_id);
+
+                _indent_slice_lines (self, &iter, &end, margin);
+                iter = end;
+                if (maybe_li_id > 0 && maybe_li_id != this_li_id)
+                {
+                    gtk_text_iter_backward_to_tag_toggle (&iter, NULL);
+                }
+            }
+            break;
+        }
+        if (tags)
+        {
+            g_slist_free (tags);
+        }
+    }
+    while (gtk_text_iter_forward_to_tag_toggle (&iter, NULL)
+           && _text_iter_before_mark (self, &iter, stop));
+    g_string_free (fill, TRUE);
+}
+
+/**
+_text_buffer_delete_empty_spans:
+Delete the iUNIPUA_PANGO_EMPTY_SPAN characters inserted since the last call.
+_text_buffer_insert_runs marks them as it inserts them, so this visits only
+the marked characters rather than every character of the inserted range.
+Nested blocks close with runs of adjacent empty spans; each run is deleted
+with a single buffer edit.
+*/
+static void
+_text_buffer_delete_empty_spans (MtxTextView *self)
+{
+    GPtrArray *marks = self->empty_span_marks;
+#if MTX_TEXT_VIEW_DEBUG > 0
+    guint nruns = 0;
+    gint64 t0 = g_get_monotonic_time ();
+#endif
+
+    for (guint i = 0; i < marks->len; )
+    {
+        GtkTextIter iter, end, at;
+
+        gtk_text_buffer_get_iter_at_mark (self->buffer, &iter,
+                                          g_ptr_array_index (marks, i++));
+        if (gtk_text_iter_get_char (&iter) != iUNIPUA_PANGO_EMPTY_SPAN)
+        {
+            continue;
+        }
+        end = iter;
+        gtk_text_iter_forward_char (&end);
+        /* extend the run over the following marks while they are adjacent */
+        for (; i < marks->len; i++)
+        {
+            gtk_text_buffer_get_iter_at_mark (self->buffer, &at,
+                                              g_ptr_array_index (marks, i));
+            if (!gtk_text_iter_equal (&at, &end)
+                || gtk_text_iter_get_char (&at) != iUNIPUA_PANGO_EMPTY_SPAN)
+            {
+                break;
+            }
+            gtk_text_iter_forward_char (&end);
+        }
+        gtk_text_buffer_delete (self->buffer, &iter, &end);
+#if MTX_TEXT_VIEW_DEBUG > 0
+        nruns++;
+#endif
+    }
+    for (guint i = 0; i < marks->len; i++)
+    {
+        gtk_text_buffer_delete_mark (self->buffer,
+                                     g_ptr_array_index (marks, i));
+    }
+#if MTX_TEXT_VIEW_DEBUG > 0
+    fprintf (stderr, "%s: %u in %u runs in %" G_GINT64_FORMAT " us\n",
+             __FUNCTION__, marks->len, nruns, g_get_monotonic_time () - t0);
+#endif
+    g_ptr_array_set_size (marks, 0);
+}
+
+static void
+_indent_text_buffer (MtxTextView *self,
+                     GtkTextMark *start,
+                     GtkTextMark *end)
+{
+#if MTX_TEXT_VIEW_DEBUG > 3
+    /* Time the passes, and a sweep of every character of the range, which
+    is how the empty spans were found before they were marked. */
+    GtkTextIter iter, stop;
+    guint nchars = 0, nspans = 0;
+    gint64 t0 = g_get_monotonic_time (), t1, t2;
+#endif
+    _indent_li (self, start, end);
+#if MTX_TEXT_VIEW_DEBUG > 3
+    t1 = g_get_monotonic_time ();
+#endif
+    _indent_blockquote (self, start, end);
+#if MTX_TEXT_VIEW_DEBUG > 3
+    t2 = g_get_monotonic_time ();
+    gtk_text_buffer_get_iter_at_mark (self->buffer, &iter, start);
+    gtk_text_buffer_get_iter_at_mark (self->buffer, &stop, end);
+    for (; gtk_text_iter_compare (&iter, &stop) < 0;
+         gtk_text_iter_forward_char (&iter))
+    {
+        nchars++;
+        nspans += gtk_text_iter_get_char (&iter) == iUNIPUA_PANGO_EMPTY_SPAN;
+    }
+    fprintf (stderr, "%s: li %" G_GINT64_FORMAT " us, blockquote %"
+             G_GINT64_FORMAT " us; sweep of %u chars found %u empty spans"
+             " in %" G_GINT64_FORMAT " us\n", __FUNCTION__, t1 - t0,
+             t2 - t1, nchars, nspans, g_get_monotonic_time () - t2);
+#endif
+    _text_buffer_delete_empty_spans (self);
+}
+
+/**
+_page_blocks_new:
+Index the top-level blocks of @markup.
+
+@block_ends: block end offsets from mtx_cmm_mtx_blocks.
+
+Return: a GArray of MtxTextViewPrivateBlock without marks.  It is empty if
+@markup isn't split into blocks.
+*/
+static GArray *
+_page_blocks_new (const gchar *markup,
+                  GArray *block_ends)
+{
+    GArray *blocks = g_array_sized_new (FALSE, FALSE,
+                                        sizeof (MtxTextViewPrivateBlock),
+                                        block_ends->len);
+    gsize offset = 0;
+
+    for (guint i = 0; i < block_ends->len; i++)
+    {
+        MtxTextViewPrivateBlock b = { offset, 0, 5381, NULL };
+        const gchar *p = markup + offset;
+
+        b.len = g_array_index (block_ends, gsize, i) - offset;
+        for (gsize n = b.len; n > 0; n--)
+        {
+            b.hash = (b.hash << 5) + b.hash + (guchar) *p++;
+        }
+        g_array_append_val (blocks, b);
+        offset += b.len;
+    }
+    return blocks;
+}
+
+/**
+_page_runs_new:
+Parse each block of @markup into runs.  If some block isn't self-contained,
+parse @markup as a whole instead, so the page can't be indexed by blocks.
+Safe to call from a worker thread.
+
+@block_ends: block end offsets from mtx_cmm_mtx_blocks.
+
+Return: a GPtrArray of MtxTextViewPrivateRuns, one per block, or at most one
+if @markup can't be split into blocks.  It is empty if @markup is invalid.
+*/
+static GPtrArray *
+_page_runs_new (const gchar *markup,
+                GArray *block_ends)
+{
+    GPtrArray *runs = g_ptr_array_new_full (MAX (block_ends->len, 1),
+                                            (GDestroyNotify) _runs_free);
+    GError *error = NULL;
+    MtxTextViewPrivateRuns *r;
+    gsize offset = 0;
+
+    for (guint i = 0; i < block_ends->len; i++)
+    {
+        gsize end = g_array_index (block_ends, gsize, i);
+
+        if ((r = _runs_new (markup + offset, end - offset, NULL)) == NULL)
+        {
+            g_ptr_array_set_size (runs, 0);
+            break;
+        }
+        g_ptr_array_add (runs, r);
+        offset = end;
+    }
+    if (runs->len == 0)
+    {
+        if ((r = _runs_new (markup, -1, &error)) != NULL)
+        {
+            g_ptr_array_add (runs, r);
+        }
+        else
+        {
+            g_warning ("Invalid markup string: %s", error->message);
+            g_error_free (error);
+        }
+    }
+    return runs;
+}
+
+/**
+_page_link_dests_new:
+Return: a newly-allocated snapshot of the link destinations of the latest
+conversion by @markdown.  Free with g_ptr_array_unref.
+*/
+static GPtrArray *
+_page_link_dests_new (MtxCmm *markdown)
+{
+    const guint n = mtx_cmm_get_link_dest_count (markdown);
+    GPtrArray *dests = g_ptr_array_new_full (n, g_free);
+
+    for (guint i = 0; i < n; i++)
+    {
+        g_ptr_array_add (dests, g_strdup (mtx_cmm_get_link_dest (markdown, i)));
+    }
+    return dests;
+}
+
+/**
+_page_set_link_dests:
+Make @dests, which is referenced not copied, the link destinations of the page.
+*/
+static void
+_page_set_link_dests (MtxTextView *self,
+                      GPtrArray *dests)
+{
+    g_ptr_array_ref (dests);
+    g_ptr_array_unref (self->page_link_dests);
+    self->page_link_dests = dests;
+}
+
+/**
+_page_link_dests_kept:
+Return: TRUE if every link_dest id of the page index still refers to the same
+link destination in @dests.
+*/
+static gboolean
+_page_link_dests_kept (MtxTextView *self,
+                       GPtrArray *dests)
+{
+    GPtrArray *old = self->page_link_dests;
+
+    if (dests->len < old->len)
+    {
+        return FALSE;
+    }
+    for (guint i = 0; i < old->len; i++)
+    {
+        if (strcmp (g_ptr_array_index (old, i),
+                    g_ptr_array_index (dests, i)) != 0)
+        {
+            return FALSE;
+        }
+    }
+    return TRUE;
+}
+
+/**
+_text_buffer_insert_blocks:
+Insert blocks [@first, @last) at @at, and set each block's mark.
+
+@at: right-gravity mark.
+@runs: the runs of each block, see _page_runs_new.
+*/
+static void
+_text_buffer_insert_blocks (MtxTextView *self,
+                            GtkTextMark *at,
+                            GPtrArray *runs,
+                            GArray *blocks,
+                            const guint first,
+                            const guint last)
+{
+    for (guint i = first; i < last; i++)
+    {
+        MtxTextViewPrivateBlock *b =
+        &g_array_index (blocks, MtxTextViewPrivateBlock, i);
+        GtkTextIter iter;
+
+        gtk_text_buffer_get_iter_at_mark (self->buffer, &iter, at);
+        b->mark = gtk_text_buffer_create_mark (self->buffer, NULL, &iter, TRUE);
+        _text_buffer_insert_runs (self, &iter, g_ptr_array_index (runs, i));
+    }
+}
+
+/**
+_text_buffer_finish_range:
+Resolve images and links, re-prioritize the highlight tag, and apply
+indentation between @start and @end.
+*/
+static void
+_text_buffer_finish_range (MtxTextView *self,
+                           const gchar *referrer,
+                           GtkTextMark *start,
+                           GtkTextMark *end)
+{
+    load_images_and_mark_links (self, referrer, start, end);
+
+   /* set highlight tag's priority above text tags inserted from markup */
+    guint tsz =
+    gtk_text_tag_table_get_size (gtk_text_buffer_get_tag_table
+                                 (self->buffer));
+    gtk_text_tag_set_priority (self->highlight_tag, tsz - 1);
+
+    _indent_text_buffer (self, start, end);
+}
+
+/**
+_text_buffer_rebuild:
+Replace the text buffer contents with @runs.  Take ownership of @blocks.
+*/
+static void
+_text_buffer_rebuild (MtxTextView *self,
+                      GPtrArray *runs,
+                      GArray *blocks,
+                      GPtrArray *link_dests,
+                      const gchar *referrer)
+{
+    GtkTextIter iter;
+    GtkTextMark *start;
+
+    mtx_text_view_reset (self);
+    _page_set_link_dests (self, link_dests);
+    if (self->link_marks->len > 0)
+    {
+        g_ptr_array_foreach (self->link_marks, _clear_link_marks_el,
+                             self->buffer);
+        g_ptr_array_set_size (self->link_marks, 0);
+    }
+
+    gtk_text_buffer_get_start_iter (self->buffer, &iter);
+    start = gtk_text_buffer_create_mark (self->buffer, NULL, &iter, TRUE);
+    self->page_end = gtk_text_buffer_create_mark (self->buffer, NULL, &iter,
+                                                  FALSE);
+    if (runs->len != blocks->len)
+    {
+        /* Some block isn't self-contained: the markup was parsed as a whole;
+           don't index this page. */
+        g_array_set_size (blocks, 0);
+        for (guint i = 0; i < runs->len; i++)
+        {
+            _text_buffer_insert_runs (self, &iter, g_ptr_array_index (runs, i));
+        }
+    }
+    else
+    {
+        _text_buffer_insert_blocks (self, self->page_end, runs, blocks, 0,
+                                    blocks->len);
+    }
+
+    _text_buffer_finish_range (self, referrer, start, self->page_end);
+    gtk_text_buffer_delete_mark (self->buffer, start);
+
+    g_array_free (self->page_blocks, TRUE);
+    self->page_blocks = blocks;
+    self->page_tag_count =
+    gtk_text_tag_table_get_size (gtk_text_buffer_get_tag_table (self->buffer));
+}
+
+/**
+_text_buffer_update:
+Replace in the text buffer only the top-level blocks of @markup that changed
+since the page was last set, inserting them from @runs.  Take ownership of
+@blocks on success.
+
+Return: FALSE if the page can't be updated incrementally; the text buffer is
+unchanged.
+*/
+static gboolean
+_text_buffer_update (MtxTextView *self,
+                     const gchar *markup,
+                     GPtrArray *runs,
+                     GArray *blocks,
+                     GPtrArray *link_dests,
+                     const gchar *referrer)
+{
+    GArray *old = self->page_blocks;
+    const guint n_old = old->len, n_new = blocks->len;
+    guint p = 0, s = 0;
+    GtkTextIter start, end;
+    GtkTextMark *start_mark, *end_mark;
+
+    if (n_old == 0 || n_new == 0 || runs->len != n_new
+        || self->page_markup == NULL
+        || g_strcmp0 (referrer, self->page_referrer) != 0
+        || !_page_link_dests_kept (self, link_dests)
+        || gtk_text_tag_table_get_size (gtk_text_buffer_get_tag_table
+                                        (self->buffer))
+           > 2 * self->page_tag_count + MTX_TEXT_VIEW_SPLICE_TAG_SLACK)
+    {
+        return FALSE;
+    }
+
+#define _BLOCK(a, i) (&g_array_index ((a), MtxTextViewPrivateBlock, (i)))
+#define _BLOCK_EQ(i, j) \
+    (_BLOCK (old, i)->hash == _BLOCK (blocks, j)->hash \
+     && _BLOCK (old, i)->len == _BLOCK (blocks, j)->len \
+     && memcmp (self->page_markup + _BLOCK (old, i)->offset, \
+                markup + _BLOCK (blocks, j)->offset, \
+                _BLOCK (old, i)->len) == 0)
+
+    /* Common leading and trailing blocks. */
+    while (p < n_old && p < n_new && _BLOCK_EQ (p, p))
+    {
+        p++;
+    }
+    while (s < n_old - p && s < n_new - p
+           && _BLOCK_EQ (n_old - 1 - s, n_new - 1 - s))
+    {
+        s++;
+    }
+
+    _page_set_link_dests (self, link_dests);
+
+    if (p + s < n_old || p + s < n_new)
+    {
+        gtk_text_buffer_get_iter_at_mark (self->buffer, &start,
+                                          p < n_old ? _BLOCK (old, p)->mark
+                                          : self->page_end);
+        gtk_text_buffer_get_iter_at_mark (self->buffer, &end,
+                                          s > 0 ? _BLOCK (old, n_old - s)->mark
+                                          : self->page_end);
+        start_mark =
+        gtk_text_buffer_create_mark (self->buffer, NULL, &start, TRUE);
+        end_mark =
+        gtk_text_buffer_create_mark (self->buffer, NULL, &end, FALSE);
+
+        _clear_link_marks_in_range (self, &start, &end);
+        for (guint i = p; i < n_old - s; i++)
+        {
+            gtk_text_buffer_delete_mark (self->buffer, _BLOCK (old, i)->mark);
+        }
+        gtk_text_buffer_delete (self->buffer, &start, &end);
+
+        _text_buffer_insert_blocks (self, end_mark, runs, blocks, p,
+                                    n_new - s);
+
+        /* Left-gravity marks of trailing blocks stayed at the deletion. */
+        gtk_text_buffer_get_iter_at_mark (self->buffer, &end, end_mark);
+        for (guint i = n_old - s; i < n_old; i++)
+        {
+            GtkTextMark *mark = _BLOCK (old, i)->mark;
+            if (!_text_iter_before_mark (self, &end, mark))
+            {
+                gtk_text_buffer_move_mark (self->buffer, mark, &end);
+            }
+        }
+
+        _text_buffer_finish_range (self, referrer, start_mark, end_mark);
+        g_ptr_array_sort_with_data (self->link_marks, _cmp_link_marks_el,
+                                    self->buffer);
+        gtk_text_buffer_delete_mark (self->buffer, start_mark);
+        gtk_text_buffer_delete_mark (self->buffer, end_mark);
+    }
+
+    /* Carry over the marks of the unchanged blocks. */
+    for (guint i = 0; i < p; i++)
+    {
+        _BLOCK (blocks, i)->mark = _BLOCK (old, i)->mark;
+    }
+    for (guint i = 0; i < s; i++)
+    {
+        _BLOCK (blocks, n_new - 1 - i)->mark = _BLOCK (old, n_old - 1 - i)->mark;
+    }
+#undef _BLOCK_EQ
+#undef _BLOCK
+
+    g_array_free (old, TRUE);
+    self->page_blocks = blocks;
+    return TRUE;
+}
+
+/**
+_text_view_set_markup:
+Show @markup in the text view.  Take ownership of @markup.  @runs holds
+@markup already parsed, see _page_runs_new.  @link_dests holds the link
+destinations of the conversion; the text view takes a reference.
+NULL @markup resets the text view.
+*/
+static void
+_text_view_set_markup (MtxTextView *self,
+                       gchar *markup,
+                       GArray *block_ends,
+                       GPtrArray *runs,
+                       GPtrArray *link_dests,
+                       const gchar *referrer)
+{
+    if (markup != NULL)
+    {
+        GArray *blocks = _page_blocks_new (markup, block_ends);
+
+        if (!_text_buffer_update (self, markup, runs, blocks, link_dests,
+                                  referrer))
+        {
+            _text_buffer_rebuild (self, runs, blocks, link_dests, referrer);
+            self->page_referrer = g_strdup (referrer);
+        }
+        g_free (self->page_markup);
+        self->page_markup = markup;
+    }
+    else
+    {
+        mtx_text_view_reset (self);
+    }
+}
+
+/**
+mtx_text_view_set_text:
+The markdown-to-text-view main entry point:
+Convert markdown text to Pango markup; resolve images; insert results into the
+text view buffer; re-prioritize buffer text tags, and apply indentation.
+
+Setting new text for the same @referrer updates the text view incrementally:
+the page index records the top-level blocks of the markup, and only the blocks
+that differ from the previous text are replaced in the text buffer.  The text
+buffer is rebuilt whenever link destinations moved, a block doesn't parse on
+its own, or the update would leave too many stale tags behind.
+
+@self:
+@text: address of a pointer to the markdown text string.
+@referrer: the base pathname context for loading images. See also
+#mtx_text_view_load_file.
+@clear_text: if TRUE, free the memory pointed to by @text and set @text to NULL.
+
+Returns: FALSE on parsing error otherwise return TRUE.
+*/
+gboolean
+mtx_text_view_set_text (MtxTextView *self,
+                        gchar **text,
+                        const gchar *referrer,
+                        const gboolean clear_text)
+{
+    gchar *markup = NULL;
+    gboolean result = TRUE;
+    GArray *block_ends;
+    GPtrArray *runs, *link_dests;
+
+    g_return_val_if_fail (IS_MTX_TEXT_VIEW (self), FALSE);
+
+    block_ends = g_array_new (FALSE, FALSE, sizeof (gsize));
+#ifdef MTX_TEXT_VIEW_DEBUG
+    if (gl_text_view_debug_markup_file != NULL)
+    {
+        gsize sz;
+
+        if (clear_text)
+        {
+            g_free (*text); /* superseded by the debug file to be loaded */
+            *text = NULL;
+        }
+        markup =
+        _get_file_contents (gl_text_view_debug_markup_file, &sz, TRUE);
+        g_printerr ("%s: read %lu bytes from %s\n", __FUNCTION__, sz,
+                    gl_text_view_debug_markup_file);
+    }
+    else
+#endif
+    {
+        markup = mtx_cmm_mtx_blocks (self->markdown, text, NULL, clear_text,
+                                     block_ends);
+    }
+    link_dests = _page_link_dests_new (self->markdown);
+    runs = markup ? _page_runs_new (markup, block_ends) : NULL;
+    g_clear_pointer (&self->page_file, g_free);
+    _text_view_set_markup (self, markup, block_ends, runs, link_dests,
+                           referrer);
+    if (runs != NULL)
+    {
+        g_ptr_array_unref (runs);
+    }
+    g_ptr_array_unref (link_dests);
+    g_array_free (block_ends, TRUE);
+    return result;
+}
+
+/**
+mtx_text_view_append_text:
+Convert markdown text and append it to the end of the page, without converting
+or inserting the page again.  Links keep working across the two conversions:
+the appended text continues the link_dest ids of the page.  The page index
+doesn't cover the appended text, so the next mtx_text_view_set_text rebuilds
+the text buffer.
+
+@self:
+@text: address of a pointer to the markdown text string.
+@clear_text: if TRUE, free the memory pointed to by @text and set @text to NULL.
+
+Returns: FALSE on parsing error otherwise return TRUE.
+*/
+gboolean
+mtx_text_view_append_text (MtxTextView *self,
+                           gchar **text,
+                           const gboolean clear_text)
+{
+    gchar *markup;
+    GError *error = NULL;
+    MtxTextViewPrivateRuns *runs;
+    GPtrArray *link_dests;
+    GtkTextIter iter;
+    GtkTextMark *start, *end;
+
+    g_return_val_if_fail (IS_MTX_TEXT_VIEW (self), FALSE);
+
+    mtx_cmm_set_link_dest_seed (self->markdown, self->page_link_dests);
+    markup = mtx_cmm_mtx (self->markdown, text, NULL, clear_text);
+    mtx_cmm_set_link_dest_seed (self->markdown, NULL);
+    if (markup == NULL)
+    {
+        return FALSE;
+    }
+    runs = _runs_new (markup, -1, &error);
+    g_free (markup);
+    if (runs == NULL)
+    {
+        g_warning ("Invalid markup string: %s", error->message);
+        g_error_free (error);
+        return FALSE;
+    }
+
+    for (guint i = 0; i < self->page_blocks->len; i++)
+    {
+        gtk_text_buffer_delete_mark
+        (self->buffer, g_array_index (self->page_blocks,
+                                      MtxTextViewPrivateBlock, i).mark);
+    }
+    g_array_set_size (self->page_blocks, 0);
+    g_clear_pointer (&self->page_markup, g_free);
+    link_dests = _page_link_dests_new (self->markdown);
+    _page_set_link_dests (self, link_dests);
+    g_ptr_array_unref (link_dests);
+
+    gtk_text_buffer_get_end_iter (self->buffer, &iter);
+    start = gtk_text_buffer_create_mark (self->buffer, NULL, &iter, TRUE);
+    end = gtk_text_buffer_create_mark (self->buffer, NULL, &iter, FALSE);
+    _text_buffer_insert_runs (self, &iter, runs);
+    _text_buffer_finish_range (self, self->page_referrer, start, end);
+    gtk_text_buffer_delete_mark (self->buffer, start);
+    gtk_text_buffer_delete_mark (self->buffer, end);
+    _runs_free (runs);
+    return TRUE;
+}
+
+/****************
+*  PAGE CACHE  *
+****************/
+
+/* Back/forward navigation revisits the same pages over and over.  The page
+cache keeps the conversion of recently loaded files - markup, block index,
+parsed runs and link destinations - so showing a page again skips reading,
+converting and parsing it.
+Pages are keyed by pathname, file stamp and conversion flags, so an edited
+file or a change of extensions misses the cache.  The least recently used
+pages are dropped to stay within the memory budget. */
+
+static void
+_page_free (MtxTextViewPrivatePage *page)
+{
+    g_free (page->key);
+    g_free (page->markup);
+    g_array_free (page->block_ends, TRUE);
+    g_ptr_array_unref (page->runs);
+    g_ptr_array_unref (page->link_dests);
+    g_free (page);
+}
+
+/**
+_page_cache_key:
+Return: a newly-allocated page cache key for loading @path, or its
+language-specific replacement @altpath, with @markdown, or NULL if the file
+can't be stat'ed.  Safe to call from a worker thread.
+@altpath: NULLABLE.
+*/
+static gchar *
+_page_cache_key (const gchar *path,
+                 const gchar *altpath,
+                 MtxCmm *markdown,
+                 const gboolean utf8_validate)
+{
+    struct stat st;
+
+    if (stat (altpath ? altpath : path, &st) != 0)
+    {
+        return NULL;
+    }
+    return g_strdup_printf ("%s\n%s\n%llu:%llu:%lld.%09ld:%lld:%x:%x:%d",
+                            path, altpath ? altpath : "",
+                            (unsigned long long) st.st_dev,
+                            (unsigned long long) st.st_ino,
+                            (long long) st.st_mtim.tv_sec,
+                            (long) st.st_mtim.tv_nsec,
+                            (long long) st.st_size,
+                            mtx_cmm_get_extensions (markdown),
+                            mtx_cmm_get_tweaks (markdown),
+                            utf8_validate);
+}
+
+/**
+_page_cache_trim:
+Drop least recently used pages until the cache size is within @budget.
+*/
+static void
+_page_cache_trim (MtxTextView *self,
+                  const gsize budget)
+{
+    while (self->page_cache_size > budget)
+    {
+        MtxTextViewPrivatePage *page = g_queue_pop_tail (self->page_cache_lru);
+
+        self->page_cache_size -= page->cost;
+        g_hash_table_remove (self->page_cache, page->key);
+    }
+}
+
+/**
+_page_cache_insert:
+Add a copy of a converted page to the cache.  Copy @runs and @link_dests by
+reference.
+*/
+static void
+_page_cache_insert (MtxTextView *self,
+                    gchar *key,
+                    const gchar *markup,
+                    GArray *block_ends,
+                    GPtrArray *runs,
+                    GPtrArray *link_dests)
+{
+    MtxTextViewPrivatePage *page;
+    gsize cost = strlen (markup) + 1 + strlen (key) + 1
+                 + block_ends->len * sizeof (gsize)
+                 + sizeof (MtxTextViewPrivatePage);
+
+    for (guint i = 0; i < link_dests->len; i++)
+    {
+        cost += strlen (g_ptr_array_index (link_dests, i)) + 1;
+    }
+    for (guint i = 0; i < runs->len; i++)
+    {
+        MtxTextViewPrivateRuns *r = g_ptr_array_index (runs, i);
+
+        /* estimate: a range holds a couple of attributes on average */
+        cost += sizeof (*r) + r->len + 1
+                + r->count * 2 * sizeof (PangoAttribute)
+                + (r->empty_spans ? r->empty_spans->len * sizeof (gint) : 0);
+    }
+    if (cost > self->page_cache_budget)
+    {
+        g_free (key);
+        return;
+    }
+    page = g_new (MtxTextViewPrivatePage, 1);
+    page->key = key;
+    page->markup = g_strdup (markup);
+    page->block_ends = g_array_sized_new (FALSE, FALSE, sizeof (gsize),
+                                          block_ends->len);
+    g_array_append_vals (page->block_ends, block_ends->data, block_ends->len);
+    page->runs = g_ptr_array_ref (runs);
+    page->link_dests = g_ptr_array_ref (link_dests);
+    page->cost = cost;
+
+    /* Replace any page with the same key, and make room for this one. */
+    if (g_hash_table_contains (self->page_cache, key))
+    {
+        MtxTextViewPrivatePage *old =
+        g_hash_table_lookup (self->page_cache, key);
+
+        g_queue_delete_link (self->page_cache_lru, old->lru);
+        self->page_cache_size -= old->cost;
+        g_hash_table_remove (self->page_cache, key);
+    }
+    _page_cache_trim (self, self->page_cache_budget - cost);
+    g_queue_push_head (self->page_cache_lru, page);
+    page->lru = self->page_cache_lru->head;
+    self->page_cache_size += cost;
+    g_hash_table_insert (self->page_cache, page->key, page);
+}
+
+/**
+mtx_text_view_set_page_cache_budget:
+Set the memory budget of the rendered-page cache, see
+#mtx_text_view_load_file.  Zero disables the cache.
+
+@budget: bytes. Default %MTX_TEXT_VIEW_PAGE_CACHE_BUDGET.
+*/
+void
+mtx_text_view_set_page_cache_budget (MtxTextView *self,
+                                     const gsize budget)
+{
+    g_return_if_fail (IS_MTX_TEXT_VIEW (self));
+
+    self->page_cache_budget = budget;
+    _page_cache_trim (self, budget);
+}
+
+/*****************
+*  PAGE LOADING  *
+*****************/
+
+/* A page load reads and converts a markdown file, parses the markup into runs,
+then fills the text buffer.  Only the fill, see _load_apply, needs the main
+loop; the rest can run in a worker thread with its own MtxCmm instance, see
+mtx_text_view_load_file_async.
+*/
+typedef struct _mtx_text_view_load
+{
+    gchar *file;            /* as requested, see "file-load-complete" */
+    gchar *paths[2];        /* candidate pathnames, in search order */
+    gchar *altpaths[2];     /* language-specific replacements, NULLABLE */
+    gchar *referrers[2];    /* image and link context of each candidate */
+    guint found;            /* index of the loaded candidate */
+    gboolean utf8_validate;
+    gboolean rebuild;       /* see mtx_text_view_reload_async */
+    gchar *key;             /* page cache key, NULLABLE */
+    MtxCmm *markdown;
+    gchar *markup;
+    GArray *block_ends;     /* (gsize) */
+    GPtrArray *runs;        /* (MtxTextViewPrivateRuns *) */
+    GPtrArray *link_dests;  /* (gchar *) */
+} MtxTextViewLoad;
+
+static MtxTextViewLoad *
+_load_new (const gchar *file,
+           const gboolean utf8_validate,
+           MtxCmm *markdown)
+{
+    MtxTextViewLoad *l = g_new0 (MtxTextViewLoad, 1);
+
+    l->file = g_strdup (file);
+    l->utf8_validate = utf8_validate;
+    l->markdown = markdown;
+    l->block_ends = g_array_new (FALSE, FALSE, sizeof (gsize));
+    return l;
+}
+
+static void
+_load_free (MtxTextViewLoad *l)
+{
+    g_free (l->file);
+    for (guint i = 0; i < G_N_ELEMENTS (l->paths); i++)
+    {
+        g_free (l->paths[i]);
+        g_free (l->altpaths[i]);
+        g_free (l->referrers[i]);
+    }
+    g_free (l->key);
+    g_clear_object (&l->markdown);
+    g_free (l->markup);
+    g_array_free (l->block_ends, TRUE);
+    if (l->runs != NULL)
+    {
+        g_ptr_array_unref (l->runs);
+    }
+    if (l->link_dests != NULL)
+    {
+        g_ptr_array_unref (l->link_dests);
+    }
+    g_free (l);
+}
+
+/**
+_load_find_alternates:
+Look up the language-specific replacement of each candidate of @l.  It reads
+the text view's settings, so call it in the main thread, before the load can
+move to a worker.
+*/
+static void
+_load_find_alternates (MtxTextView *self,
+                       MtxTextViewLoad *l)
+{
+    for (guint i = 0; i < G_N_ELEMENTS (l->paths) && l->paths[i]; i++)
+    {
+        l->altpaths[i] = mtx_text_view_auto_lang_find (self, l->paths[i]);
+    }
+}
+
+/**
+_load_set_candidates:
+Set the pathnames to try, in order, to load @file: relative to the image
+directory, then relative to @referrer's directory, and their
+language-specific replacements.
+*/
+static void
+_load_set_candidates (MtxTextView *self,
+                      MtxTextViewLoad *l,
+                      const gchar *referrer)
+{
+    const gchar *file = l->file;
+    g_autofree gchar *abs_img_dir =
+    g_canonicalize_filename (self->image_directory, NULL);
+    g_autofree gchar *basedir = NULL;
 
-                    gtk_text_iter_forward_to_tag_toggle (&end, NULL);
-                    ts = gtk_text_iter_get_tags (&end);
-                    for (tp = ts; tp != NULL && cont; tp = tp->next)
-                    {
-                        ta = tp->data;
-                        g_object_get (G_OBJECT (ta), "font", &prop, NULL);
-                        if (prop && *prop)
-                        {
-                            maybe_li_id = mtx_cmm_tag_get_info (self->markdown,
-                                                                prop,
-                                                                MTX_TAG_LI_ID);
-                            mtx_dbg_errout (-1, "this(%d) maybe(%d) prop(%s)\n",
-                                            this_li_id, maybe_li_id, prop);
-                            if (maybe_li_id == this_li_id || maybe_li_id > 0 ||
-                                (ol_ul_lvl = mtx_cmm_tag_get_info
-                                 (self->markdown, prop,
-                                  MTX_TAG_OL_UL_LEVEL)) > 0)
-                            {
-                                cont = FALSE;
-                            }
-                        }
-                        g_free (prop);
-                    }
-                    if (ts)
-                    {
-                        g_slist_free (ts);
-                    }
-                }
-                while (cont && ol_ul_lvl != 0);
-                mtx_dbg_errout (-1, "this(%d) ==? maybe(%d)\n", this_li_id,
-                                maybe_li_id);
+    if (g_path_is_absolute (file))
+    {
+        l->paths[0] = g_strdup (file);
+    }
+    else
+    {
+        l->paths[0] = g_build_filename (abs_img_dir, file, NULL);
+        l->referrers[0] = g_strdup (l->paths[0]);
+    }
 
-                _indent_slice_lines (self, &iter, &end, margin);
-                iter = end;
-                if (maybe_li_id > 0 && maybe_li_id != this_li_id)
-                {
-                    gtk_text_iter_backward_to_tag_toggle (&iter, NULL);
-                }
-            }
-            break;
+    /* retry relative to referrer's directory */
+    if (g_path_is_absolute (referrer))
+    {
+        basedir = g_path_get_dirname (referrer);
+    }
+    else
+    {
+        g_autofree gchar *q = g_canonicalize_filename (referrer, abs_img_dir);
+        basedir = g_path_get_dirname (q);
+    }
+    l->paths[1] = g_build_filename (basedir, file, NULL);
+    l->referrers[1] = g_strdup (l->paths[1]);
+    _load_find_alternates (self, l);
+}
+
+/**
+_load_from_cache:
+Look up the first existing candidate of @l in the page cache.
+
+Return: TRUE if @l was filled from the page cache.
+*/
+static gboolean
+_load_from_cache (MtxTextView *self,
+                  MtxTextViewLoad *l)
+{
+    for (guint i = 0; i < G_N_ELEMENTS (l->paths) && l->paths[i]; i++)
+    {
+        g_autofree gchar *key = _page_cache_key (l->paths[i], l->altpaths[i],
+                                                 l->markdown, l->utf8_validate);
+        MtxTextViewPrivatePage *page;
+
+        if (key == NULL)
+        {
+            continue;
         }
-        if (tags)
+        page = g_hash_table_lookup (self->page_cache, key);
+        if (page == NULL)
         {
-            g_slist_free (tags);
+            return FALSE;
         }
+        g_queue_unlink (self->page_cache_lru, page->lru);
+        g_queue_push_head_link (self->page_cache_lru, page->lru);
+        l->found = i;
+        l->markup = g_strdup (page->markup);
+        g_array_append_vals (l->block_ends, page->block_ends->data,
+                             page->block_ends->len);
+        l->runs = g_ptr_array_ref (page->runs);
+        l->link_dests = g_ptr_array_ref (page->link_dests);
+        return TRUE;
     }
-    while (gtk_text_iter_forward_to_tag_toggle (&iter, NULL));
-    g_string_free (fill, TRUE);
+    return FALSE;
 }
 
 /**
-_text_buffer_delete_unichar_all:
-Delete all occurrences of a Unicode code point.
+_load_run:
+Read and convert the first readable candidate of @l with l->markdown.  Safe to
+call from a worker thread, as it only uses @l.
+
+Return: FALSE and set @error if no candidate can be read or converted.
 */
-static void
-_text_buffer_delete_unichar_all (MtxTextView *self,
-                                 gunichar code_point)
+static gboolean
+_load_run (MtxTextViewLoad *l,
+           GCancellable *cancellable,
+           GError **error)
 {
-    GtkTextIter iter;
-    gtk_text_buffer_get_start_iter (self->buffer, &iter);
+    gchar *contents = NULL;
+    gint err = ENOENT;
 
-    while (!gtk_text_iter_is_end (&iter))
+    for (l->found = 0; l->found < G_N_ELEMENTS (l->paths)
+         && l->paths[l->found] != NULL; l->found++)
     {
-        gunichar ch = gtk_text_iter_get_char (&iter);
-        if (ch == code_point)
-        {
-            GtkTextIter next = iter;
-            gtk_text_iter_forward_char (&next);
-            gtk_text_buffer_delete (self->buffer, &iter, &next);
-            iter = next;
-        }
-        else
+        const gchar *path = l->altpaths[l->found] ? l->altpaths[l->found]
+                            : l->paths[l->found];
+
+        /* stat before reading: a file that changes meanwhile misses */
+        l->key = _page_cache_key (l->paths[l->found], l->altpaths[l->found],
+                                  l->markdown, l->utf8_validate);
+        errno = 0;
+        contents = _get_file_contents (path, NULL, l->utf8_validate);
+        if (contents != NULL)
         {
-            gtk_text_iter_forward_char (&iter);
+            break;
         }
+        err = errno ? errno : EILSEQ;
+        g_clear_pointer (&l->key, g_free);
+    }
+    if (contents == NULL)
+    {
+        g_set_error (error, G_FILE_ERROR, g_file_error_from_errno (err),
+                     "%s: %s", l->file, g_strerror (err));
+        return FALSE;
+    }
+    if (g_cancellable_set_error_if_cancelled (cancellable, error))
+    {
+        g_free (contents);
+        return FALSE;
+    }
+    l->markup = mtx_cmm_mtx_blocks (l->markdown, &contents, NULL, TRUE,
+                                    l->block_ends);
+    if (l->markup == NULL)
+    {
+        g_set_error (error, G_FILE_ERROR, G_FILE_ERROR_INVAL,
+                     "%s: conversion failed", l->file);
+        return FALSE;
     }
+    l->runs = _page_runs_new (l->markup, l->block_ends);
+    l->link_dests = _page_link_dests_new (l->markdown);
+    return TRUE;
 }
 
+/**
+_load_apply:
+Fill the text view with the page loaded by @l, and cache the page.
+*/
 static void
-_indent_text_buffer (MtxTextView *self)
+_load_apply (MtxTextView *self,
+             MtxTextViewLoad *l)
 {
-    _indent_li (self);
-    _indent_blockquote (self);
-    _text_buffer_delete_unichar_all (self, iUNIPUA_PANGO_EMPTY_SPAN);
+    if (l->key != NULL)
+    {
+        _page_cache_insert (self, g_steal_pointer (&l->key), l->markup,
+                            l->block_ends, l->runs, l->link_dests);
+    }
+    g_clear_pointer (&self->page_file, g_free);
+    _text_view_set_markup (self, g_steal_pointer (&l->markup), l->block_ends,
+                           l->runs, l->link_dests, l->referrers[l->found]);
+    self->page_file = g_strdup (l->paths[l->found]);
 }
 
 /**
-mtx_text_view_set_text:
-The markdown-to-text-view main entry point:
-Convert markdown text to Pango markup; resolve images; insert results into the
-text view buffer; re-prioritize buffer text tags, and apply indentation.
-
-@self:
-@text: address of a pointer to the markdown text string.
-@referrer: the base pathname context for loading images. See also
-#mtx_text_view_load_file.
-@clear_text: if TRUE, free the memory pointed to by @text and set @text to NULL.
-
-Returns: FALSE on parsing error otherwise return TRUE.
+_load_thread:
+GTaskThreadFunc: read and convert a page.  The worker uses its own MtxCmm
+instance, so the text view stays usable meanwhile.
 */
-gboolean
-mtx_text_view_set_text (MtxTextView *self,
-                        gchar **text,
-                        const gchar *referrer,
-                        const gboolean clear_text)
+static void
+_load_thread (GTask *task,
+              gpointer source_object __attribute__((unused)),
+              gpointer task_data,
+              GCancellable *cancellable)
 {
-    gchar *markup = NULL;
-    gboolean result = TRUE;
-
-    g_return_val_if_fail (IS_MTX_TEXT_VIEW (self), FALSE);
+    GError *error = NULL;
 
-    mtx_text_view_reset (self);
-#ifdef MTX_TEXT_VIEW_DEBUG
-    if (gl_text_view_debug_markup_file != NULL)
+    if (g_task_return_error_if_cancelled (task))
     {
-        gsize sz;
-
-        if (clear_text)
-        {
-            g_free (*text); /* superseded by the debug file to be loaded */
-            *text = NULL;
-        }
-        markup =
-        _get_file_contents (gl_text_view_debug_markup_file, &sz, TRUE);
-        g_printerr ("%s: read %lu bytes from %s\n", __FUNCTION__, sz,
-                    gl_text_view_debug_markup_file);
+        return;
     }
-    else
-#endif
+    if (_load_run (task_data, cancellable, &error))
     {
-        markup = mtx_cmm_mtx (self->markdown, text, NULL, clear_text);
+        g_task_return_boolean (task, TRUE);
     }
-    if (markup != NULL)
+    else
     {
-        GtkTextIter iter;
-
-        gtk_text_buffer_set_text (self->buffer, "\n", 1);
-        gtk_text_buffer_get_start_iter (self->buffer, &iter);
-        _text_buffer_insert_markup (self->buffer, &iter, markup);
-        g_free (markup);
-
-        load_images_and_mark_links (self, referrer);
+        g_task_return_error (task, error);
+    }
+}
 
-       /* set highlight tag's priority above text tags inserted from markup */
-        guint tsz =
-        gtk_text_tag_table_get_size (gtk_text_buffer_get_tag_table
-                                     (self->buffer));
-        gtk_text_tag_set_priority (self->highlight_tag, tsz - 1);
+/**
+_load_markdown_new:
+Return: a new converter configured like the text view's own.
+*/
+static MtxCmm *
+_load_markdown_new (MtxTextView *self)
+{
+    MtxCmm *markdown = mtx_cmm_new ();
 
-        _indent_text_buffer (self);
-    }
-    return result;
+    mtx_cmm_set_output (markdown, MTX_CMM_OUTPUT_PANGO);
+    mtx_cmm_set_escape (markdown, TRUE);
+    mtx_cmm_set_extensions (markdown, mtx_cmm_get_extensions (self->markdown));
+    mtx_cmm_set_tweaks (markdown, mtx_cmm_get_tweaks (self->markdown));
+    return markdown;
 }
 
 /**
 mtx_text_view_load_file:
 Load a markdown file into the text view.
 
+A page cache keeps the conversion of recently loaded files, so navigating back
+and forth between pages doesn't read and convert them again, unless they were
+modified.  See #mtx_text_view_set_page_cache_budget.
+
 @self:
 @file: the markdown file.
 @referrer: pathname (not necessarily directory, not necessarily absolute)
@@ -1507,62 +3183,202 @@ mtx_text_view_load_file (MtxTextView *self,
     g_return_val_if_fail (file && file[0] && referrer, FALSE);
     g_return_val_if_fail (self->image_directory, FALSE);
 
-    g_autofree gchar *basedir = NULL;
-    g_autofree gchar *abs_img_dir = NULL;
-    g_autofree gchar *path = NULL;
-    g_autofree gchar *contents = NULL;
-    gboolean retval = FALSE;
-    gboolean is_abs_referrer = g_path_is_absolute (referrer);
+    MtxTextViewLoad *l =
+    _load_new (file, utf8_validate, g_object_ref (self->markdown));
+    gboolean retval;
 
-    if (g_path_is_absolute (file))
+    _load_set_candidates (self, l, referrer);
+    retval = _load_from_cache (self, l) || _load_run (l, NULL, NULL);
+    if (retval)
+    {
+        _load_apply (self, l);
+        g_signal_emit (self, mtx_text_view_signals[FILE_LOAD_COMPLETE],
+                       0, file);
+    }
+    _load_free (l);
+    return retval;
+}
+
+/**
+mtx_text_view_load_file_async:
+Load a markdown file into the text view without blocking the main loop.
+Reading, validating and converting the file run in a worker thread; the text
+view is filled in #mtx_text_view_load_file_finish.  See
+#mtx_text_view_load_file for the parameters.
+
+@cancellable: cancel it to drop the load, e.g., when another page is
+requested first. NULLABLE.
+@callback: called in the main context when the file is converted.
+@user_data: passed to @callback.
+*/
+void
+mtx_text_view_load_file_async (MtxTextView *self,
+                               const gchar *file,
+                               const gchar *referrer,
+                               const gboolean utf8_validate,
+                               GCancellable *cancellable,
+                               GAsyncReadyCallback callback,
+                               gpointer user_data)
+{
+    g_return_if_fail (IS_MTX_TEXT_VIEW (self));
+    g_return_if_fail (file && file[0] && referrer);
+    g_return_if_fail (self->image_directory);
+
+    GTask *task = g_task_new (self, cancellable, callback, user_data);
+    MtxTextViewLoad *l =
+    _load_new (file, utf8_validate, _load_markdown_new (self));
+
+    g_task_set_source_tag (task, mtx_text_view_load_file_async);
+    g_task_set_task_data (task, l, (GDestroyNotify) _load_free);
+    _load_set_candidates (self, l, referrer);
+    if (_load_from_cache (self, l))
     {
-        contents =
-        mtx_text_view_get_file_contents (self, file, NULL, utf8_validate);
+        g_task_return_boolean (task, TRUE);
     }
     else
     {
-        abs_img_dir = g_canonicalize_filename (self->image_directory, NULL);
-        path = g_build_filename (abs_img_dir, file, NULL);
-        contents =
-        mtx_text_view_get_file_contents (self, path, NULL, utf8_validate);
+        g_task_run_in_thread (task, _load_thread);
     }
+    g_object_unref (task);
+}
 
-    if (contents == NULL)
+/**
+mtx_text_view_load_file_finish:
+Fill the text view with the page loaded by #mtx_text_view_load_file_async, and
+emit signal "file-load-complete".
+
+Returns: TRUE if the text view was filled, otherwise FALSE and sets @error;
+G_IO_ERROR_CANCELLED if the load was cancelled.
+*/
+gboolean
+mtx_text_view_load_file_finish (MtxTextView *self,
+                                GAsyncResult *result,
+                                GError **error)
+{
+    g_return_val_if_fail (g_task_is_valid (result, self), FALSE);
+
+    MtxTextViewLoad *l = g_task_get_task_data (G_TASK (result));
+
+    if (!g_task_propagate_boolean (G_TASK (result), error))
     {
-        /* retry relative to referrer's directory */
+        return FALSE;
+    }
+    _load_apply (self, l);
+    g_signal_emit (self, mtx_text_view_signals[FILE_LOAD_COMPLETE], 0,
+                   l->file);
+    return TRUE;
+}
 
-        g_free (path);
+/**
+mtx_text_view_get_file:
 
-        if (is_abs_referrer)
-        {
-            basedir = g_path_get_dirname (referrer);
-            path = g_build_filename (basedir, file, NULL);
-        }
-        else
-        {
-            if (abs_img_dir == NULL)
-            {
-                abs_img_dir =
-                g_canonicalize_filename (self->image_directory, NULL);
-            }
-            gchar *q = g_canonicalize_filename (referrer, abs_img_dir);
-            basedir = g_path_get_dirname (q);
-            path = g_build_filename (basedir, file, NULL);
-            g_free (q);
-        }
-        contents =
-        mtx_text_view_get_file_contents (self, path, NULL, utf8_validate);
+Return: the pathname of the file that #mtx_text_view_load_file loaded into the
+text view, or NULL if the page didn't come from a file.  The string is owned by
+the text view.
+*/
+const gchar *
+mtx_text_view_get_file (MtxTextView *self)
+{
+    g_return_val_if_fail (IS_MTX_TEXT_VIEW (self), NULL);
+    return self->page_file;
+}
+
+/**
+mtx_text_view_get_image_files:
+
+Return: a newly-allocated list of the pathnames of the image files shown in the
+page.  Free the list with g_list_free; the strings are owned by the text view.
+*/
+GList *
+mtx_text_view_get_image_files (MtxTextView *self)
+{
+    g_return_val_if_fail (IS_MTX_TEXT_VIEW (self), NULL);
+    return g_hash_table_get_keys (self->page_images);
+}
+
+/**
+mtx_text_view_reload_async:
+Reload the page file, see #mtx_text_view_get_file, in a worker thread.
+Reading and converting the file doesn't block the main loop; only the
+changed blocks of the page are replaced when the text view is updated in
+#mtx_text_view_reload_finish.
+
+@self:
+@rebuild: if TRUE rebuild the whole page, e.g., because some image changed.
+@cancellable: NULLABLE.
+@callback: called in the main context when the file is converted.
+@user_data: passed to @callback.
+*/
+void
+mtx_text_view_reload_async (MtxTextView *self,
+                            const gboolean rebuild,
+                            GCancellable *cancellable,
+                            GAsyncReadyCallback callback,
+                            gpointer user_data)
+{
+    g_return_if_fail (IS_MTX_TEXT_VIEW (self));
+
+    GTask *task = g_task_new (self, cancellable, callback, user_data);
+    MtxTextViewLoad *l;
+
+    g_task_set_source_tag (task, mtx_text_view_reload_async);
+    if (self->page_file == NULL)
+    {
+        g_task_return_new_error (task, G_FILE_ERROR, G_FILE_ERROR_NOENT,
+                                 "no page file to reload");
+        g_object_unref (task);
+        return;
     }
-    if (contents != NULL)
+    l = _load_new (self->page_file, TRUE, _load_markdown_new (self));
+    l->paths[0] = g_strdup (self->page_file);
+    l->referrers[0] = g_strdup (self->page_referrer);
+    _load_find_alternates (self, l);
+    l->rebuild = rebuild;
+    g_task_set_task_data (task, l, (GDestroyNotify) _load_free);
+    if (_load_from_cache (self, l))
     {
-        retval = mtx_text_view_set_text (self, &contents, path, TRUE);
-        if (retval)
-        {
-            g_signal_emit (self, mtx_text_view_signals[FILE_LOAD_COMPLETE],
-                           0, file);
-        }
+        g_task_return_boolean (task, TRUE);
     }
-    return retval;
+    else
+    {
+        g_task_run_in_thread (task, _load_thread);
+    }
+    g_object_unref (task);
+}
+
+/**
+mtx_text_view_reload_finish:
+Update the text view with the page reloaded by #mtx_text_view_reload_async.
+Nothing changes if the text view moved on to a different page meanwhile.
+
+Returns: TRUE if the text view was updated, otherwise FALSE and sets @error.
+*/
+gboolean
+mtx_text_view_reload_finish (MtxTextView *self,
+                             GAsyncResult *result,
+                             GError **error)
+{
+    g_return_val_if_fail (g_task_is_valid (result, self), FALSE);
+
+    MtxTextViewLoad *l = g_task_get_task_data (G_TASK (result));
+
+    if (!g_task_propagate_boolean (G_TASK (result), error))
+    {
+        return FALSE;
+    }
+    if (g_strcmp0 (l->paths[0], self->page_file) != 0)
+    {
+        g_set_error (error, G_IO_ERROR, G_IO_ERROR_CANCELLED,
+                     "%s: page changed", l->file);
+        return FALSE;
+    }
+
+    if (l->rebuild)
+    {
+        mtx_text_view_reset (self);
+    }
+    _load_apply (self, l);
+    return TRUE;
 }
 
 void
@@ -1916,6 +3732,20 @@ mtx_text_view_init (MtxTextView *self)
                                 NULL);
     self->link_marks = g_ptr_array_new ();
     self->auto_languages = NULL;
+    self->page_blocks = g_array_new (FALSE, FALSE,
+                                     sizeof (MtxTextViewPrivateBlock));
+    self->page_link_dests = g_ptr_array_new_with_free_func (g_free);
+    self->page_images = g_hash_table_new_full (g_str_hash, g_str_equal,
+                                               g_free, NULL);
+    self->empty_span_marks = g_ptr_array_new ();
+    self->page_cache = g_hash_table_new_full (g_str_hash, g_str_equal, NULL,
+                                              (GDestroyNotify) _page_free);
+    self->page_cache_lru = g_queue_new ();
+    self->image_cancellable = g_cancellable_new ();
+    self->tag_intern = g_hash_table_new_full (g_str_hash, g_str_equal, g_free,
+                                              NULL);
+    self->page_cache_size = 0;
+    self->page_cache_budget = MTX_TEXT_VIEW_PAGE_CACHE_BUDGET;
 
     g_signal_connect (self, "event-after", G_CALLBACK (event_after), NULL);
     g_signal_connect (self, "key-press-event",
@@ -1972,35 +3802,22 @@ _get_file_contents (const gchar *path,
                     gsize *size,
                     const gboolean utf8_validate)
 {
-    int fd;
     gchar *buffer = NULL;
-    const gchar *invalid;
+    const gchar *mapped, *invalid;
     gsize sz = 0;
-    if ((fd = open (path, O_RDONLY)) >= 0)
-    {
-        struct stat sb;
-        fstat (fd, &sb);
-        gchar *mapped =
-        mmap (NULL, sb.st_size, PROT_READ, MAP_SHARED | MAP_NORESERVE, fd, 0);
-        close (fd);
-        if (mapped != MAP_FAILED)
-        {
-            buffer = g_malloc (sb.st_size + 1);
-            memcpy (buffer, mapped, sb.st_size);
-            munmap (mapped, sb.st_size);
-            buffer[sz = sb.st_size] = 0;
-            if (utf8_validate && !g_utf8_validate (buffer, -1, &invalid))
-            {
-                g_critical ("%s: invalid UTF-8 data at offset %ld", path,
-                            invalid - buffer);
-                g_free (buffer);
-                buffer = NULL;
-            }
-        }
-        else if (sb.st_size == 0)
+
+    if ((mapped = mtx_map_file_contents (path, &sz, FALSE)) != NULL)
+    {
+        buffer = g_malloc (sz + 1);
+        memcpy (buffer, mapped, sz);
+        mtx_unmap_file_contents (mapped, sz);
+        buffer[sz] = 0;
+        if (utf8_validate && !g_utf8_validate (buffer, -1, &invalid))
         {
-            buffer = g_malloc (1);
-            *buffer = '\0';
+            g_critical ("%s: invalid UTF-8 data at offset %ld", path,
+                        invalid - buffer);
+            g_free (buffer);
+            buffer = NULL;
         }
     }
     if (size != NULL)
@@ -2028,14 +3845,37 @@ mtx_text_view_auto_lang_find (MtxTextView *self,
                               const gchar *path)
 {
     g_return_val_if_fail (IS_MTX_TEXT_VIEW (self), NULL);
+
+    return mtx_text_view_auto_lang_find_in
+        ((const gchar *const *) self->auto_languages, path, NULL);
+}
+
+/**
+mtx_text_view_auto_lang_find_in:
+Like #mtx_text_view_auto_lang_find but for the list @languages, which is not
+tied to a widget, and look for the replacement among the names in @siblings
+instead of testing the file system once per language.  Safe to call from any
+thread.
+
+@languages: language list, e.g., a copy of the auto_languages field. NULLABLE.
+@path: File[.ext]
+@siblings: set of the names of the files that exist in the directory of @path.
+NULLABLE to test the file system.
+*/
+gchar *
+mtx_text_view_auto_lang_find_in (const gchar *const *languages,
+                                 const gchar *path,
+                                 GHashTable *siblings)
+{
     g_return_val_if_fail (path != NULL, NULL);
 
-    if (self->auto_languages == NULL)
+    if (languages == NULL)
     {
         return NULL;
     }
     g_return_val_if_fail (path && *path, NULL);
-    gchar *result, **lang;
+    gchar *result;
+    const gchar *const *lang;
     g_autofree const gchar *dirname = g_path_get_dirname (path);
     g_autofree gchar *basename = g_path_get_basename (path);
     gchar *ext = NULL;
@@ -2045,12 +3885,12 @@ mtx_text_view_auto_lang_find (MtxTextView *self,
         *dot = '\0';
         ext = dot + 1;
     }
-    for (lang = self->auto_languages; *lang; lang++)
+    for (lang = languages; *lang; lang++)
     {
         gchar *filename;
         if (ext == NULL)
         {
-           filename = g_strconcat (basename, ".", lang, NULL);
+           filename = g_strconcat (basename, ".", *lang, NULL);
         }
         else
         {
@@ -2058,13 +3898,16 @@ mtx_text_view_auto_lang_find (MtxTextView *self,
         }
         mtx_dbg_errout (-1, "%s", "");
         result = g_build_filename (dirname, filename, NULL);
-        g_free (filename);
         mtx_dbg_errseq (-1, "exists? (%s)", result);
-        if (g_file_test (result, G_FILE_TEST_EXISTS))
+        if (siblings != NULL ? g_hash_table_contains (siblings, filename)
+            : g_file_test (result, G_FILE_TEST_EXISTS))
         {
             mtx_dbg_errseq (-1, "%s FOUND!\n", "");
+            g_free (filename);
             return result;
         }
+        g_free (filename);
+        g_free (result);
     }
     mtx_dbg_errseq (-1, "%s\n", "");
     return NULL;
@@ -2103,6 +3946,10 @@ mtx_text_view_dispose (GObject *gobject)
     mtx_text_view_get_instance_private (MTX_TEXT_VIEW (gobject));
 
     g_clear_object (&priv->markdown);  /* NOLINT(bugprone-sizeof-expression) */
+    if (priv->image_cancellable != NULL)
+    {
+        g_cancellable_cancel (priv->image_cancellable);
+    }
 
     G_OBJECT_CLASS (mtx_text_view_parent_class)->dispose (gobject);
 }
@@ -2124,6 +3971,18 @@ mtx_text_view_finalize (GObject *gobject)
         g_free (g_ptr_array_index (priv->link_marks, i));
     }
     g_ptr_array_free (priv->link_marks, TRUE);
+    /* Block marks belong to the text buffer. */
+    g_array_free (priv->page_blocks, TRUE);
+    g_ptr_array_unref (priv->page_link_dests);
+    g_free (priv->page_markup);
+    g_free (priv->page_referrer);
+    g_free (priv->page_file);
+    g_hash_table_destroy (priv->page_images);
+    g_ptr_array_free (priv->empty_span_marks, TRUE);
+    g_queue_free (priv->page_cache_lru);
+    g_hash_table_destroy (priv->page_cache);
+    g_clear_object (&priv->image_cancellable);
+    g_hash_table_destroy (priv->tag_intern);
     g_strfreev (priv->auto_languages);
     g_free (priv->image_directory);
 
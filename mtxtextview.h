@@ -88,6 +88,14 @@ typedef struct _MtxTextViewLinkInfo
 } MtxTextViewLinkInfo;
 
 typedef struct _MtxTextViewPrivateRendered MtxTextViewPrivateRendered;
+typedef struct _MtxTextViewPrivateBlock MtxTextViewPrivateBlock;
+typedef struct _MtxTextViewPrivatePage MtxTextViewPrivatePage;
+typedef struct _MtxTextViewPrivateRuns MtxTextViewPrivateRuns;
+
+/* Default memory budget of the rendered-page cache, bytes. */
+#define MTX_TEXT_VIEW_PAGE_CACHE_BUDGET (8 * 1024 * 1024)
+/* Default memory budget of the process-wide image cache, bytes. */
+#define MTX_TEXT_VIEW_IMAGE_CACHE_BUDGET (32 * 1024 * 1024)
 
 struct _MtxTextView {
     /* TODO reorder placing public fields on top */
@@ -105,6 +113,23 @@ struct _MtxTextView {
     MtxTextViewPrivateRendered *blockquote_start;
     MtxTextViewPrivateRendered *blockquote_end;
     guint indent_quantum;
+    /* Page index for incremental updates, see mtx_text_view_set_text. */
+    gchar *page_markup;
+    gchar *page_referrer;
+    GArray *page_blocks;             /* (MtxTextViewPrivateBlock) */
+    GPtrArray *page_link_dests;      /* (gchar *) read-only, shared */
+    GtkTextMark *page_end;
+    guint page_tag_count;
+    gchar *page_file;                /* see mtx_text_view_get_file */
+    GHashTable *page_images;         /* set of image pathnames */
+    GPtrArray *empty_span_marks;     /* see _text_buffer_delete_empty_spans */
+    /* Rendered-page cache, see mtx_text_view_load_file. */
+    GHashTable *page_cache;          /* key => MtxTextViewPrivatePage */
+    GQueue *page_cache_lru;          /* most recently used first */
+    gsize page_cache_size;           /* bytes */
+    gsize page_cache_budget;         /* bytes */
+    GCancellable *image_cancellable; /* image decoding in progress */
+    GHashTable *tag_intern;          /* signature => anonymous GtkTextTag */
 };
 
 struct _MtxTextViewClass
@@ -119,8 +144,18 @@ struct _MtxTextViewClass
 
 GtkWidget *mtx_text_view_new ();
 gboolean mtx_text_view_load_file (MtxTextView *, const gchar *, const gchar *, const gboolean);
+void mtx_text_view_load_file_async (MtxTextView *, const gchar *, const gchar *, const gboolean, GCancellable *, GAsyncReadyCallback, gpointer);
+gboolean mtx_text_view_load_file_finish (MtxTextView *, GAsyncResult *, GError **);
 gboolean mtx_text_view_set_text (MtxTextView *, gchar **, const gchar *, const gboolean);
+gboolean mtx_text_view_append_text (MtxTextView *, gchar **, const gboolean);
+const gchar *mtx_text_view_get_file (MtxTextView *);
+GList *mtx_text_view_get_image_files (MtxTextView *);
+void mtx_text_view_reload_async (MtxTextView *, const gboolean, GCancellable *, GAsyncReadyCallback, gpointer);
+gboolean mtx_text_view_reload_finish (MtxTextView *, GAsyncResult *, GError **);
 void mtx_text_view_reset (MtxTextView *);
+void mtx_text_view_set_page_cache_budget (MtxTextView *, const gsize);
+void mtx_text_view_set_image_cache_budget (const gsize);
+void mtx_text_view_get_image_cache_stats (guint *, guint *, gsize *);
 void mtx_text_view_set_image_directory (MtxTextView *, const gchar *);
 void mtx_text_view_set_extensions (MtxTextView *, const MtxCmmExtensions);
 void mtx_text_view_set_tweaks (MtxTextView *, const MtxCmmTweaks);
@@ -136,6 +171,7 @@ const MtxTextViewLinkInfo *mtx_text_view_link_info_get (MtxTextView *, const gui
 const MtxTextViewLinkInfo *mtx_text_view_link_info_get_near_offset (MtxTextView *,guint, const gint);
 void mtx_text_view_set_auto_lang_find (MtxTextView *, const gboolean);
 gchar *mtx_text_view_auto_lang_find (MtxTextView *, const gchar *);
+gchar *mtx_text_view_auto_lang_find_in (const gchar *const *, const gchar *, GHashTable *);
 gchar *mtx_text_view_get_file_contents (MtxTextView *, const gchar *, gsize *, const gboolean);
 gint mtx_text_view_get_link_at_iter (MtxTextView *, GtkTextIter *, const gchar **, guint *);
 
@@ -35,6 +35,38 @@ struct _MtxTextViewPrivateRendered
     guint   height;  /* pixel */
 };
 
+/* Top-level block of the page markup, see mtx_text_view_set_text. */
+struct _MtxTextViewPrivateBlock
+{
+    gsize        offset;  /* in the page markup, bytes */
+    gsize        len;     /* bytes */
+    guint        hash;    /* of the block markup */
+    GtkTextMark *mark;    /* block start in the text buffer */
+};
+
+/* Markup parsed into plain text and attribute ranges, see _runs_new. */
+struct _MtxTextViewPrivateRuns
+{
+    gchar         *text;
+    gsize          len;     /* bytes */
+    PangoAttrList *attrs;   /* NULLABLE */
+    guint          count;   /* attribute ranges */
+    GArray        *empty_spans; /* (gint) char offsets of
+                                   iUNIPUA_PANGO_EMPTY_SPAN, NULLABLE */
+};
+
+/* Rendered page of the page cache, see mtx_text_view_load_file. */
+struct _MtxTextViewPrivatePage
+{
+    gchar     *key;         /* pathname, file stamp and conversion flags */
+    gchar     *markup;
+    GArray    *block_ends;  /* (gsize) */
+    GPtrArray *runs;        /* (MtxTextViewPrivateRuns *) read-only, shared */
+    GPtrArray *link_dests;  /* (gchar *) read-only, shared */
+    gsize      cost;        /* bytes */
+    GList     *lru;         /* link in MtxTextView.page_cache_lru */
+};
+
 G_END_DECLS
 
 #endif /* MTX_TEXT_VIEW_PRIVATE_H */
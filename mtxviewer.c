@@ -46,7 +46,6 @@ from the hardinfo "help-viewer" directory.
  *    Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301 USA
  */
 
-#define _GNU_SOURCE                      /* for strcasestr() */
 #define GLIB_VERSION_MIN_REQUIRED GLIB_VERSION_2_66
 #include <string.h>
 #include <stdlib.h>
@@ -61,6 +60,8 @@ from the hardinfo "help-viewer" directory.
 #include <locale.h>
 
 #include "mtxcmm.h"
+#include "mtxmatch.h"
+#include "mtxsearchindex.h"
 #include "mtxtextview.h"
 #include "mtxviewer.h"
 #include "mtxversion.h"
@@ -69,6 +70,13 @@ from the hardinfo "help-viewer" directory.
 #define STATUSBAR_CTX_MAIN 0
 #define STATUSBAR_CTX_LINK 1
 #define STATUSBAR_CTX_WARN 2
+#define STATUSBAR_CTX_SEARCH 3
+
+/* Coalesce bursts of file change events within this many milliseconds. */
+#define MTX_VIEWER_WATCH_DEBOUNCE 250
+
+/* Append search results to the page at most this often, in milliseconds. */
+#define MTX_VIEWER_SEARCH_BATCH_MS 100
 
 typedef struct mtx_viewer_nav_unit
 {
@@ -76,10 +84,89 @@ typedef struct mtx_viewer_nav_unit
     guint offset;
 } MtxViewerNavUnit;
 
+/* What to do with the navigation trail when a page load completes. */
+typedef enum
+{
+    MTX_VIEWER_NAV_LINK,
+    MTX_VIEWER_NAV_FORE,
+    MTX_VIEWER_NAV_BACK,
+    MTX_VIEWER_NAV_HOME,
+} MtxViewerNavAction;
+
+typedef struct mtx_viewer_page_load
+{
+    MtxViewer *mvr;
+    MtxViewerNavAction action;
+    gchar *page;            /* as requested */
+    guint offset;           /* see dispatch_to_page_async */
+} MtxViewerPageLoad;
+
+/*
+A directory search in progress, see do_file_search.  Directory jobs walk the
+tree in the thread pool and queue one file job per searchable file to the same
+pool; file jobs index, read and match files, and push the finished jobs to
+@done.  A main loop timeout drains @done in batches, updates the search index,
+and appends the new results to the page.
+The walkers look up the search index and push jobs under @walk_lock, and only
+while the search isn't cancelled, so _search_cancel can release the index and
+the pool to the viewer.
+*/
+typedef struct mtx_viewer_search
+{
+    gint ref;                   /* the viewer's, and one per queued job */
+    gint pending;               /* queued jobs */
+    GCancellable *cancellable;
+    gchar *text;                /* as entered */
+    MtxMatch *match;            /* of the search terms */
+    gint argc;
+    GRegex *regex_astx;
+    gchar **languages;          /* for auto_lang_find_in, NULLABLE */
+    guint depth;                /* of subdirectories to walk */
+    GPtrArray *exclude;         /* (GPatternSpec *) */
+    GHashTable *candidates;     /* see mtx_search_index_query, NULLABLE */
+    GMutex walk_lock;           /* protects @index, @pool and @visited */
+    MtxSearchIndex *index;
+    GThreadPool *pool;
+    GHashTable *visited;        /* (MtxViewerSearchDir *) directories */
+    gint n_queued;              /* file jobs */
+    guint n_drained;
+    gint ctr_subjects;          /* text files */
+    GPtrArray *results;         /* (MtxViewerSearchJob *) main thread only */
+    guint n_shown;              /* leading @results on the page */
+    guint timeout_id;
+    GMutex lock;                /* protects @done */
+    GPtrArray *done;            /* (MtxViewerSearchJob *) */
+} MtxViewerSearch;
+
+typedef struct mtx_viewer_search_job
+{
+    MtxViewerSearch *search;
+    gboolean is_directory;      /* a directory to walk */
+    guint depth;                /* of @name below the search directory */
+    gchar *name;                /* directory-relative, NULL for the top */
+    gchar *name_path;           /* absolute path of @name */
+    gchar *path;                /* file to match, @name_path or its alternate */
+    struct stat st;             /* of @name */
+    MtxSearchIndexKind kind;    /* of @name */
+    gboolean stale;             /* @name needs indexing */
+    GArray *trigrams;           /* set by the worker if @stale */
+    gchar *item;                /* markdown list item if @path matches */
+} MtxViewerSearchJob;
+
+/* Identity of a walked directory, to not follow symbolic link loops. */
+typedef struct mtx_viewer_search_dir
+{
+    dev_t dev;
+    ino_t ino;
+} MtxViewerSearchDir;
+
 static gboolean do_file_search (MtxViewer *, const gchar *);
+static void _search_cancel (MtxViewer *, const gboolean);
 static gboolean do_resource_load (MtxViewer *, const gchar *, const gchar *);
 static void file_load_complete (MtxTextView *, const gchar *, gpointer);
 static void on_curpos_changed (GtkTextBuffer *, GParamSpec *, gpointer);
+static void _watch_start (MtxViewer *);
+static void _watch_stop (MtxViewer *);
 
 #ifdef VIEWER_DEBUG
 
@@ -414,6 +501,21 @@ edit_text_file (MtxViewer *mvr,
     }
 }
 
+/**
+_page_load_cancel:
+Drop the page load in progress, if any, including a directory search.
+*/
+static void
+_page_load_cancel (MtxViewer *mvr)
+{
+    _search_cancel (mvr, FALSE);
+    if (mvr->load_cancellable != NULL)
+    {
+        g_cancellable_cancel (mvr->load_cancellable);
+        g_clear_object (&mvr->load_cancellable);
+    }
+}
+
 /**
 dispatch_to_page:
 Load a new page from a file path or a URI.
@@ -424,8 +526,9 @@ Returns: TRUE if a new page was loaded otherwise returns FALSE.
 */
 /*
 A discipline of navigation history:
-Viewer navigation history shall be managed only by the callers of this function
-and by the `file_load_complete` callback, which is connected to the
+Viewer navigation history shall be managed only by the callers of this function,
+by `_page_load_done` on behalf of the callers of `dispatch_to_page_async`, and
+by the `file_load_complete` callback, which is connected to the
 "file-load-complete" signal emitted by `mtx_text_view_load_file()`.
 */
 static gboolean
@@ -435,6 +538,7 @@ dispatch_to_page (MtxViewer *mvr,
     const gchar *scheme = g_uri_peek_scheme (path);
     gboolean retval = FALSE; /* => found an unknown scheme */
 
+    _page_load_cancel (mvr);
     if (g_strcmp0 (scheme, "search") == 0)
     {
         retval = do_file_search (mvr, path + sizeof ("search://") - 1);
@@ -468,6 +572,143 @@ dispatch_to_page (MtxViewer *mvr,
     return retval;
 }
 
+static MtxViewerPageLoad *
+_page_load_new (MtxViewer *mvr,
+                const MtxViewerNavAction action,
+                const gchar *page,
+                const guint offset)
+{
+    MtxViewerPageLoad *pl = g_new (MtxViewerPageLoad, 1);
+
+    pl->mvr = mvr;
+    pl->action = action;
+    pl->page = g_strdup (page);
+    pl->offset = offset;
+    return pl;
+}
+
+static void
+_page_load_free (MtxViewerPageLoad *pl)
+{
+    g_free (pl->page);
+    g_free (pl);
+}
+
+/**
+_page_load_done:
+Update the navigation trail after a page load, the way the callers of
+#dispatch_to_page do.
+*/
+static void
+_page_load_done (MtxViewer *mvr,
+                 MtxViewerPageLoad *pl,
+                 const gboolean loaded)
+{
+    switch (pl->action)
+    {
+    case MTX_VIEWER_NAV_LINK:
+        if (loaded)
+        {
+            _nav_trail_fore_clear (mvr);
+            _nav_trail_insert (mvr, mvr->current_file, pl->offset);
+            mtx_text_view_cursor_to_top (MTX_TEXT_VIEW (mvr->text_view));
+        }
+        break;
+    case MTX_VIEWER_NAV_FORE:
+        if (loaded)
+        {
+            _nav_trail_fore (mvr);
+            mvr->current_curpos = pl->offset;
+        }
+        break;
+    case MTX_VIEWER_NAV_BACK:
+        if (loaded)
+        {
+            _nav_trail_back (mvr);
+            mvr->current_curpos = pl->offset;
+        }
+        break;
+    case MTX_VIEWER_NAV_HOME:
+        if (loaded)
+        {
+            _nav_trail_fore_clear (mvr);
+            _nav_trail_insert (mvr, pl->page, pl->offset);
+        }
+        break;
+    }
+}
+
+/**
+page_load_ready:
+GAsyncReadyCallback of #dispatch_to_page_async.
+*/
+static void
+page_load_ready (GObject *source,
+                 GAsyncResult *result,
+                 gpointer data)
+{
+    MtxViewerPageLoad *pl = (MtxViewerPageLoad *) data;
+    MtxViewer *mvr = pl->mvr;
+    GError *error = NULL;
+    gboolean loaded =
+    mtx_text_view_load_file_finish (MTX_TEXT_VIEW (source), result, &error);
+
+    /* A cancelled load was superseded; leave mvr alone. */
+    if (loaded || !g_error_matches (error, G_IO_ERROR, G_IO_ERROR_CANCELLED))
+    {
+        g_clear_object (&mvr->load_cancellable);
+        if (!loaded)
+        {
+            gtk_statusbar_push (GTK_STATUSBAR (mvr->status_bar),
+                                STATUSBAR_CTX_WARN, error->message);
+        }
+        _page_load_done (mvr, pl, loaded);
+        if (pl->action != MTX_VIEWER_NAV_LINK)
+        {
+            g_idle_add (G_SOURCE_FUNC (idle_scroll_to_curpos), mvr);
+        }
+    }
+    g_clear_error (&error);
+    _page_load_free (pl);
+}
+
+/**
+dispatch_to_page_async:
+Like #dispatch_to_page but files are loaded without blocking the main loop,
+see #mtx_text_view_load_file_async.  A new request cancels the pending load.
+Once the page is presented, @action updates the navigation trail.
+
+@path: file path or URI.
+@referrer: context for resolving relative file paths.
+@offset: for MTX_VIEWER_NAV_LINK and MTX_VIEWER_NAV_HOME the cursor offset of
+the page being left; for MTX_VIEWER_NAV_FORE and MTX_VIEWER_NAV_BACK the cursor
+position to restore once the page is loaded.  A failed or cancelled load leaves
+the current cursor position alone.
+*/
+static void
+dispatch_to_page_async (MtxViewer *mvr,
+                        const gchar *path,
+                        const gchar *referrer,
+                        const MtxViewerNavAction action,
+                        const guint offset)
+{
+    MtxViewerPageLoad *pl = _page_load_new (mvr, action, path, offset);
+
+    if (g_uri_peek_scheme (path) == NULL)
+    {
+        _page_load_cancel (mvr);
+        mvr->load_cancellable = g_cancellable_new ();
+        mtx_text_view_load_file_async (MTX_TEXT_VIEW (mvr->text_view), path,
+                                       referrer, TRUE, mvr->load_cancellable,
+                                       page_load_ready, pl);
+    }
+    else
+    {
+        _page_load_done (mvr, pl, dispatch_to_page (mvr, path));
+        _page_load_free (pl);
+    }
+}
+
 /**
 */
 static void
@@ -478,17 +719,10 @@ nav_fore_clicked (GtkWidget *widget __attribute__((unused)),
     MtxViewerNavUnit *fore =
     (MtxViewerNavUnit *) g_queue_peek_nth (mvr->nav_trail,
                                            mvr->nav_trail_page_idx + 1);
-    guint saved_curpos = mvr->current_curpos;
     ((MtxViewerNavUnit *) mvr->nav_trail_page)->offset = mvr->changed_curpos;
-    mvr->current_curpos = fore->offset;
-    if (dispatch_to_page (mvr, fore->file))
-    {
-        _nav_trail_fore (mvr);
-    }
-    else
-    {
-        mvr->current_curpos = saved_curpos;
-    }
+    dispatch_to_page_async (mvr, fore->file,
+                            mvr->current_file ? mvr->current_file : "",
+                            MTX_VIEWER_NAV_FORE, fore->offset);
 }
 
 /**
@@ -518,17 +752,10 @@ nav_back_clicked (GtkWidget *widget __attribute__((unused)),
     MtxViewerNavUnit *back =
     (MtxViewerNavUnit *) g_queue_peek_nth (mvr->nav_trail,
                                            mvr->nav_trail_page_idx - 1);
-    guint saved_curpos = mvr->current_curpos;
     ((MtxViewerNavUnit *) mvr->nav_trail_page)->offset = mvr->changed_curpos;
-    mvr->current_curpos = back->offset;
-    if (dispatch_to_page (mvr, back->file))
-    {
-        _nav_trail_back (mvr);
-    }
-    else
-    {
-        mvr->current_curpos = saved_curpos;
-    }
+    dispatch_to_page_async (mvr, back->file,
+                            mvr->current_file ? mvr->current_file : "",
+                            MTX_VIEWER_NAV_BACK, back->offset);
 }
 
 /**
@@ -554,7 +781,7 @@ Callback from #MtxTextView class.
 @link_dest: format: <uri-encoded>\n<verbatim>
 */
 static void
-on_link_clicked (MtxTextView *text_view,
+on_link_clicked (MtxTextView *text_view __attribute__((unused)),
                  const gchar *link_dest,
                  gpointer data)
 {
@@ -568,27 +795,16 @@ on_link_clicked (MtxTextView *text_view,
     if (scheme == NULL)
     {
         gtk_statusbar_pop (GTK_STATUSBAR (mvr->status_bar), STATUSBAR_CTX_LINK);
-        const guint offset = mvr->changed_curpos;
-        if (mtx_text_view_load_file (text_view, link, current_scheme ? "/" :
-                                     mvr->current_file, TRUE))
-        {
-            _nav_trail_fore_clear (mvr);
-            _nav_trail_insert (mvr, mvr->current_file, offset);
-            mtx_text_view_cursor_to_top (MTX_TEXT_VIEW (mvr->text_view));
-        }
+        dispatch_to_page_async (mvr, link, current_scheme ? "/" :
+                                mvr->current_file, MTX_VIEWER_NAV_LINK,
+                                mvr->changed_curpos);
     }
     else if (strcmp (scheme, "file") == 0)
     {
         gtk_statusbar_pop (GTK_STATUSBAR (mvr->status_bar), STATUSBAR_CTX_LINK);
-        const guint offset = mvr->changed_curpos;
-        if (mtx_text_view_load_file (text_view, link + sizeof "file://" - 1,
-                                     current_scheme ? "/" :
-                                     mvr->current_file, TRUE))
-        {
-            _nav_trail_fore_clear (mvr);
-            _nav_trail_insert (mvr, mvr->current_file, offset);
-            mtx_text_view_cursor_to_top (MTX_TEXT_VIEW (mvr->text_view));
-        }
+        dispatch_to_page_async (mvr, link + sizeof "file://" - 1,
+                                current_scheme ? "/" : mvr->current_file,
+                                MTX_VIEWER_NAV_LINK, mvr->changed_curpos);
     }
     else if (strcmp (scheme, "https") == 0 || strcmp (scheme, "http") == 0
              || strcmp (scheme, "ftp") == 0 || strcmp (scheme, "mailto") == 0)
@@ -626,11 +842,32 @@ file_load_complete (MtxTextView *text_view __attribute__((unused)),
         message = g_strdup_printf (_("%1$s loaded."), p);
         g_free (p);
     }
+#ifdef MTX_DEBUG
+    {
+        guint hits, misses;
+        gsize size;
+
+        /* Images still decoding are counted on the next load. */
+        mtx_text_view_get_image_cache_stats (&hits, &misses, &size);
+        mtx_dbg_errout (1, "\"%s\" image cache: %u hits, %u misses, "
+                        "%" G_GSIZE_FORMAT " bytes\n", file, hits, misses,
+                        size);
+    }
+#endif
 
     /* Set the currently-loaded file. */
     g_free (mvr->current_file);
     mvr->current_file = g_strdup (file);
 
+    if (scheme == NULL)
+    {
+        _watch_start (mvr);
+    }
+    else
+    {
+        _watch_stop (mvr);
+    }
+
     gtk_statusbar_pop (GTK_STATUSBAR (mvr->status_bar), STATUSBAR_CTX_LINK);
     gtk_statusbar_pop (GTK_STATUSBAR (mvr->status_bar), STATUSBAR_CTX_WARN);
     gtk_statusbar_push (GTK_STATUSBAR (mvr->status_bar), STATUSBAR_CTX_MAIN,
@@ -737,294 +974,959 @@ _is_text_and_markdown (const gchar *content_type,
 }
 
 /**
-_build_search_lists:
-
-Build two lists of searchable files in the homepage directory.  Only text files
-are considered. If auto_languages is active, results will prefer File.$LANG.ext
-over File.ext.
-
-@markdown: address of a #GSList pointer that will received the list of markdown
-files in the directory.
-@text: address of a #GSList pointer that will received the list of other text
-files in the directory.
-
-Returns: the total number of elements in the two lists or -1 if case of error.
-List elements can be NULL. *@markdown and @text are NULL if a list is empty.
-The caller owns the returned lists and should free them when done.
+_search_job_new:
 */
-static gint
-_build_search_lists (MtxViewer *mvr,
-                     GSList **markdown,
-                     GSList **text)
+static MtxViewerSearchJob *
+_search_job_new (MtxViewerSearch *search,
+                 const gchar *name,
+                 gchar *name_path,
+                 const struct stat *st,
+                 const MtxSearchIndexKind kind)
 {
-    GDir *dir;
-    const gchar *name;
-    guint counter = 0;
-    g_autofree gchar *abs_dirpath =
-    g_canonicalize_filename (mvr->base_directory, NULL);
+    MtxViewerSearchJob *job = g_new0 (MtxViewerSearchJob, 1);
+
+    job->search = search;
+    job->name = g_strdup (name);
+    job->name_path = name_path;
+    job->st = *st;
+    job->kind = kind;
+    job->stale = kind == MTX_SEARCH_INDEX_KIND_UNKNOWN;
+    return job;
+}
 
-    *markdown = *text = NULL;
-    if ((dir = g_dir_open (abs_dirpath, 0, NULL)) == NULL)
+/**
+_search_job_free:
+*/
+static void
+_search_job_free (MtxViewerSearchJob *job)
+{
+    if (job->path != job->name_path)
     {
-        return -1;
+        g_free (job->path);
     }
-    while ((name = g_dir_read_name (dir)))
+    g_free (job->name_path);
+    g_free (job->name);
+    if (job->trigrams != NULL)
     {
-        gboolean is_text_type = FALSE;
-        gboolean is_text_markdown = FALSE;
-        gchar *path = g_build_filename (abs_dirpath, name, NULL);
-        gchar *content_type = _file_get_content_type (path);
+        g_array_unref (job->trigrams);
+    }
+    g_free (job->item);
+    g_free (job);
+}
 
-        if (content_type == NULL)
-        {
-            g_free (path);
-            continue;
-        }
-        is_text_type =
-        _is_text_and_markdown (content_type, &is_text_markdown);
-        g_free (content_type);
-        if (is_text_type)
-        {
-            GSList **head = is_text_markdown ? markdown : text;
-            gchar *filename = NULL;
-            if (mvr->auto_lang)
-            {
-                filename =
-                mtx_text_view_auto_lang_find (MTX_TEXT_VIEW
-                                              (mvr->text_view), path);
-            }
-            if (filename == NULL)
-            {
-                filename = path;
-            }
-            *head = g_slist_insert (*head, (gpointer) filename, 0);
-            ++counter;
-        }
+/**
+_search_job_cmp:
+Order search results like the page lists them: markdown files first, then
+other text files, each group by pathname.
+*/
+static gint
+_search_job_cmp (gconstpointer a,
+                 gconstpointer b)
+{
+    const MtxViewerSearchJob *x = *(MtxViewerSearchJob **) a;
+    const MtxViewerSearchJob *y = *(MtxViewerSearchJob **) b;
+    const gboolean xm = x->kind == MTX_SEARCH_INDEX_KIND_MARKDOWN;
+    const gboolean ym = y->kind == MTX_SEARCH_INDEX_KIND_MARKDOWN;
+
+    if (xm != ym)
+    {
+        return xm ? -1 : 1;
     }
-    g_dir_close (dir);
-    return counter;
+    return g_strcmp0 (x->path, y->path);
 }
 
 /**
-_file_search:
+_search_unref:
+The last reference frees the search, which can happen in a worker thread.
 */
 static void
-_file_search (gpointer path, gpointer pod)
-{
-    typedef struct
-    {
-        gboolean is_text_markdown;
-        GString *retstr;
-        gchar **terms;
-        guint *ctr;
-        GRegex *regex_astx;
-        GtkEntry *entry;
-    } POD;
-    POD *ppod = (POD *) pod;
-    const gboolean is_text_markdown = ppod->is_text_markdown;
-    GString *retstr    = ppod->retstr;
-    gchar **terms      = ppod->terms;
-    guint *counter     = ppod->ctr;
-    GRegex *regex_astx = ppod->regex_astx;
-    GtkEntry *entry    = ppod->entry;
-    gboolean found = FALSE;
-
-    gtk_entry_progress_pulse (entry);
-    errno = 0;
-    g_autofree gchar *contents = _get_file_contents (path, NULL, TRUE);
-    if (contents == NULL)
-    {
-        if (errno)
-        {
-            fprintf (stderr, PROGNAME ": ");
-            perror (path);
-        }
+_search_unref (MtxViewerSearch *search)
+{
+    if (!g_atomic_int_dec_and_test (&search->ref))
+    {
         return;
     }
-    if (contents[0] == '\0')
+    g_ptr_array_free (search->done, TRUE);
+    g_ptr_array_free (search->results, TRUE);
+    g_mutex_clear (&search->lock);
+    g_hash_table_destroy (search->visited);
+    g_mutex_clear (&search->walk_lock);
+    if (search->candidates != NULL)
+    {
+        g_hash_table_destroy (search->candidates);
+    }
+    g_ptr_array_free (search->exclude, TRUE);
+    g_strfreev (search->languages);
+    g_object_unref (search->cancellable);
+    g_regex_unref (search->regex_astx);
+    mtx_match_free (search->match);
+    g_free (search->text);
+    g_free (search);
+}
+
+/**
+_search_kind_from_extension:
+Classify the files that documentation directories are mostly made of by their
+name, which saves sniffing their content type.
+
+Returns: the kind of @path, MTX_SEARCH_INDEX_KIND_UNKNOWN if the extension isn't
+known.
+*/
+static MtxSearchIndexKind
+_search_kind_from_extension (const gchar *path)
+{
+    const gchar *ext = strrchr (path, '.');
+
+    if (ext == NULL || strchr (ext, G_DIR_SEPARATOR) != NULL)
     {
-        return;
+        return MTX_SEARCH_INDEX_KIND_UNKNOWN;
     }
-#ifdef _GNU_SOURCE
-    for (guint term = 0; !found && terms[term]; term++)
+    ++ext;
+    if (g_ascii_strcasecmp (ext, "md") == 0
+        || g_ascii_strcasecmp (ext, "markdown") == 0)
     {
-        found = strcasestr (contents, terms[term]) != NULL;
+        return MTX_SEARCH_INDEX_KIND_MARKDOWN;
     }
-#else
-    gchar *upper1 = g_utf8_strup (contents, -1);
-    for (guint term = 0; !found && terms[term]; term++)
+    if (g_ascii_strcasecmp (ext, "txt") == 0)
     {
-        gchar *upper2 = g_utf8_strup (terms[term], -1);
-        found = strstr (upper1, upper2) != NULL;
-        g_free (upper2);
+        return MTX_SEARCH_INDEX_KIND_TEXT;
     }
-    g_free (upper1);
-#endif
-    if (found)
+    return MTX_SEARCH_INDEX_KIND_UNKNOWN;
+}
+
+/**
+_search_index_file:
+Classify the file of @job by extension, or else by content type, and compute the
+trigrams to add it to the search index.  Only text files are read.  Runs in a
+worker thread.
+
+Returns: the contents of the file if it is text, otherwise NULL.  Sets
+@job->kind to MTX_SEARCH_INDEX_KIND_UNKNOWN if the content type can't be
+determined.
+*/
+static gchar *
+_search_index_file (MtxViewerSearchJob *job)
+{
+    gchar *contents = NULL;
+
+    job->kind = _search_kind_from_extension (job->name_path);
+    if (job->kind == MTX_SEARCH_INDEX_KIND_UNKNOWN)
     {
-        *counter +=1;
-        /*
-        Extract the page title from the first level-1 setext heading
-        */
-        GString *title = NULL, *dest = NULL;
-        g_autoptr (GMatchInfo) minfo = NULL;
+        gboolean is_text_markdown = FALSE;
+        g_autofree gchar *content_type =
+        _file_get_content_type (job->name_path);
 
-        if (is_text_markdown
-            && g_regex_match (regex_astx, contents, 0, &minfo))
+        if (content_type == NULL)
         {
-            g_autofree gchar *p =
-            g_match_info_fetch_named (minfo, "TITLE");
-            title = g_string_new (p);
+            return NULL;
         }
-
-        /* Sanitize title and destination. */
-        if (title == NULL)
+        job->kind = MTX_SEARCH_INDEX_KIND_OTHER;
+        if (_is_text_and_markdown (content_type, &is_text_markdown))
         {
-            gchar *p;
-            for (p = strchr (path, '\0'); p >= (gchar *) path; p--)
-            {
-                if (G_IS_DIR_SEPARATOR (*p))
-                {
-                    p++;
-                    break;
-                }
-            }
-            title = g_string_new (p);
+            job->kind = is_text_markdown ? MTX_SEARCH_INDEX_KIND_MARKDOWN
+                        : MTX_SEARCH_INDEX_KIND_TEXT;
+        }
+    }
+    if (job->kind == MTX_SEARCH_INDEX_KIND_TEXT
+        || job->kind == MTX_SEARCH_INDEX_KIND_MARKDOWN)
+    {
+        contents = _get_file_contents (job->name_path, NULL, TRUE);
+        if (contents != NULL)
+        {
+            job->trigrams = mtx_search_index_trigrams (contents,
+                                                       strlen (contents));
         }
-        title->str = g_strstrip (g_strdelimit
-                          (title->str, "\\\n\r", ' '));
-        g_string_set_size (title, strlen (title->str));
-        g_string_replace (title, "]", "\\]", -1);
-        dest = g_string_new (path);
-        g_string_replace (dest, ")", "\\)", -1);
-
-        g_string_append_printf (retstr, "* [%s](%s)\n",
-                                title->str, dest->str);
-        g_string_free (title, TRUE);
-        g_string_free (dest, TRUE);
     }
+    return contents;
 }
 
 /**
-do_file_search:
-Load the results of a search URI into a new viewing page.
+_search_match:
+Match @contents of file @path against the search terms of @match in a single
+scan.
 
-Returns: TRUE if the new page was generated otherwise returns FALSE.
-*/
-/*
-Result is a synthetic page.
-We must not call mtx_text_view_load_file!
+Returns: a newly-allocated markdown list item linking to @path if the terms
+match, otherwise NULL.
 */
-static gboolean
-do_file_search (MtxViewer *mvr,
-                const gchar *text)
+static gchar *
+_search_match (const gchar *path,
+               const gchar *contents,
+               const gboolean is_text_markdown,
+               const MtxMatch *match,
+               GRegex *regex_astx)
 {
-    GString *markdown = g_string_new (NULL);
-    gchar *stripped, **terms;
-    gint ctr_subjects, ctr_results = 0;
-    GSList *mkd = NULL, *txt = NULL;
-    GtkEntry *entry = GTK_ENTRY (mvr->text_search);
-    gint argc = 0;
+    gchar *item;
 
-    stripped = g_strstrip (g_strdup (text));
-    if (!g_shell_parse_argv (text, &argc, &terms, NULL))
-    {
-        terms = g_strsplit (stripped, " ", 0);
-        argc = g_strv_length (terms);
-    }
-    g_free (stripped);
-    ctr_subjects = _build_search_lists (mvr, &mkd, &txt);
-    if (ctr_subjects < 0)
+    if (contents[0] == '\0'
+        || !mtx_match_contents (match, contents, strlen (contents)))
     {
-        return FALSE;
+        return NULL;
     }
+    /*
+    Extract the page title from the first level-1 setext heading
+    */
+    GString *title = NULL, *dest = NULL;
+    g_autoptr (GMatchInfo) minfo = NULL;
 
-    gtk_widget_set_sensitive (mvr->window, FALSE);
-    gtk_entry_set_progress_fraction (entry, 1.0f / (ctr_subjects + 1));
-    gtk_entry_progress_pulse (entry);
-
-    mkd = g_slist_sort (mkd, (GCompareFunc) g_strcmp0);
-    txt = g_slist_sort (txt, (GCompareFunc) g_strcmp0);
-
-    typedef struct
+    if (is_text_markdown
+        && g_regex_match (regex_astx, contents, 0, &minfo))
     {
-        gboolean is_text_markdown;
-        GString *retstr;
-        gchar **terms;
-        gint *ctr;
-        GRegex *regex_astx;
-        GtkEntry *entry;
-    } POD;
-    POD pod = { TRUE, markdown, terms, &ctr_results, mvr->regex_astx, entry };
-
-    g_slist_foreach (mkd, (GFunc) _file_search, &pod);
-    g_slist_free_full (mkd, g_free);
-    pod.is_text_markdown = FALSE;
-    g_slist_foreach (txt, (GFunc) _file_search, &pod);
-    g_slist_free_full (txt, g_free);
+        g_autofree gchar *p =
+        g_match_info_fetch_named (minfo, "TITLE");
+        title = g_string_new (p);
+    }
 
-    /* prepend formatted page heading */
+    /* Sanitize title and destination. */
+    if (title == NULL)
     {
-        guint n = 0;
-        for (const gchar *p = text; *p; p++)
+        const gchar *p;
+        for (p = strchr (path, '\0'); p >= path; p--)
         {
-            if (*p == '`') ++n;
+            if (G_IS_DIR_SEPARATOR (*p))
+            {
+                p++;
+                break;
+            }
         }
-        g_autofree gchar *ctr_subjects_str =
-        g_strdup_printf (ngettext
-                         (_("%d document examined"),
-                          _("%d documents examined"), ctr_subjects),
-                         ctr_subjects);
-        g_autofree gchar *codespan = g_strnfill (n + 1, '`');
-        g_autofree gchar *ctr_results_str =
-        g_strdup_printf (ngettext
-                         (_("%d document found"),
-                          _("%d documents found"), ctr_results),
-                         ctr_results);
-        g_autofree gchar *terms_str =
-        g_strdup_printf (ngettext
-                         (Q_ ("search:1=#terms:2=terms:3=```|%1$d search term %3$s %2$s %3$s"),
-                          Q_ ("search:1=#terms:2=terms:3=```|%1$d search terms %3$s %2$s %3$s"),
-                          argc), argc, text, codespan);
-        g_autofree gchar *heading =
-        g_strdup_printf (Q_("search:1=ctr_subjects,2=ctr_results:3=terms|### %1$s, %2$s, %3$s\n# \n"),
-                         ctr_subjects_str, ctr_results_str, terms_str);
-        g_string_prepend (markdown, heading);
-    }
-    /* show the results inside the textview */
-    gboolean retval =
-    mtx_text_view_set_text (MTX_TEXT_VIEW (mvr->text_view),
-                            &markdown->str, NULL, TRUE);
-    g_string_free (markdown, FALSE);
-
-    gtk_entry_set_progress_fraction (entry, 0.0f);
-    gtk_widget_set_sensitive (mvr->window, TRUE);
-    g_strfreev (terms);
-    return retval;
+        title = g_string_new (p);
+    }
+    title->str = g_strstrip (g_strdelimit
+                      (title->str, "\\\n\r", ' '));
+    g_string_set_size (title, strlen (title->str));
+    g_string_replace (title, "]", "\\]", -1);
+    dest = g_string_new (path);
+    g_string_replace (dest, ")", "\\)", -1);
+
+    item = g_strdup_printf ("* [%s](%s)\n", title->str, dest->str);
+    g_string_free (title, TRUE);
+    g_string_free (dest, TRUE);
+    return item;
 }
 
 /**
-do_resource_load:
-Load the results of a resource URI into a new viewing page.
+_search_dir_hash:
+*/
+static guint
+_search_dir_hash (gconstpointer key)
+{
+    const MtxViewerSearchDir *d = key;
+    return (guint) d->ino ^ (guint) d->dev;
+}
 
-@mvr: The #MtxTextView instance.
-@path: A disk file path. NULLABLE
-@uri: An embedded resource file path. NULLABLE
+/**
+_search_dir_equal:
+*/
+static gboolean
+_search_dir_equal (gconstpointer a,
+                   gconstpointer b)
+{
+    const MtxViewerSearchDir *x = a, *y = b;
+    return x->ino == y->ino && x->dev == y->dev;
+}
 
-First @path is looked in $XDG_USER_DATE:$XDG_DATA_DIRS, if that fails
-then the embedded @uri is used.
+/**
+_search_push:
+Queue @job to the thread pool unless the search is cancelled.  Any thread.
 
-Returns: TRUE if the new page was generated otherwise it returns FALSE.
+Returns: TRUE if @job was queued, otherwise @job is freed.
 */
 static gboolean
-do_resource_load (MtxViewer *mvr,
-                  const gchar *path,
-                  const gchar *embed)
+_search_push (MtxViewerSearch *search,
+              MtxViewerSearchJob *job)
 {
-    gboolean retval = FALSE;
+    gboolean queued = FALSE;
 
-    /* Possibly load a disk file. */
-    if (path != NULL)
+    g_mutex_lock (&search->walk_lock);
+    if (!g_cancellable_is_cancelled (search->cancellable))
+    {
+        g_atomic_int_inc (&search->ref);
+        g_atomic_int_inc (&search->pending);
+        if (!job->is_directory)
+        {
+            g_atomic_int_inc (&search->n_queued);
+        }
+        g_thread_pool_push (search->pool, job, NULL);
+        queued = TRUE;
+    }
+    g_mutex_unlock (&search->walk_lock);
+    if (!queued)
+    {
+        _search_job_free (job);
+    }
+    return queued;
+}
+
+/**
+_search_excluded:
+Return: TRUE if the directory entry @name, at directory-relative path @rel,
+matches an exclusion glob.
+*/
+static gboolean
+_search_excluded (MtxViewerSearch *search,
+                  const gchar *name,
+                  const gchar *rel)
+{
+    for (guint i = 0; i < search->exclude->len; i++)
+    {
+        GPatternSpec *spec = g_ptr_array_index (search->exclude, i);
+
+        if (g_pattern_match_string (spec, name)
+            || g_pattern_match_string (spec, rel))
+        {
+            return TRUE;
+        }
+    }
+    return FALSE;
+}
+
+/**
+_search_visit:
+Return: TRUE the first time the directory of @st is seen, FALSE when a symbolic
+link leads back to a directory that was already walked.
+*/
+static gboolean
+_search_visit (MtxViewerSearch *search,
+               const struct stat *st)
+{
+    MtxViewerSearchDir *d = g_new (MtxViewerSearchDir, 1);
+    gboolean first;
+
+    d->dev = st->st_dev;
+    d->ino = st->st_ino;
+    g_mutex_lock (&search->walk_lock);
+    first = g_hash_table_add (search->visited, d);
+    g_mutex_unlock (&search->walk_lock);
+    return first;
+}
+
+/**
+_search_walk:
+Queue a job for each searchable file of the directory of @dir_job, and a
+directory job for each subdirectory within the depth limit.  Only text files
+are considered. If auto_languages is active, results will prefer
+File.$LANG.ext over File.ext.
+
+The search index remembers the kind of each file, so only new and modified
+files are classified by content type, and indexed, by the file jobs.
+Up-to-date files that can't contain any term are ruled out here.
+*/
+static void
+_search_walk (MtxViewerSearchJob *dir_job)
+{
+    MtxViewerSearch *search = dir_job->search;
+    GDir *dir;
+    const gchar *name;
+    GPtrArray *files;           /* (MtxViewerSearchJob *) */
+    GHashTable *siblings;       /* names of @files */
+
+    if ((dir = g_dir_open (dir_job->name_path, 0, NULL)) == NULL)
+    {
+        return;
+    }
+    /* Stat all the entries first, so the language-specific replacements of
+    auto_languages are looked up among them rather than in the file system. */
+    files = g_ptr_array_new ();
+    siblings = g_hash_table_new_full (g_str_hash, g_str_equal, g_free, NULL);
+    while ((name = g_dir_read_name (dir))
+           && !g_cancellable_is_cancelled (search->cancellable))
+    {
+        MtxViewerSearchJob *job;
+        struct stat st;
+        gchar *rel = dir_job->name == NULL ? g_strdup (name)
+                     : g_build_filename (dir_job->name, name, NULL);
+        gchar *path;
+
+        if (_search_excluded (search, name, rel))
+        {
+            g_free (rel);
+            continue;
+        }
+        path = g_build_filename (dir_job->name_path, name, NULL);
+        if (stat (path, &st) != 0)
+        {
+            g_free (path);
+            g_free (rel);
+            continue;
+        }
+        if (S_ISDIR (st.st_mode))
+        {
+            if (dir_job->depth < search->depth && _search_visit (search, &st))
+            {
+                job = _search_job_new (search, rel, path, &st,
+                                       MTX_SEARCH_INDEX_KIND_OTHER);
+                job->is_directory = TRUE;
+                job->depth = dir_job->depth + 1;
+                (void) _search_push (search, job);
+            }
+            else
+            {
+                g_free (path);
+            }
+        }
+        else if (S_ISREG (st.st_mode))
+        {
+            g_ptr_array_add (files,
+                             _search_job_new (search, rel, path, &st,
+                                              MTX_SEARCH_INDEX_KIND_OTHER));
+            g_hash_table_add (siblings, g_strdup (name));
+        }
+        else
+        {
+            g_free (path);
+        }
+        g_free (rel);
+    }
+    g_dir_close (dir);
+
+    for (guint i = 0; i < files->len; i++)
+    {
+        MtxViewerSearchJob *job = g_ptr_array_index (files, i);
+        MtxSearchIndexKind kind = MTX_SEARCH_INDEX_KIND_OTHER;
+
+        g_mutex_lock (&search->walk_lock);
+        if (!g_cancellable_is_cancelled (search->cancellable))
+        {
+            kind = mtx_search_index_lookup (search->index, job->name,
+                                            &job->st);
+        }
+        g_mutex_unlock (&search->walk_lock);
+        if (kind == MTX_SEARCH_INDEX_KIND_OTHER)
+        {
+            _search_job_free (job);
+            continue;
+        }
+        job->kind = kind;
+        job->stale = kind == MTX_SEARCH_INDEX_KIND_UNKNOWN;
+        if (search->languages != NULL)
+        {
+            job->path = mtx_text_view_auto_lang_find_in
+                ((const gchar *const *) search->languages, job->name_path,
+                 siblings);
+        }
+        if (job->path == NULL)
+        {
+            job->path = job->name_path;
+        }
+        if (!job->stale)
+        {
+            g_atomic_int_inc (&search->ctr_subjects);
+        }
+        /* The search index rules out the files that can't contain any term. */
+        if (search->candidates != NULL && !job->stale
+            && job->path == job->name_path
+            && !g_hash_table_contains (search->candidates, job->name))
+        {
+            _search_job_free (job);
+            continue;
+        }
+        (void) _search_push (search, job);
+    }
+    g_hash_table_destroy (siblings);
+    g_ptr_array_free (files, TRUE);
+}
+
+/**
+_search_job_run:
+Thread pool function: walk the directory of @data, or index the file of @data if
+it is stale, then read the file to search and match it.  The finished file job
+goes back to the main loop through the search's done list.
+*/
+static void
+_search_job_run (gpointer data,
+                 gpointer user_data __attribute__((unused)))
+{
+    MtxViewerSearchJob *job = (MtxViewerSearchJob *) data;
+    MtxViewerSearch *search = job->search;
+
+    if (job->is_directory)
+    {
+        if (!g_cancellable_is_cancelled (search->cancellable))
+        {
+            _search_walk (job);
+        }
+        _search_job_free (job);
+        g_atomic_int_add (&search->pending, -1);
+        _search_unref (search);
+        return;
+    }
+    if (!g_cancellable_is_cancelled (search->cancellable))
+    {
+        g_autofree gchar *contents = NULL;
+
+        if (job->stale)
+        {
+            contents = _search_index_file (job);
+        }
+        if (job->kind == MTX_SEARCH_INDEX_KIND_TEXT
+            || job->kind == MTX_SEARCH_INDEX_KIND_MARKDOWN)
+        {
+            if (contents == NULL || job->path != job->name_path)
+            {
+                g_free (contents);
+                errno = 0;
+                contents = _get_file_contents (job->path, NULL, TRUE);
+                if (contents == NULL && errno)
+                {
+                    fprintf (stderr, PROGNAME ": ");
+                    perror (job->path);
+                }
+            }
+            if (contents != NULL)
+            {
+                job->item =
+                _search_match (job->path, contents,
+                               job->kind == MTX_SEARCH_INDEX_KIND_MARKDOWN,
+                               search->match, search->regex_astx);
+            }
+        }
+    }
+    g_mutex_lock (&search->lock);
+    g_ptr_array_add (search->done, job);
+    g_mutex_unlock (&search->lock);
+    g_atomic_int_add (&search->pending, -1);
+    _search_unref (search);
+}
+
+/**
+_search_drain:
+Take the jobs that the workers finished: add the files they indexed to the
+search index, and collect the results.
+
+Returns: TRUE if the page needs to be rendered again.
+*/
+static gboolean
+_search_drain (MtxViewer *mvr,
+               MtxViewerSearch *search)
+{
+    GPtrArray *done;
+    gboolean changed = FALSE;
+
+    g_mutex_lock (&search->lock);
+    done = search->done;
+    search->done = g_ptr_array_new_with_free_func ((GDestroyNotify)
+                                                   _search_job_free);
+    g_mutex_unlock (&search->lock);
+
+    g_ptr_array_set_free_func (done, NULL);
+    g_mutex_lock (&search->walk_lock);
+    for (guint i = 0; i < done->len; i++)
+    {
+        MtxViewerSearchJob *job = g_ptr_array_index (done, i);
+
+        if (job->stale && job->kind != MTX_SEARCH_INDEX_KIND_UNKNOWN)
+        {
+            mtx_search_index_add (mvr->search_index, job->name, &job->st,
+                                  job->kind, job->trigrams);
+            if (job->kind != MTX_SEARCH_INDEX_KIND_OTHER)
+            {
+                g_atomic_int_inc (&search->ctr_subjects);
+                changed = TRUE;
+            }
+        }
+        if (job->item != NULL)
+        {
+            g_ptr_array_add (search->results, job);
+            changed = TRUE;
+        }
+        else
+        {
+            _search_job_free (job);
+        }
+    }
+    g_mutex_unlock (&search->walk_lock);
+    search->n_drained += done->len;
+    g_ptr_array_free (done, TRUE);
+    return changed;
+}
+
+/**
+_search_render:
+Show the results found so far, sorted, inside the text view.
+
+@note: a paragraph to append to the results, NULLABLE.
+
+Returns: FALSE on parsing error otherwise returns TRUE.
+*/
+static gboolean
+_search_render (MtxViewer *mvr,
+                MtxViewerSearch *search,
+                const gchar *note)
+{
+    GString *markdown = g_string_new (NULL);
+    const gint ctr_subjects = g_atomic_int_get (&search->ctr_subjects);
+    const gint ctr_results = search->results->len;
+    const gint argc = search->argc;
+    const gchar *text = search->text;
+    gboolean retval;
+
+    /* formatted page heading */
+    {
+        guint n = 0;
+        for (const gchar *p = text; *p; p++)
+        {
+            if (*p == '`') ++n;
+        }
+        g_autofree gchar *ctr_subjects_str =
+        g_strdup_printf (ngettext
+                         (_("%d document examined"),
+                          _("%d documents examined"), ctr_subjects),
+                         ctr_subjects);
+        g_autofree gchar *codespan = g_strnfill (n + 1, '`');
+        g_autofree gchar *ctr_results_str =
+        g_strdup_printf (ngettext
+                         (_("%d document found"),
+                          _("%d documents found"), ctr_results),
+                         ctr_results);
+        g_autofree gchar *terms_str =
+        g_strdup_printf (ngettext
+                         (Q_ ("search:1=#terms:2=terms:3=```|%1$d search term %3$s %2$s %3$s"),
+                          Q_ ("search:1=#terms:2=terms:3=```|%1$d search terms %3$s %2$s %3$s"),
+                          argc), argc, text, codespan);
+        g_autofree gchar *heading =
+        g_strdup_printf (Q_("search:1=ctr_subjects,2=ctr_results:3=terms|### %1$s, %2$s, %3$s\n# \n"),
+                         ctr_subjects_str, ctr_results_str, terms_str);
+        g_string_append (markdown, heading);
+    }
+    if (mtx_match_get_n_ignored (search->match) > 0)
+    {
+        const guint n = mtx_match_get_n_ignored (search->match);
+        g_string_append_printf (markdown,
+                                ngettext (_("%1$u search term ignored: only "
+                                            "the first %2$d are used.\n\n"),
+                                          _("%1$u search terms ignored: only "
+                                            "the first %2$d are used.\n\n"),
+                                          n), n, MTX_MATCH_MAX_TERMS);
+    }
+    g_ptr_array_sort (search->results, _search_job_cmp);
+    for (guint i = 0; i < search->results->len; i++)
+    {
+        MtxViewerSearchJob *job = g_ptr_array_index (search->results, i);
+        g_string_append (markdown, job->item);
+    }
+    search->n_shown = search->results->len;
+    if (note != NULL)
+    {
+        g_string_append_printf (markdown, "\n%s\n", note);
+    }
+    /* show the results inside the textview */
+    retval = mtx_text_view_set_text (MTX_TEXT_VIEW (mvr->text_view),
+                                     &markdown->str, NULL, TRUE);
+    g_string_free (markdown, FALSE);
+    return retval;
+}
+
+/**
+_search_append:
+Append the results found since the page was last rendered to the text view,
+in the order they were found.  Converting and inserting only the new results
+keeps each batch cheap however many results the page holds; the page is sorted
+when the search ends, see _search_render.
+
+Returns: FALSE on parsing error otherwise returns TRUE.
+*/
+static gboolean
+_search_append (MtxViewer *mvr,
+                MtxViewerSearch *search)
+{
+    GString *markdown = g_string_new (NULL);
+    gboolean retval;
+
+    for (guint i = search->n_shown; i < search->results->len; i++)
+    {
+        MtxViewerSearchJob *job = g_ptr_array_index (search->results, i);
+        g_string_append (markdown, job->item);
+    }
+    search->n_shown = search->results->len;
+    if (markdown->len == 0)
+    {
+        g_string_free (markdown, TRUE);
+        return TRUE;
+    }
+    retval = mtx_text_view_append_text (MTX_TEXT_VIEW (mvr->text_view),
+                                        &markdown->str, TRUE);
+    g_string_free (markdown, FALSE);
+    return retval;
+}
+
+/**
+_search_status:
+Show the counts of the search in progress in the status bar.
+*/
+static void
+_search_status (MtxViewer *mvr,
+                MtxViewerSearch *search)
+{
+    const gint ctr_subjects = g_atomic_int_get (&search->ctr_subjects);
+    const gint ctr_results = search->results->len;
+    g_autofree gchar *ctr_subjects_str =
+    g_strdup_printf (ngettext
+                     (_("%d document examined"),
+                      _("%d documents examined"), ctr_subjects),
+                     ctr_subjects);
+    g_autofree gchar *ctr_results_str =
+    g_strdup_printf (ngettext
+                     (_("%d document found"),
+                      _("%d documents found"), ctr_results),
+                     ctr_results);
+    g_autofree gchar *message =
+    g_strdup_printf ("%s %s, %s", _("Searching..."), ctr_subjects_str,
+                     ctr_results_str);
+
+    gtk_statusbar_pop (GTK_STATUSBAR (mvr->status_bar), STATUSBAR_CTX_SEARCH);
+    gtk_statusbar_push (GTK_STATUSBAR (mvr->status_bar), STATUSBAR_CTX_SEARCH,
+                        message);
+}
+
+/**
+_search_entry_tooltip:
+*/
+static const gchar *
+_search_entry_tooltip (const gboolean busy)
+{
+    return busy ? _("(Esc) Stop searching")
+           : _("(Alt-S) Set focus on the search field"
+               " to enter terms\n(Enter) Search"
+               " through all documents");
+}
+
+/**
+_search_entry_set_busy:
+Turn the primary icon of the search entry into a stop button while a directory
+search is in progress.
+*/
+static void
+_search_entry_set_busy (MtxViewer *mvr,
+                        const gboolean busy)
+{
+    GtkEntry *entry = GTK_ENTRY (mvr->text_search);
+
+#if !GTK_CHECK_VERSION(3,0,0)
+    gtk_entry_set_icon_from_stock (entry, GTK_ENTRY_ICON_PRIMARY,
+                                   busy ? GTK_STOCK_STOP : GTK_STOCK_INDEX);
+#else
+    gtk_entry_set_icon_from_icon_name (entry, GTK_ENTRY_ICON_PRIMARY,
+                                       busy ? "process-stop" : "gtk-index");
+#endif
+    gtk_entry_set_icon_tooltip_text (entry, GTK_ENTRY_ICON_PRIMARY,
+                                     _search_entry_tooltip (busy));
+    if (!busy)
+    {
+        gtk_entry_set_progress_fraction (entry, 0.0f);
+    }
+}
+
+/**
+_search_end:
+Release the search in progress, and save the search index.  The search must be
+complete, or cancelled.
+*/
+static void
+_search_end (MtxViewer *mvr)
+{
+    MtxViewerSearch *search = mvr->search;
+
+    if (search->timeout_id)
+    {
+        g_source_remove (search->timeout_id);
+    }
+    mvr->search = NULL;
+    _search_unref (search);
+    (void) mtx_search_index_save (mvr->search_index);
+    _search_entry_set_busy (mvr, FALSE);
+    gtk_statusbar_pop (GTK_STATUSBAR (mvr->status_bar), STATUSBAR_CTX_SEARCH);
+}
+
+/**
+_search_flush:
+Main loop timeout: append the batch of results that the workers finished since
+the last call to the results page.  The complete page is rendered once, sorted,
+when the search ends.
+*/
+static gboolean
+_search_flush (gpointer data)
+{
+    MtxViewer *mvr = (MtxViewer *) data;
+    MtxViewerSearch *search = mvr->search;
+    /* Read before draining: the last job is done before it stops pending. */
+    const gboolean complete = g_atomic_int_get (&search->pending) == 0;
+    const gboolean changed = _search_drain (mvr, search);
+
+    if (complete)
+    {
+        search->timeout_id = 0;
+        (void) _search_render (mvr, search, NULL);
+        /* Only a complete walk has seen all the files the index should keep. */
+        mtx_search_index_prune (mvr->search_index);
+        _search_end (mvr);
+        return G_SOURCE_REMOVE;
+    }
+    if (g_atomic_int_get (&search->n_queued) > 0)
+    {
+        gtk_entry_set_progress_fraction (GTK_ENTRY (mvr->text_search),
+                                         (gdouble) search->n_drained
+                                         / g_atomic_int_get
+                                         (&search->n_queued));
+    }
+    if (changed)
+    {
+        (void) _search_append (mvr, search);
+        _search_status (mvr, search);
+    }
+    return G_SOURCE_CONTINUE;
+}
+
+/**
+_search_cancel:
+Stop the directory search in progress, if any.  Jobs still in the thread pool
+queue are dropped as soon as a worker takes them.  Once this function returns no
+walker touches the search index or the thread pool any longer.
+
+@show: if TRUE show the results found so far, otherwise leave the text view
+alone because another page is about to replace the results page.
+*/
+static void
+_search_cancel (MtxViewer *mvr,
+                const gboolean show)
+{
+    MtxViewerSearch *search = mvr->search;
+
+    if (search == NULL)
+    {
+        return;
+    }
+    g_cancellable_cancel (search->cancellable);
+    /* Wait for a walker that is looking up the index or pushing a job. */
+    g_mutex_lock (&search->walk_lock);
+    g_mutex_unlock (&search->walk_lock);
+    (void) _search_drain (mvr, search);
+    if (show)
+    {
+        (void) _search_render (mvr, search, _("Search canceled."));
+    }
+    _search_end (mvr);
+}
+
+/**
+do_file_search:
+Load the results of a search URI into a new viewing page.
+
+The directory tree is walked, and the files are read and matched, by a thread
+pool, see _search_walk; the results are appended to the page as they arrive,
+until the search completes or _search_cancel stops it.
+
+Returns: TRUE if the new page was generated otherwise returns FALSE.
+*/
+/*
+Result is a synthetic page.
+We must not call mtx_text_view_load_file!
+*/
+static gboolean
+do_file_search (MtxViewer *mvr,
+                const gchar *text)
+{
+    MtxViewerSearch *search;
+    MtxViewerSearchJob *top;
+    gchar *stripped, **terms;
+    struct stat st;
+
+    search = g_new0 (MtxViewerSearch, 1);
+    search->ref = 1;
+    search->cancellable = g_cancellable_new ();
+    search->text = g_strdup (text);
+    search->regex_astx = g_regex_ref (mvr->regex_astx);
+    search->results =
+    g_ptr_array_new_with_free_func ((GDestroyNotify) _search_job_free);
+    search->done =
+    g_ptr_array_new_with_free_func ((GDestroyNotify) _search_job_free);
+    g_mutex_init (&search->lock);
+    g_mutex_init (&search->walk_lock);
+    search->visited = g_hash_table_new_full (_search_dir_hash,
+                                             _search_dir_equal, g_free, NULL);
+    search->depth = mvr->search_depth;
+    search->exclude =
+    g_ptr_array_new_with_free_func ((GDestroyNotify) g_pattern_spec_free);
+    for (gchar **p = mvr->search_exclude; p && *p; p++)
+    {
+        g_ptr_array_add (search->exclude, g_pattern_spec_new (*p));
+    }
+    if (mvr->auto_lang)
+    {
+        /* A copy, so the walkers never touch the widget. */
+        search->languages =
+        g_strdupv (MTX_TEXT_VIEW (mvr->text_view)->auto_languages);
+    }
+
+    stripped = g_strstrip (g_strdup (text));
+    if (!g_shell_parse_argv (text, &search->argc, &terms, NULL))
+    {
+        terms = g_strsplit (stripped, " ", 0);
+        search->argc = g_strv_length (terms);
+    }
+    g_free (stripped);
+    search->match = mtx_match_new (terms);
+    g_strfreev (terms);
+    if (mvr->search_index == NULL)
+    {
+        g_autofree gchar *abs_dirpath =
+        g_canonicalize_filename (mvr->base_directory, NULL);
+        mvr->search_index = mtx_search_index_open (abs_dirpath);
+    }
+    if (mvr->search_pool == NULL)
+    {
+        mvr->search_pool = g_thread_pool_new (_search_job_run, NULL,
+                                              g_get_num_processors (),
+                                              FALSE, NULL);
+    }
+    search->index = mvr->search_index;
+    search->pool = mvr->search_pool;
+    if (stat (mtx_search_index_get_directory (search->index), &st) != 0
+        || !S_ISDIR (st.st_mode))
+    {
+        _search_unref (search);
+        return FALSE;
+    }
+    (void) _search_visit (search, &st);
+    top = _search_job_new (search, NULL,
+                           g_strdup (mtx_search_index_get_directory
+                                     (search->index)),
+                           &st, MTX_SEARCH_INDEX_KIND_OTHER);
+    top->is_directory = TRUE;
+
+    /* The walkers only read the candidates. */
+    search->candidates =
+    mtx_search_index_query (search->index,
+                            mtx_match_get_patterns (search->match));
+    mtx_search_index_begin (search->index);
+    mvr->search = search;
+    (void) _search_push (search, top);
+    _search_entry_set_busy (mvr, TRUE);
+    search->timeout_id = g_timeout_add (MTX_VIEWER_SEARCH_BATCH_MS,
+                                        _search_flush, mvr);
+    return _search_render (mvr, search, _("Searching..."));
+}
+
+/**
+do_resource_load:
+Load the results of a resource URI into a new viewing page.
+
+@mvr: The #MtxTextView instance.
+@path: A disk file path. NULLABLE
+@uri: An embedded resource file path. NULLABLE
+
+First @path is looked in $XDG_USER_DATE:$XDG_DATA_DIRS, if that fails
+then the embedded @uri is used.
+
+Returns: TRUE if the new page was generated otherwise it returns FALSE.
+*/
+static gboolean
+do_resource_load (MtxViewer *mvr,
+                  const gchar *path,
+                  const gchar *embed)
+{
+    gboolean retval = FALSE;
+
+    /* Possibly load a disk file. */
+    if (path != NULL)
     {
         g_autofree gchar *file = NULL;
         g_autofree gchar *contents = NULL;
@@ -1152,7 +2054,16 @@ search_entry_icon_press (GtkEntry *entry,
 {
     if (position == GTK_ENTRY_ICON_PRIMARY)
     {
-        search_entry_activate (entry, data);
+        MtxViewer *mvr = (MtxViewer *) data;
+
+        if (mvr->search != NULL)
+        {
+            _search_cancel (mvr, TRUE);
+        }
+        else
+        {
+            search_entry_activate (entry, data);
+        }
     }
     else
     {
@@ -1236,13 +2147,10 @@ nav_home_clicked (GtkWidget *button __attribute__((unused)),
 {
     MtxViewer *mvr = (MtxViewer *) data;
     gchar *homepage = mvr->homepage == NULL ? DEFAULT_INDEX : mvr->homepage;
-    const guint offset = mvr->changed_curpos;
 
-    if (dispatch_to_page (mvr, homepage))
-    {
-        _nav_trail_fore_clear (mvr);
-        _nav_trail_insert (mvr, homepage, offset);
-    }
+    dispatch_to_page_async (mvr, homepage,
+                            mvr->current_file ? mvr->current_file : "",
+                            MTX_VIEWER_NAV_HOME, mvr->changed_curpos);
 }
 
 /**
@@ -1365,6 +2273,293 @@ accel_edit_current (GtkAccelGroup *group __attribute__((unused)),
     return TRUE;
 }
 
+/****************
+*  WATCH MODE  *
+****************/
+
+/**
+_watch_restore_scroll:
+Scroll back to where the page was before it was reloaded.
+*/
+static void
+_watch_restore_scroll (MtxViewer *mvr)
+{
+    GtkAdjustment *vadj =
+    gtk_scrolled_window_get_vadjustment (GTK_SCROLLED_WINDOW
+                                         (gtk_widget_get_parent
+                                          (mvr->text_view)));
+    gtk_adjustment_set_value (vadj, mvr->watch_scroll);
+}
+
+/**
+idle_restore_scroll:
+GSourceFunc: restore the scroll again after the text view has validated the
+layout of the new text.
+*/
+static gboolean
+idle_restore_scroll (gpointer data)
+{
+    MtxViewer *mvr = (MtxViewer *) data;
+
+    mvr->watch_scroll_id = 0;
+    _watch_restore_scroll (mvr);
+    return G_SOURCE_REMOVE;
+}
+
+/**
+watch_reload_ready:
+GAsyncReadyCallback of the page reload.  Keeps the navigation trail as it is.
+*/
+static void
+watch_reload_ready (GObject *source,
+                    GAsyncResult *result,
+                    gpointer data)
+{
+    MtxViewer *mvr = (MtxViewer *) data;
+    GError *error = NULL;
+
+    if (!mtx_text_view_reload_finish (MTX_TEXT_VIEW (source), result, &error))
+    {
+        /* A cancelled reload was superseded; leave mvr alone. */
+        if (!g_error_matches (error, G_IO_ERROR, G_IO_ERROR_CANCELLED))
+        {
+            g_clear_object (&mvr->watch_cancellable);
+            gtk_statusbar_push (GTK_STATUSBAR (mvr->status_bar),
+                                STATUSBAR_CTX_WARN, error->message);
+        }
+        g_error_free (error);
+        return;
+    }
+    g_clear_object (&mvr->watch_cancellable);
+
+    _watch_restore_scroll (mvr);
+    if (mvr->watch_scroll_id != 0)
+    {
+        g_source_remove (mvr->watch_scroll_id);
+    }
+    mvr->watch_scroll_id =
+    g_idle_add_full (G_PRIORITY_LOW, idle_restore_scroll, mvr, NULL);
+
+    {
+        g_autofree gchar *p = g_path_get_basename (mvr->current_file);
+        g_autofree gchar *message = g_strdup_printf (_("%1$s reloaded."), p);
+        gtk_statusbar_pop (GTK_STATUSBAR (mvr->status_bar),
+                           STATUSBAR_CTX_WARN);
+        gtk_statusbar_push (GTK_STATUSBAR (mvr->status_bar),
+                            STATUSBAR_CTX_MAIN, message);
+    }
+
+    /* The page may reference different images now. */
+    _watch_start (mvr);
+}
+
+/**
+watch_timeout:
+The debounce window closed: reload the page in the background.
+*/
+static gboolean
+watch_timeout (gpointer data)
+{
+    MtxViewer *mvr = (MtxViewer *) data;
+    GtkAdjustment *vadj =
+    gtk_scrolled_window_get_vadjustment (GTK_SCROLLED_WINDOW
+                                         (gtk_widget_get_parent
+                                          (mvr->text_view)));
+
+    mvr->watch_timeout_id = 0;
+    if (mvr->watch_cancellable != NULL)
+    {
+        g_cancellable_cancel (mvr->watch_cancellable);
+        g_object_unref (mvr->watch_cancellable);
+    }
+    mvr->watch_cancellable = g_cancellable_new ();
+    mvr->watch_scroll = gtk_adjustment_get_value (vadj);
+    mtx_text_view_reload_async (MTX_TEXT_VIEW (mvr->text_view),
+                                mvr->watch_images_changed,
+                                mvr->watch_cancellable, watch_reload_ready,
+                                mvr);
+    mvr->watch_images_changed = FALSE;
+    return G_SOURCE_REMOVE;
+}
+
+/**
+on_watch_changed:
+GFileMonitor "changed" callback.  Restart the debounce window.
+*/
+static void
+on_watch_changed (GFileMonitor *monitor,
+                  GFile *file __attribute__((unused)),
+                  GFile *other_file __attribute__((unused)),
+                  GFileMonitorEvent event,
+                  gpointer data)
+{
+    MtxViewer *mvr = (MtxViewer *) data;
+
+    switch (event)
+    {
+        case G_FILE_MONITOR_EVENT_ATTRIBUTE_CHANGED:
+        case G_FILE_MONITOR_EVENT_PRE_UNMOUNT:
+        case G_FILE_MONITOR_EVENT_UNMOUNTED:
+            return;
+        default:
+            break;
+    }
+    /* The page file is always the first monitor. */
+    if (monitor != g_ptr_array_index (mvr->watch_monitors, 0))
+    {
+        mvr->watch_images_changed = TRUE;
+    }
+    if (mvr->watch_timeout_id != 0)
+    {
+        g_source_remove (mvr->watch_timeout_id);
+    }
+    mvr->watch_timeout_id =
+    g_timeout_add (MTX_VIEWER_WATCH_DEBOUNCE, watch_timeout, mvr);
+}
+
+/**
+_watch_add:
+*/
+static void
+_watch_add (MtxViewer *mvr,
+            const gchar *path)
+{
+    GFile *file = g_file_new_for_path (path);
+    GFileMonitor *monitor =
+    g_file_monitor_file (file, G_FILE_MONITOR_NONE, NULL, NULL);
+
+    if (monitor != NULL)
+    {
+        g_signal_connect (monitor, "changed", G_CALLBACK (on_watch_changed),
+                          mvr);
+        g_ptr_array_add (mvr->watch_monitors, monitor);
+    }
+    g_object_unref (file);
+}
+
+/**
+_watch_monitor_free:
+*/
+static void
+_watch_monitor_free (gpointer monitor)
+{
+    g_signal_handlers_disconnect_matched (monitor, G_SIGNAL_MATCH_FUNC, 0, 0,
+                                          NULL, on_watch_changed, NULL);
+    g_file_monitor_cancel (G_FILE_MONITOR (monitor));
+    g_object_unref (monitor);
+}
+
+/**
+_watch_stop:
+Stop watching files and abandon any pending reload or scroll restore.
+*/
+static void
+_watch_stop (MtxViewer *mvr)
+{
+    g_ptr_array_set_size (mvr->watch_monitors, 0);
+    if (mvr->watch_timeout_id != 0)
+    {
+        g_source_remove (mvr->watch_timeout_id);
+        mvr->watch_timeout_id = 0;
+    }
+    if (mvr->watch_scroll_id != 0)
+    {
+        g_source_remove (mvr->watch_scroll_id);
+        mvr->watch_scroll_id = 0;
+    }
+    if (mvr->watch_cancellable != NULL)
+    {
+        g_cancellable_cancel (mvr->watch_cancellable);
+        g_clear_object (&mvr->watch_cancellable);
+    }
+    mvr->watch_images_changed = FALSE;
+}
+
+/**
+_watch_start:
+Watch the file of the current page and the images it displays.
+*/
+static void
+_watch_start (MtxViewer *mvr)
+{
+    MtxTextView *tv = MTX_TEXT_VIEW (mvr->text_view);
+    const gchar *file;
+    gchar *alt = NULL;
+    GList *images, *p;
+
+    g_ptr_array_set_size (mvr->watch_monitors, 0);
+    if (!mvr->watch || (file = mtx_text_view_get_file (tv)) == NULL)
+    {
+        return;
+    }
+    if (mvr->auto_lang)
+    {
+        alt = mtx_text_view_auto_lang_find (tv, file);
+    }
+    _watch_add (mvr, alt ? alt : file);
+    g_free (alt);
+    if (mvr->watch_monitors->len == 0)
+    {
+        return;
+    }
+    images = mtx_text_view_get_image_files (tv);
+    for (p = images; p != NULL; p = p->next)
+    {
+        _watch_add (mvr, p->data);
+    }
+    g_list_free (images);
+}
+
+/**
+mtx_viewer_set_watch:
+Enable or disable watch mode: when the file of the current page or any of its
+images change, reload the page and keep its scroll position.
+
+@mvr: pointer to #MtxViewer.
+@enable:
+*/
+void
+mtx_viewer_set_watch (MtxViewer *mvr,
+                      gboolean enable)
+{
+    mvr->watch = enable;
+    if (enable && mvr->current_file != NULL
+        && g_uri_peek_scheme (mvr->current_file) == NULL)
+    {
+        _watch_start (mvr);
+    }
+    else
+    {
+        _watch_stop (mvr);
+    }
+}
+
+/**
+mtx_viewer_set_search_scope:
+Set which files of the home page directory tree the directory search reads.
+The scope applies from the next search.
+
+@mvr: pointer to #MtxViewer.
+@depth: the number of subdirectory levels to descend, 0 for the home page
+directory only.
+@exclude: NULL-terminated array of glob patterns of the files and directories to
+skip, matched against both the file name and the directory-relative path.
+NULLABLE for MTX_VIEWER_SEARCH_EXCLUDE.
+*/
+void
+mtx_viewer_set_search_scope (MtxViewer *mvr,
+                             guint depth,
+                             const gchar * const *exclude)
+{
+    static const gchar * const default_exclude[] =
+    { MTX_VIEWER_SEARCH_EXCLUDE, NULL };
+
+    mvr->search_depth = depth;
+    g_clear_pointer (&mvr->search_exclude, g_strfreev);
+    mvr->search_exclude =
+    g_strdupv ((gchar **) (exclude != NULL ? exclude : default_exclude));
+}
+
 /**
 mtx_viewer_present_page:
 Present a file or supported URI.
@@ -1417,6 +2612,13 @@ mtx_viewer_destroy:
 void
 mtx_viewer_destroy (MtxViewer *mvr)
 {
+    _page_load_cancel (mvr);
+    if (mvr->watch_monitors != NULL)
+    {
+        _watch_stop (mvr);
+        g_ptr_array_free (mvr->watch_monitors, TRUE);
+        mvr->watch_monitors = NULL;
+    }
     if (mvr->nav_trail != NULL)
     {
         g_queue_foreach (mvr->nav_trail, (GFunc) _nav_unit_clear, mvr);
@@ -1427,6 +2629,14 @@ mtx_viewer_destroy (MtxViewer *mvr)
 
     g_free (mvr->current_file);
     g_free (mvr->base_directory);
+    if (mvr->search_pool != NULL)
+    {
+        /* Queued jobs of the cancelled search still run, but do nothing. */
+        g_thread_pool_free (mvr->search_pool, FALSE, FALSE);
+        mvr->search_pool = NULL;
+    }
+    mtx_search_index_free (mvr->search_index);
+    g_clear_pointer (&mvr->search_exclude, g_strfreev);
     g_free ((gpointer) mvr->data_dirs);
     if (mvr->regex_astx != NULL)
     {
@@ -1460,6 +2670,11 @@ viewer_key_pressed (GtkWidget *widget,
     switch (event->keyval)
     {
         case GDK_KEY_Escape:
+            if (mvr->search != NULL)
+            {
+                _search_cancel (mvr, TRUE);
+                return TRUE;
+            }
             mtx_viewer_destroy (mvr);
             gtk_widget_destroy (widget);
             return TRUE;
@@ -1604,9 +2819,7 @@ mtx_viewer_new (const gchar *base_dir,
 #endif
     gtk_entry_set_icon_tooltip_text (GTK_ENTRY (search_entry),
                                      GTK_ENTRY_ICON_PRIMARY,
-                                     _("(Alt-S) Set focus on the search field"
-                                       " to enter terms\n(Enter) Search"
-                                       " through all documents"));
+                                     _search_entry_tooltip (FALSE));
     gtk_entry_set_icon_tooltip_text (GTK_ENTRY (search_entry),
                                      GTK_ENTRY_ICON_SECONDARY,
                                      _("(Ctrl-F) Search forward in this page "
@@ -1649,6 +2862,8 @@ mtx_viewer_new (const gchar *base_dir,
     mvr->parent = GTK_WIDGET (parent);
     mvr->can_go_back = mvr->can_go_fore = FALSE;
     mvr->auto_lang = extensions & MTX_CMM_EXTENSION_AUTO_LANG;
+    mvr->watch_monitors = g_ptr_array_new_with_free_func (_watch_monitor_free);
+    mtx_viewer_set_search_scope (mvr, MTX_VIEWER_SEARCH_DEPTH, NULL);
 
     g_signal_connect (mtx_viewer, "delete-event",
                       G_CALLBACK (viewer_destroy_me), mvr);
@@ -49,9 +49,14 @@ from the hardinfo "help-viewer" directory.
 #define __MTX_VIEWER_H__
 
 #include <gtk/gtk.h>
+#include "mtxsearchindex.h"
 
 G_BEGIN_DECLS
 
+/* Directory search defaults, see mtx_viewer_set_search_scope. */
+#define MTX_VIEWER_SEARCH_DEPTH 8
+#define MTX_VIEWER_SEARCH_EXCLUDE ".*"
+
 typedef struct _MtxViewer MtxViewer;
 struct _MtxViewer
 {
@@ -78,13 +83,29 @@ struct _MtxViewer
     gpointer *nav_trail_page;        /* the page being displayed */
     gint nav_trail_page_idx;
     gboolean can_go_fore, can_go_back;
+    GCancellable *load_cancellable;  /* page load in progress */
 
     GRegex *regex_astx;
+    MtxSearchIndex *search_index;    /* of base_directory, NULLABLE */
+    GThreadPool *search_pool;        /* search file readers, NULLABLE */
+    struct mtx_viewer_search *search; /* in progress, NULLABLE */
+    guint search_depth;              /* see mtx_viewer_set_search_scope */
+    gchar **search_exclude;
+
+    gboolean watch;                  /* reload the page when files change */
+    GPtrArray *watch_monitors;       /* (GFileMonitor *) page file, images */
+    gboolean watch_images_changed;
+    guint watch_timeout_id;          /* debounce timer */
+    GCancellable *watch_cancellable; /* reload in progress */
+    gdouble watch_scroll;            /* vertical scroll before reload */
+    guint watch_scroll_id;           /* idle_restore_scroll source */
 };
 
 MtxViewer *mtx_viewer_new (const gchar *, const gchar *, const gchar *, GtkWindow *, guint, guint);
 gboolean mtx_viewer_present_page (MtxViewer *mtx_viewer, const gchar *, guint);
 void mtx_viewer_destroy (MtxViewer *mtx_viewer);
+void mtx_viewer_set_watch (MtxViewer *mtx_viewer, gboolean);
+void mtx_viewer_set_search_scope (MtxViewer *mtx_viewer, guint, const gchar * const *);
 
 G_END_DECLS
 
@@ -0,0 +1,109 @@
+/* vim:set ts=8 sw=4 et: */
+/*
+MDVIEW MTX
+
+Copyright (C) 2024 step, https://github.com/step-
+
+Licensed under the GNU General Public License Version 2
+
+This program is free software; you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation; either version 2 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program; if not, write to the Free Software
+Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA 02111-1307, USA.
+*/
+
+/*
+Benchmark of the code and link tables of the markdown converter.
+
+Usage: bench_cmm_intern [MAX_N]
+
+For N doubling from 1000 up to MAX_N (default 64000), convert a document of
+N paragraphs.  Each paragraph has code spans and raw HTML, which go to the
+code table, and a link, an image and an autolink, whose destinations go to
+the link table.  Its first line brings new segments, its second line repeats
+the segments of an earlier paragraph, so both the insert and the lookup paths
+are timed.  Every 16th paragraph is followed by a fenced code block.  With
+hashed interning the time per paragraph stays flat as N grows.  Prints the
+best of three conversions.
+*/
+
+#include <stdlib.h>
+#include <glib.h>
+
+#include "../mtxcmm.h"
+
+#define PROGNAME "bench_cmm_intern"
+
+/**
+make_document:
+Return: a newly-allocated markdown document of @n paragraphs whose protected
+segments are half distinct and half repeated.
+*/
+static gchar *
+make_document (const guint n)
+{
+    GString *s = g_string_new (NULL);
+
+    for (guint i = 0; i < n; i++)
+    {
+        const guint old = i / 2;
+
+        /* new segments */
+        g_string_append_printf (s, "Call `fn_%u (x)` or `FN_%u`, see "
+                                "<kbd>k%u</kbd>, [page %u](doc/p%u.md), "
+                                "![fig %u](img/f%u.png) and "
+                                "<https://example.org/a%u>.\n", i, i, i, i,
+                                i, i, i, i);
+        /* the same kinds of segments again, seen in an earlier paragraph */
+        g_string_append_printf (s, "Again `fn_%u (x)` or `FN_%u`, "
+                                "<kbd>k%u</kbd>, [back](doc/p%u.md), "
+                                "![fig](img/f%u.png) and "
+                                "<https://example.org/a%u>.\n\n", old, old,
+                                old, old, old, old);
+        if (i % 16 == 15)
+        {
+            g_string_append_printf (s, "```\nblock_%u ();\n```\n\n", i);
+        }
+    }
+    return g_string_free (s, FALSE);
+}
+
+int
+main (int argc,
+      char **argv)
+{
+    const guint max = argc > 1 ? (guint) atoi (argv[1]) : 64000;
+    MtxCmm *cmm = mtx_cmm_new ();
+
+    mtx_cmm_set_output (cmm, MTX_CMM_OUTPUT_PANGO);
+    mtx_cmm_set_escape (cmm, TRUE);
+    g_print ("%10s %12s %16s\n", "paragraphs", "best ms", "us/paragraph");
+    for (guint n = 1000; n <= max; n *= 2)
+    {
+        gchar *document = make_document (n);
+        gint64 best = G_MAXINT64;
+
+        for (guint r = 0; r < 3; r++)
+        {
+            gchar *markdown = g_strdup (document);
+            gint64 t0 = g_get_monotonic_time ();
+
+            g_free (mtx_cmm_mtx (cmm, &markdown, NULL, TRUE));
+            best = MIN (best, g_get_monotonic_time () - t0);
+        }
+        g_print ("%10u %12.1f %16.3f\n", n, best / 1000.0,
+                 (gdouble) best / n);
+        g_free (document);
+    }
+    g_object_unref (cmm);
+    return 0;
+}
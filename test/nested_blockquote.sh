@@ -0,0 +1,25 @@
+#!/bin/sh
+# Print a markdown page of blockquotes nested DEPTH levels deep, each level
+# holding LINES lines of text and a list item, to measure the indentation
+# passes of the text view; see MTX_TEXT_VIEW_DEBUG in the Makefile.
+#
+# Usage: nested_blockquote.sh [DEPTH [LINES]] > FILE.md
+
+depth=${1:-64}
+lines=${2:-8}
+
+prefix=
+i=1
+while [ "$i" -le "$depth" ]; do
+	prefix="$prefix>"
+	echo "$prefix"
+	j=1
+	while [ "$j" -le "$lines" ]; do
+		echo "$prefix Level $i line $j with *emphasis* and \`code\`."
+		j=$((j + 1))
+	done
+	echo "$prefix"
+	echo "$prefix - item at level $i"
+	echo "$prefix"
+	i=$((i + 1))
+done
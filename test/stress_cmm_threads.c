@@ -0,0 +1,315 @@
+/* vim:set ts=8 sw=4 et: */
+/*
+MDVIEW MTX
+
+Copyright (C) 2024 step, https://github.com/step-
+
+Licensed under the GNU General Public License Version 2
+
+This program is free software; you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation; either version 2 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program; if not, write to the Free Software
+Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA 02111-1307, USA.
+*/
+
+/*
+Concurrency stress test of the markdown converter.
+
+Usage: stress_cmm_threads [THREADS [DOCUMENTS [ROUNDS [FILE...]]]]
+
+THREADS threads, each with its own MtxCmm instance, convert DOCUMENTS
+generated markdown documents, plus any markdown FILE, to every output type
+ROUNDS times.  The threads start together, so the first conversions also race
+on the lazy compilation of the shared regexes.  Each thread starts at a
+different document, and every output must equal the output of a
+single-threaded run, which is done last.
+
+Exit status: 0 if all outputs match, 1 otherwise.
+*/
+
+#include <stdlib.h>
+#include <string.h>
+#include <glib.h>
+
+#include "../mtxcmm.h"
+
+#define PROGNAME "stress_cmm_threads"
+
+static const MtxCmmOutput outputs[] = {
+    MTX_CMM_OUTPUT_PANGO,
+    MTX_CMM_OUTPUT_HTML,
+    MTX_CMM_OUTPUT_TEXT,
+    MTX_CMM_OUTPUT_ANSI,
+    MTX_CMM_OUTPUT_TTY,
+};
+
+typedef struct _stress
+{
+    GPtrArray           *documents;     /* (gchar *) */
+    guint                njobs;         /* documents x outputs */
+    guint                rounds;
+    GMutex               lock;
+    GCond                cond;
+    gboolean             go;
+    gint                 mismatches;    /* atomic */
+} Stress;
+
+typedef struct _stress_thread
+{
+    Stress              *stress;
+    guint                id;
+    GThread             *thread;
+    gchar              **results;       /* [njobs] output of the first round */
+} StressThread;
+
+/**
+make_document:
+Return: a newly-allocated markdown document that exercises most converter
+features; @i varies its contents.
+*/
+static gchar *
+make_document (const guint i)
+{
+    GString *s = g_string_new (NULL);
+
+    g_string_append_printf (s, "# Document %u\n\n", i);
+    g_string_append_printf
+        (s, "Some *emphasis*, **strong %u**, ~~struck~~ and `code %u`.  "
+         "\"Smart quotes\" and 'single' -- dashes... (c) %u.\n"
+         "Words: mtx_cmm_new(), MTX_CMM_OUTPUT_%u, /usr/share/doc/mdview%u, "
+         "fix-%u.diff, #bug%u, step@example.org and "
+         "https://example.org/page%u?q=%u.\n\n",
+         i, i, i, i, i, i, i, i, i);
+    g_string_append_printf (s, "## Lists\n\n");
+    for (guint k = 0; k < 2 + i % 5; k++)
+    {
+        g_string_append_printf (s, "%*s- item %u.%u with [link %u]"
+                                "(page%u.md \"title\")\n",
+                                (gint) (k % 3) * 2, "", i, k, k, k);
+    }
+    g_string_append (s, "\n");
+    for (guint k = 1; k <= 1 + i % 4; k++)
+    {
+        g_string_append_printf (s, "%u. ordered ![image %u](img%u.png)\n",
+                                k, k, k % 2);
+    }
+    g_string_append (s, "\n");
+    for (guint k = 1; k <= 1 + i % 6; k++)
+    {
+        g_string_append_printf (s, "%.*s quote level %u &amp; &copy; "
+                                "&#x2603;\n", (gint) k, ">>>>>>", k);
+    }
+    g_string_append (s, "\n```c\nint main (void) { return 0; }\n```\n\n");
+    g_string_append_printf (s, "~~~\ntilde fence %u\n~~~\n\n", i);
+    g_string_append (s, "| a | b |\n|---|:-:|\n");
+    for (guint k = 0; k < 1 + i % 3; k++)
+    {
+        g_string_append_printf (s, "| `%u` | *%u* |\n", k, i);
+    }
+    g_string_append_printf (s, "\nHard  \nbreak, <b>raw HTML</b>, "
+                            "<https://example.org/%u>, [ref][r%u].\n\n"
+                            "[r%u]: https://example.org/ref%u\n\n"
+                            "***\n\nUnicode: caf\xc3\xa9 \xe2\x86\x92 "
+                            "\xe6\x97\xa5\xe6\x9c\xac %u\n",
+                            i, i % 3, i % 3, i, i);
+    return g_string_free (s, FALSE);
+}
+
+/**
+convert:
+Return: a newly-allocated conversion of the document of job @j to the output
+of job @j, or NULL on error.
+*/
+static gchar *
+convert (MtxCmm *cmm,
+         const Stress *st,
+         const guint j)
+{
+    const MtxCmmOutput output = outputs[j % G_N_ELEMENTS (outputs)];
+    gchar *markdown =
+    g_strdup (g_ptr_array_index (st->documents, j / G_N_ELEMENTS (outputs)));
+
+    mtx_cmm_set_output (cmm, output);
+    mtx_cmm_set_escape (cmm, output == MTX_CMM_OUTPUT_PANGO);
+    return mtx_cmm_mtx (cmm, &markdown, NULL, TRUE);
+}
+
+static MtxCmm *
+new_converter (void)
+{
+    MtxCmm *cmm = mtx_cmm_new ();
+
+    mtx_cmm_set_extensions (cmm, MTX_CMM_EXTENSION_SHEBANG
+                            | MTX_CMM_EXTENSION_SMART_TEXT
+                            | MTX_CMM_EXTENSION_AUTO_CODE
+                            | MTX_CMM_EXTENSION_PERMLINK
+                            | MTX_CMM_EXTENSION_TABLE);
+    return cmm;
+}
+
+/**
+stress_thread:
+GThreadFunc: wait for the start signal then convert all jobs, starting at
+the job of this thread, ROUNDS times.  Later rounds must repeat the first.
+*/
+static gpointer
+stress_thread (gpointer data)
+{
+    StressThread *t = data;
+    Stress *st = t->stress;
+    MtxCmm *cmm = new_converter ();
+
+    g_mutex_lock (&st->lock);
+    while (!st->go)
+    {
+        g_cond_wait (&st->cond, &st->lock);
+    }
+    g_mutex_unlock (&st->lock);
+
+    for (guint r = 0; r < st->rounds; r++)
+    {
+        for (guint n = 0; n < st->njobs; n++)
+        {
+            const guint j = (t->id * 7 + n) % st->njobs;
+            gchar *out = convert (cmm, st, j);
+
+            if (r == 0)
+            {
+                t->results[j] = out;
+                continue;
+            }
+            if (out == NULL || t->results[j] == NULL
+                || strcmp (out, t->results[j]) != 0)
+            {
+                g_atomic_int_inc (&st->mismatches);
+            }
+            g_free (out);
+        }
+    }
+    g_object_unref (cmm);
+    return NULL;
+}
+
+int
+main (int argc,
+      char **argv)
+{
+    Stress st = { 0 };
+    guint nthreads = argc > 1 ? (guint) atoi (argv[1]) : 8;
+    guint ndocs = argc > 2 ? (guint) atoi (argv[2]) : 64;
+    StressThread *threads;
+    MtxCmm *cmm;
+    gint64 t0, t1, t2;
+    gint failed = 0;
+
+    st.rounds = argc > 3 ? (guint) atoi (argv[3]) : 4;
+    if (nthreads == 0 || st.rounds == 0)
+    {
+        g_printerr ("usage: %s [THREADS [DOCUMENTS [ROUNDS [FILE...]]]]\n",
+                    PROGNAME);
+        return 1;
+    }
+    st.documents = g_ptr_array_new_with_free_func (g_free);
+    for (guint i = 0; i < ndocs; i++)
+    {
+        g_ptr_array_add (st.documents, make_document (i));
+    }
+    for (gint i = 4; i < argc; i++)
+    {
+        gchar *contents;
+        GError *err = NULL;
+
+        if (!g_file_get_contents (argv[i], &contents, NULL, &err))
+        {
+            g_printerr ("%s: %s\n", PROGNAME, err->message);
+            g_error_free (err);
+            return 1;
+        }
+        g_ptr_array_add (st.documents, contents);
+    }
+    st.njobs = st.documents->len * G_N_ELEMENTS (outputs);
+    g_mutex_init (&st.lock);
+    g_cond_init (&st.cond);
+
+    threads = g_new0 (StressThread, nthreads);
+    for (guint t = 0; t < nthreads; t++)
+    {
+        threads[t].stress = &st;
+        threads[t].id = t;
+        threads[t].results = g_new0 (gchar *, st.njobs);
+        threads[t].thread = g_thread_new ("stress", stress_thread,
+                                          &threads[t]);
+    }
+    t0 = g_get_monotonic_time ();
+    g_mutex_lock (&st.lock);
+    st.go = TRUE;
+    g_cond_broadcast (&st.cond);
+    g_mutex_unlock (&st.lock);
+    for (guint t = 0; t < nthreads; t++)
+    {
+        g_thread_join (threads[t].thread);
+    }
+    t1 = g_get_monotonic_time ();
+
+    /* single-threaded reference */
+    cmm = new_converter ();
+    for (guint j = 0; j < st.njobs; j++)
+    {
+        gchar *ref = convert (cmm, &st, j);
+
+        for (guint r = 1; r < st.rounds; r++)
+        {
+            g_free (convert (cmm, &st, j));
+        }
+        for (guint t = 0; t < nthreads; t++)
+        {
+            if (ref == NULL || threads[t].results[j] == NULL
+                || strcmp (ref, threads[t].results[j]) != 0)
+            {
+                if (failed++ < 5)
+                {
+                    g_printerr ("%s: thread %u: output differs: "
+                                "document %u, output %d\n", PROGNAME, t,
+                                j / (guint) G_N_ELEMENTS (outputs),
+                                outputs[j % G_N_ELEMENTS (outputs)]);
+                }
+            }
+        }
+        g_free (ref);
+    }
+    t2 = g_get_monotonic_time ();
+    g_object_unref (cmm);
+    failed += g_atomic_int_get (&st.mismatches);
+
+    g_print ("%s: %u threads x %u conversions x %u rounds: %d mismatches\n"
+             "%s: %.0f conversions/s in %u threads, "
+             "%.0f conversions/s in 1 thread\n",
+             PROGNAME, nthreads, st.njobs, st.rounds, failed, PROGNAME,
+             (gdouble) nthreads * st.njobs * st.rounds * G_USEC_PER_SEC
+             / MAX (t1 - t0, 1), nthreads,
+             (gdouble) st.njobs * st.rounds * G_USEC_PER_SEC
+             / MAX (t2 - t1, 1));
+
+    for (guint t = 0; t < nthreads; t++)
+    {
+        for (guint j = 0; j < st.njobs; j++)
+        {
+            g_free (threads[t].results[j]);
+        }
+        g_free (threads[t].results);
+    }
+    g_free (threads);
+    g_mutex_clear (&st.lock);
+    g_cond_clear (&st.cond);
+    g_ptr_array_free (st.documents, TRUE);
+    return failed == 0 ? 0 : 1;
+}
@@ -0,0 +1,231 @@
+/* vim:set ts=8 sw=4 et: */
+/*
+MDVIEW MTX
+
+Copyright (C) 2024 step, https://github.com/step-
+
+Licensed under the GNU General Public License Version 2
+
+This program is free software; you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation; either version 2 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program; if not, write to the Free Software
+Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA 02111-1307, USA.
+*/
+
+/*
+Unit test of the search term matcher, see mtxmatch.c.
+
+Usage: test_match
+
+Matches texts against sets of terms with overlapping prefixes and suffixes,
+required terms, empty terms, mixed case, and more than MTX_MATCH_MAX_TERMS
+terms.
+
+Exit status: 0 if all checks pass, 1 otherwise.
+*/
+
+#include <string.h>
+#include <glib.h>
+
+#include "../mtxmatch.h"
+
+#define PROGNAME "test_match"
+
+static gint failed;
+
+/**
+check_match:
+Match @text against the space-separated @terms, and compare with @expected.
+*/
+static void
+check_match (const gchar *terms,
+             const gchar *text,
+             const gboolean expected)
+{
+    gchar **v = g_strsplit (terms, " ", 0);
+    MtxMatch *m = mtx_match_new (v);
+    const gboolean found = mtx_match_contents (m, text, strlen (text));
+
+    if (found != expected)
+    {
+        g_printerr ("%s: terms \"%s\", text \"%s\": expected %s\n", PROGNAME,
+                    terms, text, expected ? "TRUE" : "FALSE");
+        failed++;
+    }
+    mtx_match_free (m);
+    g_strfreev (v);
+}
+
+static void
+check (const gboolean ok,
+       const gchar *what)
+{
+    if (!ok)
+    {
+        g_printerr ("%s: %s\n", PROGNAME, what);
+        failed++;
+    }
+}
+
+static void
+test_overlapping (void)
+{
+    /* the classic Aho-Corasick set: terms end inside other terms */
+    check_match ("he she his hers", "ushers", TRUE);
+    check_match ("+he +she +hers", "ushers", TRUE);
+    check_match ("+he +she +his", "ushers", FALSE);
+    check_match ("+hers", "usher", FALSE);
+    /* found only through failure links */
+    check_match ("+abcd +bc", "xabcx", FALSE);
+    check_match ("+abcd +bc", "xbcabcd", TRUE);
+    check_match ("+aab +ab", "aaab", TRUE);
+    check_match ("+aaa", "aa", FALSE);
+    check_match ("+aaa", "baaab", TRUE);
+}
+
+static void
+test_required (void)
+{
+    check_match ("+foo +bar", "foo and bar", TRUE);
+    check_match ("+foo +bar", "foo only", FALSE);
+    check_match ("+foo +bar", "bar only", FALSE);
+    /* required terms, and at least one of the others */
+    check_match ("+foo baz qux", "foo qux", TRUE);
+    check_match ("+foo baz qux", "foo", FALSE);
+    check_match ("+foo baz qux", "baz qux", FALSE);
+    check_match ("foo bar", "no terms here", FALSE);
+    /* a lone prefix character is an ordinary term */
+    check_match ("+", "a+b", TRUE);
+    check_match ("+", "ab", FALSE);
+    check_match ("++", "a+b", TRUE);
+    check_match ("++", "ab", FALSE);
+}
+
+static void
+test_empty (void)
+{
+    gchar *none[] = { NULL };
+    MtxMatch *m;
+
+    /* an empty term matches any text, even an empty one */
+    m = mtx_match_new ((gchar *[]) { "", NULL });
+    check (mtx_match_contents (m, "", 0), "empty term: empty text missed");
+    check (mtx_match_contents (m, "anything", 8), "empty term: text missed");
+    mtx_match_free (m);
+    check_match ("foo ", "bar", TRUE);
+    /* but doesn't stand in for a required term */
+    check_match ("+foo ", "bar", FALSE);
+    check_match ("+foo ", "foo", TRUE);
+
+    /* no terms match nothing */
+    m = mtx_match_new (none);
+    check (!mtx_match_contents (m, "text", 4), "no terms: matched");
+    mtx_match_free (m);
+    m = mtx_match_new (NULL);
+    check (!mtx_match_contents (m, "text", 4), "NULL terms: matched");
+    mtx_match_free (m);
+
+    /* only @len bytes are scanned */
+    m = mtx_match_new ((gchar *[]) { "foo", NULL });
+    check (!mtx_match_contents (m, "xxfoo", 2), "len: matched past len");
+    check (mtx_match_contents (m, "xxfoo", 5), "len: not matched");
+    mtx_match_free (m);
+}
+
+static void
+test_case_folding (void)
+{
+    MtxMatch *m;
+    gchar **patterns;
+
+    check_match ("HeLLo", "say hello", TRUE);
+    check_match ("hello", "SAY HELLO", TRUE);
+    check_match ("+Foo +BAR", "fOO bAr", TRUE);
+    /* folding is ASCII-only */
+    check_match ("\xc3\xa9t\xc3\xa9", "\xc3\xa9t\xc3\xa9", TRUE);
+    check_match ("\xc3\x89T\xc3\x89", "\xc3\xa9t\xc3\xa9", FALSE);
+
+    m = mtx_match_new ((gchar *[]) { "+Foo", "BAR", "+", NULL });
+    patterns = mtx_match_get_patterns (m);
+    check (g_strv_length (patterns) == 3
+           && strcmp (patterns[0], "foo") == 0
+           && strcmp (patterns[1], "bar") == 0
+           && strcmp (patterns[2], "+") == 0, "patterns: not folded");
+    mtx_match_free (m);
+}
+
+static void
+test_max_terms (void)
+{
+    const guint n = MTX_MATCH_MAX_TERMS + 6;
+    gchar **optional = g_new0 (gchar *, n + 1);
+    gchar **required = g_new0 (gchar *, n + 1);
+    GString *all = g_string_new (NULL);
+    MtxMatch *m;
+
+    for (guint t = 0; t < n; t++)
+    {
+        optional[t] = g_strdup_printf ("w%03ux", t);
+        required[t] = g_strdup_printf ("+w%03ux", t);
+        if (t < MTX_MATCH_MAX_TERMS)
+        {
+            g_string_append_printf (all, "w%03ux ", t);
+        }
+    }
+
+    m = mtx_match_new (optional);
+    check (mtx_match_get_n_ignored (m) == n - MTX_MATCH_MAX_TERMS,
+           "max terms: wrong number of ignored terms");
+    check (g_strv_length (mtx_match_get_patterns (m)) == MTX_MATCH_MAX_TERMS,
+           "max terms: wrong number of patterns");
+    check (mtx_match_contents (m, "w063x", 5), "max terms: last term missed");
+    check (!mtx_match_contents (m, "w064x", 5),
+           "max terms: ignored term matched");
+    mtx_match_free (m);
+
+    /* all the required terms within the cap, including bit 63 */
+    m = mtx_match_new (required);
+    check (mtx_match_contents (m, all->str, all->len),
+           "max terms: required terms missed");
+    check (!mtx_match_contents (m, all->str,
+                                all->len - (sizeof "w063x " - 1)),
+           "max terms: matched without the last required term");
+    mtx_match_free (m);
+
+    /* exactly MTX_MATCH_MAX_TERMS terms */
+    {
+        gchar *first_ignored = required[MTX_MATCH_MAX_TERMS];
+
+        required[MTX_MATCH_MAX_TERMS] = NULL;
+        m = mtx_match_new (required);
+        check (mtx_match_get_n_ignored (m) == 0,
+               "max terms: terms ignored within the cap");
+        mtx_match_free (m);
+        required[MTX_MATCH_MAX_TERMS] = first_ignored;
+    }
+
+    g_string_free (all, TRUE);
+    g_strfreev (required);
+    g_strfreev (optional);
+}
+
+int
+main (void)
+{
+    test_overlapping ();
+    test_required ();
+    test_empty ();
+    test_case_folding ();
+    test_max_terms ();
+    g_print ("%s: %d failed\n", PROGNAME, failed);
+    return failed == 0 ? 0 : 1;
+}
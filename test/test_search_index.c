@@ -0,0 +1,491 @@
+/* vim:set ts=8 sw=4 et: */
+/*
+MDVIEW MTX
+
+Copyright (C) 2024 step, https://github.com/step-
+
+Licensed under the GNU General Public License Version 2
+
+This program is free software; you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation; either version 2 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program; if not, write to the Free Software
+Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA 02111-1307, USA.
+*/
+
+/*
+Unit test of the persistent search index, see mtxsearchindex.c.
+
+Usage: test_search_index
+
+Indexes made-up files, without reading any, into a temporary
+$XDG_CACHE_HOME.  Checks that the index survives a save and load, that the
+ids of replaced and pruned files are dropped and the other ids renumbered,
+that changed files are reported stale, and that truncated or corrupt index
+files load as an empty index.
+
+Exit status: 0 if all checks pass, 1 otherwise.
+*/
+
+#include <string.h>
+#include <sys/stat.h>
+#include <glib.h>
+#include <glib/gstdio.h>
+
+#include "../mtxsearchindex.h"
+
+#define PROGNAME "test_search_index"
+
+#define DIRECTORY "/nonexistent/test_search_index"
+
+static gint failed;
+
+static void
+check (const gboolean ok,
+       const gchar *what)
+{
+    if (!ok)
+    {
+        g_printerr ("%s: %s\n", PROGNAME, what);
+        failed++;
+    }
+}
+
+/**
+make_stat:
+Return: a stat of a file of @size bytes modified at @mtime seconds and
+@mtime_ns nanoseconds.
+*/
+static struct stat
+make_stat (const gint64 mtime,
+           const glong mtime_ns,
+           const off_t size)
+{
+    struct stat st;
+
+    memset (&st, 0, sizeof (st));
+    st.st_mtim.tv_sec = mtime;
+    st.st_mtim.tv_nsec = mtime_ns;
+    st.st_size = size;
+    st.st_mode = S_IFREG | 0644;
+    return st;
+}
+
+/**
+add_file:
+Index file @name of @contents as if read from disk with stat @st.
+*/
+static void
+add_file (MtxSearchIndex *idx,
+          const gchar *name,
+          const struct stat *st,
+          const MtxSearchIndexKind kind,
+          const gchar *contents)
+{
+    GArray *trigrams = mtx_search_index_trigrams (contents, strlen (contents));
+
+    mtx_search_index_add (idx, name, st, kind, trigrams);
+    g_array_unref (trigrams);
+}
+
+/**
+check_query:
+Query @idx for the space-separated @terms, and compare the candidates with the
+space-separated sorted file names @expected.  A NULL @expected means the query
+can't narrow the search down.
+*/
+static void
+check_query (MtxSearchIndex *idx,
+             const gchar *terms,
+             const gchar *expected,
+             const gchar *what)
+{
+    gchar **v = g_strsplit (terms, " ", 0);
+    GHashTable *found = mtx_search_index_query (idx, v);
+    gchar *got = NULL;
+
+    if (found != NULL)
+    {
+        GList *names = g_list_sort (g_hash_table_get_keys (found),
+                                    (GCompareFunc) strcmp);
+        GString *s = g_string_new (NULL);
+
+        for (GList *l = names; l != NULL; l = l->next)
+        {
+            g_string_append_printf (s, "%s%s", s->len ? " " : "",
+                                    (gchar *) l->data);
+        }
+        got = g_string_free (s, FALSE);
+        g_list_free (names);
+        g_hash_table_destroy (found);
+    }
+    if (g_strcmp0 (got, expected) != 0)
+    {
+        g_printerr ("%s: %s: query \"%s\": got \"%s\", expected \"%s\"\n",
+                    PROGNAME, what, terms, got ? got : "(null)",
+                    expected ? expected : "(null)");
+        failed++;
+    }
+    g_free (got);
+    g_strfreev (v);
+}
+
+static const struct
+{
+    const gchar         *name;
+    MtxSearchIndexKind   kind;
+    const gchar         *contents;
+} files[] = {
+    { "a.md", MTX_SEARCH_INDEX_KIND_MARKDOWN, "# Hello World\n" },
+    { "b.txt", MTX_SEARCH_INDEX_KIND_TEXT, "goodbye, world" },
+    { "c.png", MTX_SEARCH_INDEX_KIND_OTHER, NULL },
+    { "sub/d.md", MTX_SEARCH_INDEX_KIND_MARKDOWN, "Hello again" },
+};
+
+/**
+new_index:
+Return: a new index of @files saved to the index file.
+*/
+static MtxSearchIndex *
+new_index (void)
+{
+    MtxSearchIndex *idx = mtx_search_index_open (DIRECTORY);
+
+    mtx_search_index_begin (idx);
+    for (guint i = 0; i < G_N_ELEMENTS (files); i++)
+    {
+        const struct stat st = make_stat (1700000000 + i, 123456789,
+                                          100 + i);
+        if (files[i].contents != NULL)
+        {
+            add_file (idx, files[i].name, &st, files[i].kind,
+                      files[i].contents);
+        }
+        else
+        {
+            mtx_search_index_add (idx, files[i].name, &st, files[i].kind,
+                                  NULL);
+        }
+    }
+    check (mtx_search_index_save (idx), "new: save failed");
+    return idx;
+}
+
+/**
+check_empty:
+Check that @idx holds none of @files.
+*/
+static void
+check_empty (MtxSearchIndex *idx,
+             const gchar *what)
+{
+    for (guint i = 0; i < G_N_ELEMENTS (files); i++)
+    {
+        const struct stat st = make_stat (1700000000 + i, 123456789,
+                                          100 + i);
+        if (mtx_search_index_lookup (idx, files[i].name, &st)
+            != MTX_SEARCH_INDEX_KIND_UNKNOWN)
+        {
+            g_printerr ("%s: %s: \"%s\" found\n", PROGNAME, what,
+                        files[i].name);
+            failed++;
+        }
+    }
+    check_query (idx, "hello world goodbye", "", what);
+}
+
+static void
+test_round_trip (void)
+{
+    MtxSearchIndex *idx = new_index ();
+
+    mtx_search_index_free (idx);
+    idx = mtx_search_index_open (DIRECTORY);
+    for (guint i = 0; i < G_N_ELEMENTS (files); i++)
+    {
+        const struct stat st = make_stat (1700000000 + i, 123456789,
+                                          100 + i);
+        if (mtx_search_index_lookup (idx, files[i].name, &st)
+            != files[i].kind)
+        {
+            g_printerr ("%s: round trip: \"%s\" lost\n", PROGNAME,
+                        files[i].name);
+            failed++;
+        }
+    }
+    check_query (idx, "hello", "a.md sub/d.md", "round trip");
+    check_query (idx, "WORLD", "a.md b.txt", "round trip");
+    check_query (idx, "goodbye hello", "a.md b.txt sub/d.md", "round trip");
+    check_query (idx, "hello,", "", "round trip");
+    check_query (idx, "png", "", "round trip");
+    check_query (idx, "hello wo", NULL, "round trip");
+    /* unchanged, so not written again */
+    check (mtx_search_index_save (idx), "round trip: save failed");
+    mtx_search_index_free (idx);
+}
+
+static void
+test_stale (void)
+{
+    MtxSearchIndex *idx = new_index ();
+    struct stat st = make_stat (1700000000, 123456789, 100);
+
+    /* the stamps come back from the index file to the nanosecond */
+    mtx_search_index_free (idx);
+    idx = mtx_search_index_open (DIRECTORY);
+    check (mtx_search_index_lookup (idx, "a.md", &st)
+           == MTX_SEARCH_INDEX_KIND_MARKDOWN, "stale: fresh file stale");
+    st.st_mtim.tv_nsec++;
+    check (mtx_search_index_lookup (idx, "a.md", &st)
+           == MTX_SEARCH_INDEX_KIND_UNKNOWN, "stale: mtime_ns change missed");
+    st = make_stat (1700000001, 123456789, 100);
+    check (mtx_search_index_lookup (idx, "a.md", &st)
+           == MTX_SEARCH_INDEX_KIND_UNKNOWN, "stale: mtime change missed");
+    st = make_stat (1700000000, 123456789, 99);
+    check (mtx_search_index_lookup (idx, "a.md", &st)
+           == MTX_SEARCH_INDEX_KIND_UNKNOWN, "stale: size change missed");
+    check (mtx_search_index_lookup (idx, "none.md", &st)
+           == MTX_SEARCH_INDEX_KIND_UNKNOWN, "stale: unknown file found");
+
+    /* index the changed file again */
+    st = make_stat (1700000100, 0, 8);
+    add_file (idx, "a.md", &st, MTX_SEARCH_INDEX_KIND_MARKDOWN, "Farewell");
+    check (mtx_search_index_lookup (idx, "a.md", &st)
+           == MTX_SEARCH_INDEX_KIND_MARKDOWN, "stale: re-indexed file stale");
+    check_query (idx, "farewell", "a.md", "stale");
+    mtx_search_index_free (idx);
+}
+
+static void
+test_dead_ids (void)
+{
+    MtxSearchIndex *idx = new_index ();
+    struct stat st = make_stat (1700000100, 0, 8);
+
+    /* a.md (id 0) dies, and comes back as the last id */
+    add_file (idx, "a.md", &st, MTX_SEARCH_INDEX_KIND_MARKDOWN, "Farewell");
+    check_query (idx, "hello", "sub/d.md", "dead ids");
+    check_query (idx, "farewell", "a.md", "dead ids");
+    check_query (idx, "world", "b.txt", "dead ids");
+
+    /* renumbered in memory by the save */
+    check (mtx_search_index_save (idx), "dead ids: save failed");
+    check_query (idx, "hello", "sub/d.md", "dead ids, saved");
+    check_query (idx, "farewell", "a.md", "dead ids, saved");
+    check_query (idx, "world", "b.txt", "dead ids, saved");
+    add_file (idx, "e.md", &st, MTX_SEARCH_INDEX_KIND_MARKDOWN, "world");
+    check_query (idx, "world", "b.txt e.md", "dead ids, saved");
+    check (mtx_search_index_save (idx), "dead ids: save failed");
+    mtx_search_index_free (idx);
+
+    /* and on disk */
+    idx = mtx_search_index_open (DIRECTORY);
+    check (mtx_search_index_lookup (idx, "a.md", &st)
+           == MTX_SEARCH_INDEX_KIND_MARKDOWN, "dead ids: a.md lost");
+    check (mtx_search_index_lookup (idx, "e.md", &st)
+           == MTX_SEARCH_INDEX_KIND_MARKDOWN, "dead ids: e.md lost");
+    check_query (idx, "hello", "sub/d.md", "dead ids, loaded");
+    check_query (idx, "farewell", "a.md", "dead ids, loaded");
+    check_query (idx, "world", "b.txt e.md", "dead ids, loaded");
+    check_query (idx, "again", "sub/d.md", "dead ids, loaded");
+    mtx_search_index_free (idx);
+}
+
+static void
+test_prune (void)
+{
+    MtxSearchIndex *idx = new_index ();
+    struct stat st;
+
+    /* a scan that sees a.md and c.png, and adds f.md */
+    mtx_search_index_begin (idx);
+    st = make_stat (1700000000, 123456789, 100);
+    (void) mtx_search_index_lookup (idx, "a.md", &st);
+    st = make_stat (1700000002, 123456789, 102);
+    (void) mtx_search_index_lookup (idx, "c.png", &st);
+    st = make_stat (1700000200, 0, 5);
+    add_file (idx, "f.md", &st, MTX_SEARCH_INDEX_KIND_MARKDOWN, "hello");
+    mtx_search_index_prune (idx);
+
+    st = make_stat (1700000001, 123456789, 101);
+    check (mtx_search_index_lookup (idx, "b.txt", &st)
+           == MTX_SEARCH_INDEX_KIND_UNKNOWN, "prune: b.txt kept");
+    check_query (idx, "hello", "a.md f.md", "prune");
+    check_query (idx, "goodbye", "", "prune");
+    check (mtx_search_index_save (idx), "prune: save failed");
+    mtx_search_index_free (idx);
+
+    idx = mtx_search_index_open (DIRECTORY);
+    st = make_stat (1700000003, 123456789, 103);
+    check (mtx_search_index_lookup (idx, "sub/d.md", &st)
+           == MTX_SEARCH_INDEX_KIND_UNKNOWN, "prune: sub/d.md kept");
+    st = make_stat (1700000002, 123456789, 102);
+    check (mtx_search_index_lookup (idx, "c.png", &st)
+           == MTX_SEARCH_INDEX_KIND_OTHER, "prune: c.png lost");
+    check_query (idx, "hello", "a.md f.md", "prune, loaded");
+    check_query (idx, "world", "a.md", "prune, loaded");
+    mtx_search_index_free (idx);
+}
+
+static void
+append_varint (GString *s,
+               guint64 v)
+{
+    do
+    {
+        g_string_append_c (s, (v & 0x7f) | (v > 0x7f ? 0x80 : 0));
+        v >>= 7;
+    }
+    while (v != 0);
+}
+
+/**
+append_file_a:
+Append a file table of a.md, as indexed by new_index, but of kind @kind.
+*/
+static void
+append_file_a (GString *s,
+               const guint kind)
+{
+    append_varint (s, 1);
+    append_varint (s, 4);
+    g_string_append (s, "a.md");
+    append_varint (s, G_GUINT64_CONSTANT (1700000000123456789));
+    append_varint (s, 100);
+    append_varint (s, kind);
+}
+
+/**
+load_corrupt:
+Write @len bytes at @data to the index file, and check that opening it gives an
+empty index.
+*/
+static void
+load_corrupt (const gchar *path,
+              const gchar *data,
+              const gsize len,
+              const gchar *what)
+{
+    MtxSearchIndex *idx;
+
+    g_file_set_contents (path, data, len, NULL);
+    idx = mtx_search_index_open (DIRECTORY);
+    check_empty (idx, what);
+    mtx_search_index_free (idx);
+}
+
+static void
+test_corrupt (const gchar *path)
+{
+    gchar *contents, *what;
+    gsize len;
+    GString *s;
+
+    mtx_search_index_free (new_index ());
+    if (!g_file_get_contents (path, &contents, &len, NULL))
+    {
+        check (FALSE, "corrupt: no index file");
+        return;
+    }
+
+    /* every truncation, including inside the magic and inside varints */
+    for (gsize n = 0; n < len; n++)
+    {
+        what = g_strdup_printf ("truncated to %" G_GSIZE_FORMAT " bytes", n);
+        load_corrupt (path, contents, n, what);
+        g_free (what);
+    }
+
+    s = g_string_new ("MDVIDX01");
+    /* a varint that doesn't end */
+    for (guint i = 0; i < 11; i++)
+    {
+        g_string_append_c (s, '\xff');
+    }
+    load_corrupt (path, s->str, s->len, "endless varint");
+
+    /* a file name that runs past the end */
+    g_string_truncate (s, 8);
+    g_string_append_len (s, "\x01\x20" "a.md", 6);
+    load_corrupt (path, s->str, s->len, "long name");
+
+    /* an unknown kind */
+    g_string_truncate (s, 8);
+    append_file_a (s, 9);
+    append_varint (s, 0);
+    load_corrupt (path, s->str, s->len, "bad kind");
+
+    /* a posting of a file id out of range */
+    g_string_truncate (s, 8);
+    append_file_a (s, MTX_SEARCH_INDEX_KIND_MARKDOWN);
+    append_varint (s, 1);
+    append_varint (s, 'h' << 16 | 'e' << 8 | 'l');
+    append_varint (s, 1);
+    append_varint (s, 1);
+    load_corrupt (path, s->str, s->len, "bad id");
+
+    /* a wrong magic */
+    g_string_assign (s, "MDVIDX00");
+    g_string_append_len (s, contents + 8, len - 8);
+    load_corrupt (path, s->str, s->len, "wrong magic");
+    g_string_free (s, TRUE);
+
+    /* the intact file still loads */
+    g_file_set_contents (path, contents, len, NULL);
+    {
+        MtxSearchIndex *idx = mtx_search_index_open (DIRECTORY);
+        check_query (idx, "hello", "a.md sub/d.md", "intact");
+        mtx_search_index_free (idx);
+    }
+    g_free (contents);
+}
+
+int
+main (void)
+{
+    gchar *cache = g_dir_make_tmp (PROGNAME "-XXXXXX", NULL);
+    gchar *sum, *name, *path;
+
+    if (cache == NULL)
+    {
+        g_printerr ("%s: can't make a temporary directory\n", PROGNAME);
+        return 1;
+    }
+    /* before GLib caches the user cache directory */
+    g_setenv ("XDG_CACHE_HOME", cache, TRUE);
+    sum = g_compute_checksum_for_string (G_CHECKSUM_SHA1, DIRECTORY, -1);
+    name = g_strdup_printf ("search-%s.idx", sum);
+    path = g_build_filename (cache, MTX_SEARCH_INDEX_CACHE_DIR, name, NULL);
+
+    test_round_trip ();
+    g_remove (path);
+    test_stale ();
+    g_remove (path);
+    test_dead_ids ();
+    g_remove (path);
+    test_prune ();
+    g_remove (path);
+    test_corrupt (path);
+    g_remove (path);
+
+    {
+        gchar *dir = g_path_get_dirname (path);
+        g_rmdir (dir);
+        g_free (dir);
+    }
+    g_rmdir (cache);
+    g_free (path);
+    g_free (name);
+    g_free (sum);
+    g_free (cache);
+    g_print ("%s: %d failed\n", PROGNAME, failed);
+    return failed == 0 ? 0 : 1;
+}